@@ -1,5 +1,5 @@
 function (add_lesson target)
-	cmake_parse_arguments(PARSE_ARGV 1 arg "" "" "SOURCES;SHADERS;DATA")
+	cmake_parse_arguments(PARSE_ARGV 1 arg "" "" "SOURCES;SHADERS;DATA;GLYPHS")
 
 	add_executable(${target} MACOSX_BUNDLE WIN32
 		application.c application.h
@@ -29,8 +29,12 @@ function (add_lesson target)
 	endif()
 	foreach (shader IN LISTS arg_SHADERS)
 		if (CMAKE_SYSTEM_NAME STREQUAL "Darwin")
-			# Add compiled Metal shader libraries as bundle resources
+			# Add compiled Metal shader libraries as bundle resources, or the Metal source of variants that don't have a
+			# library yet for NeHe_LoadShaders to compile at runtime
 			set(path "${CMAKE_SOURCE_DIR}/data/shaders/${shader}.metallib")
+			if (NOT EXISTS "${path}")
+				set(path "${CMAKE_SOURCE_DIR}/data/shaders/${shader}.metal")
+			endif()
 			set_source_files_properties(${path} PROPERTIES
 				HEADER_FILE_ONLY ON
 				MACOSX_PACKAGE_LOCATION "Resources/Data/Shaders")
@@ -39,10 +43,15 @@ function (add_lesson target)
 		else()
 			if (CMAKE_SYSTEM_NAME STREQUAL "Windows")
 				# Copy D3D12 (DXIL) shaders into target shaders folder
-				add_custom_command(TARGET ${target} POST_BUILD COMMAND ${CMAKE_COMMAND} ARGS -E copy_if_different
-					"${CMAKE_SOURCE_DIR}/data/shaders/${shader}.vtx.dxb"
-					"${CMAKE_SOURCE_DIR}/data/shaders/${shader}.pxl.dxb"
-					"$<TARGET_FILE_DIR:${target}>/Data/Shaders")
+				if (EXISTS "${CMAKE_SOURCE_DIR}/data/shaders/${shader}.vtx.dxb"
+						AND EXISTS "${CMAKE_SOURCE_DIR}/data/shaders/${shader}.pxl.dxb")
+					add_custom_command(TARGET ${target} POST_BUILD COMMAND ${CMAKE_COMMAND} ARGS -E copy_if_different
+						"${CMAKE_SOURCE_DIR}/data/shaders/${shader}.vtx.dxb"
+						"${CMAKE_SOURCE_DIR}/data/shaders/${shader}.pxl.dxb"
+						"$<TARGET_FILE_DIR:${target}>/Data/Shaders")
+				else()
+					message(WARNING "${shader} hasn't been compiled to DXIL, ${target} will only run with Vulkan")
+				endif()
 				# Copy D3D12 (DXBC) shaders into target shaders folder
 				#add_custom_command(TARGET ${target} POST_BUILD COMMAND ${CMAKE_COMMAND} ARGS -E copy_if_different
 				#	"${CMAKE_SOURCE_DIR}/data/shaders/${shader}.vtx.fxb"
@@ -70,4 +79,17 @@ function (add_lesson target)
 		endif()
 		unset(path)
 	endforeach()
+	foreach (file IN LISTS arg_GLYPHS)
+		# Glyphs baked by bake_glyphs, listing them as sources makes them get baked before the lesson is built
+		set(path "${CMAKE_CURRENT_BINARY_DIR}/${file}")
+		target_sources(${target} PRIVATE "${path}")
+		if (CMAKE_SYSTEM_NAME STREQUAL "Darwin")
+			set_source_files_properties(${path} PROPERTIES
+				MACOSX_PACKAGE_LOCATION "Resources/Data")
+		else()
+			add_custom_command(TARGET ${target} POST_BUILD COMMAND ${CMAKE_COMMAND} ARGS -E copy_if_different
+				"${path}" "$<TARGET_FILE_DIR:${target}>/Data")
+		endif()
+		unset(path)
+	endforeach()
 endfunction()
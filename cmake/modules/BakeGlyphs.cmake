@@ -0,0 +1,38 @@
+# Offline tool that rasterises glyphs ahead of time for NeHe_LoadGlyphCache
+function (add_fontbake)
+	add_executable(fontbake fontbake.c
+		glyphcache.c glyphcache.h
+		nehe.c nehe.h
+		stb_truetype.h sdl_stbtt.h)
+	set_property(TARGET fontbake PROPERTY C_STANDARD 99)
+
+	target_compile_options(fontbake PRIVATE
+		$<$<C_COMPILER_ID:Clang,AppleClang>:-Weverything -Wno-declaration-after-statement -Wno-padded -Wno-switch-enum -Wno-cast-qual>
+		$<$<C_COMPILER_ID:GNU>:-Wall -Wextra -pedantic>
+		$<$<C_COMPILER_ID:MSVC>:/W4>)
+	target_compile_definitions(fontbake PRIVATE
+		$<$<C_COMPILER_ID:MSVC>:_CRT_SECURE_NO_WARNINGS>)
+	target_link_libraries(fontbake SDL3::SDL3)
+	if (CMAKE_SYSTEM_NAME STREQUAL "Windows")
+		# Copy SDL3.dll next to the tool so it can run during the build
+		add_custom_command(TARGET fontbake POST_BUILD COMMAND ${CMAKE_COMMAND} ARGS -E copy_if_different
+			$<TARGET_FILE:SDL3::SDL3> $<TARGET_FILE_DIR:fontbake>)
+	endif()
+endfunction()
+
+# Bake glyphs from a font in the data folder, lessons pick up the output by listing it under GLYPHS
+#   bake_glyphs(<output> FONT <file.ttf> WIDTH <atlas width> SIZE <pixel height> [SDF] RANGES <first>-<last>...)
+function (bake_glyphs output)
+	cmake_parse_arguments(PARSE_ARGV 1 arg "SDF" "FONT;WIDTH;SIZE" "RANGES")
+
+	set(font "${CMAKE_SOURCE_DIR}/data/${arg_FONT}")
+	set(path "${CMAKE_CURRENT_BINARY_DIR}/${output}")
+	if (arg_SDF)
+		set(sdf --sdf)
+	endif()
+	add_custom_command(OUTPUT "${path}"
+		COMMAND fontbake ${sdf} "${font}" "${path}" ${arg_WIDTH} ${arg_SIZE} ${arg_RANGES}
+		DEPENDS fontbake "${font}"
+		COMMENT "Baking glyphs from ${arg_FONT}"
+		VERBATIM)
+endfunction()
@@ -0,0 +1,56 @@
+/*
+ * SPDX-FileCopyrightText: (C) 2025 a dinosaur
+ * SPDX-License-Identifier: Zlib
+ */
+
+#include <metal_stdlib>
+#include <simd/simd.h>
+
+struct CharacterInput
+{
+	float4 src [[attribute(0)]];  // Normalised atlas rectangle
+	short4 dst [[attribute(1)]];   // Pixel rectangle
+	float4 color [[attribute(2)]];
+};
+
+struct VertexUniform
+{
+	metal::float4x4 modelViewProj;
+	float4 color;  // Tint for all text
+};
+
+struct Vertex2Fragment
+{
+	float4 position [[position]];
+	float2 texCoord;
+	half4 color;
+};
+
+vertex Vertex2Fragment VertexMain(
+	CharacterInput in [[stage_in]],
+	constant VertexUniform& u [[buffer(0)]],
+	uint vertexID [[vertex_id]])
+{
+	const auto offset = float2(vertexID >> 1, vertexID & 0x1);
+
+	Vertex2Fragment out;
+	out.position = u.modelViewProj * float4(float2(in.dst.xy) + float2(in.dst.zw) * offset, 0.0, 1.0);
+	out.texCoord = in.src.xy + in.src.zw * offset;
+	out.color = half4(in.color * u.color);
+	return out;
+}
+
+fragment half4 FragmentMain(
+	Vertex2Fragment in [[stage_in]],
+	metal::texture2d<half, metal::access::sample> texture [[texture(0)]],
+	metal::sampler sampler [[sampler(0)]])
+{
+#ifdef SDF
+	// Distance is 0.5 on the glyph outline, antialias across roughly one screen pixel at any scale
+	const float dist = texture.sample(sampler, in.texCoord).a;
+	const float width = 0.5 * metal::fwidth(dist) + 1e-4;
+	return in.color * half(metal::smoothstep(0.5 - width, 0.5 + width, dist));
+#else
+	return in.color * texture.sample(sampler, in.texCoord).a;
+#endif
+}
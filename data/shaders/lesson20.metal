@@ -0,0 +1,65 @@
+/*
+ * SPDX-FileCopyrightText: (C) 2025 a dinosaur
+ * SPDX-License-Identifier: Zlib
+ */
+
+#include <metal_stdlib>
+#include <simd/simd.h>
+
+struct VertexInput
+{
+	// Instance
+	float4 model0       [[attribute(0)]];
+	float4 model1       [[attribute(1)]];
+	float4 model2       [[attribute(2)]];
+	float4 model3       [[attribute(3)]];
+	float4 texTransform [[attribute(4)]];  // Offset in xy, scale in zw
+};
+
+struct VertexUniform
+{
+	metal::float4x4 projection;
+};
+
+struct Vertex2Fragment
+{
+	float4 position [[position]];
+	float2 texCoord;
+};
+
+static constexpr constant float2 quadVertices[4] =
+{
+	{ -1.1f, -1.1f },  // Bottom left
+	{  1.1f, -1.1f },  // Bottom right
+	{ -1.1f,  1.1f },  // Top left
+	{  1.1f,  1.1f }   // Top right
+};
+
+static constexpr constant float2 quadTexCoords[4] =
+{
+    { 0.0f, 0.0f },  // Bottom left
+    { 1.0f, 0.0f },  // Bottom right
+    { 0.0f, 1.0f },  // Top left
+    { 1.0f, 1.0f }   // Top right
+};
+
+vertex Vertex2Fragment VertexMain(
+	VertexInput in [[stage_in]],
+	uint vertexID [[vertex_id]],
+	constant VertexUniform& u [[buffer(0)]])
+{
+	const auto model = metal::float4x4(in.model0, in.model1, in.model2, in.model3);
+
+	Vertex2Fragment out;
+	out.position = u.projection * model * float4(quadVertices[vertexID], 0.0, 1.0);
+	out.texCoord = in.texTransform.xy + quadTexCoords[vertexID] * in.texTransform.zw;
+	return out;
+}
+
+fragment half4 FragmentMain(
+	Vertex2Fragment in [[stage_in]],
+	metal::texture2d<half, metal::access::sample> texture [[texture(0)]],
+	metal::sampler sampler [[sampler(0)]])
+{
+	return texture.sample(sampler, in.texCoord);
+}
@@ -0,0 +1,86 @@
+/*
+ * SPDX-FileCopyrightText: (C) 2025 a dinosaur
+ * SPDX-License-Identifier: Zlib
+ */
+
+#define OCT_NORMAL
+
+#include <metal_stdlib>
+#include <simd/simd.h>
+
+struct VertexInput
+{
+	float3 position [[attribute(0)]];
+	float2 texcoord [[attribute(1)]];
+#ifdef OCT_NORMAL
+	float2 normal   [[attribute(2)]];
+#else
+	float3 normal   [[attribute(2)]];
+#endif
+};
+
+struct VertexUniform
+{
+	metal::float4x4 modelView;
+	metal::float4x4 projection;
+};
+
+struct Light
+{
+	float4 ambient;
+	float4 diffuse;
+	float4 position;
+};
+
+struct Vertex2Fragment
+{
+	float4 position [[position]];
+	float2 texcoord;
+	half4 color;
+};
+
+#ifdef OCT_NORMAL
+// Unfold octahedral encoded normal, doesn't need to be unit length as it's normalised after transformation
+static float3 OctahedronDecode(float2 e)
+{
+	auto n = float3(e, 1.0 - metal::abs(e.x) - metal::abs(e.y));
+	const auto t = metal::saturate(-n.z);
+	n.xy -= (metal::step(float2(0.0), n.xy) * 2.0 - 1.0) * t;
+	return n;
+}
+#endif
+
+vertex Vertex2Fragment VertexMain(
+	VertexInput in [[stage_in]],
+	constant VertexUniform& u [[buffer(0)]],
+	constant Light& light [[buffer(1)]])
+{
+	const auto position = u.modelView * float4(in.position, 1.0);
+#ifdef OCT_NORMAL
+	const auto normal = metal::normalize(u.modelView * float4(OctahedronDecode(in.normal), 0.0)).xyz;
+#else
+	const auto normal = metal::normalize(u.modelView * float4(in.normal, 0.0)).xyz;
+#endif
+
+	const auto lightVec = light.position.xyz - position.xyz;
+	const auto lightDist2 = metal::length_squared(lightVec);
+	const auto dir = metal::rsqrt(lightDist2) * lightVec;
+	const auto lambert = metal::max(0.0, metal::dot(normal, dir));
+
+	const auto ambient = 0.04 + 0.2 * half3(light.ambient.rgb);
+	const auto diffuse = 0.8 * half3(light.diffuse.rgb);
+
+	Vertex2Fragment out;
+	out.position = u.projection * position;
+	out.texcoord = in.texcoord;
+	out.color = half4(ambient + lambert * diffuse, 1.0);
+	return out;
+}
+
+fragment half4 FragmentMain(
+	Vertex2Fragment in [[stage_in]],
+	metal::texture2d<half, metal::access::sample> texture [[texture(0)]],
+	metal::sampler sampler [[sampler(0)]])
+{
+	return in.color * texture.sample(sampler, in.texcoord);
+}
@@ -0,0 +1,125 @@
+/*
+ * SPDX-FileCopyrightText: (C) 2025 a dinosaur
+ * SPDX-License-Identifier: Zlib
+ */
+
+// Bakes ranges of glyphs from a TrueType font into a file for NeHe_LoadGlyphCache, so lessons can draw text
+// without parsing the font or rasterising anything at startup
+
+#include "glyphcache.h"
+
+
+#define BAKE_MAX_HEIGHT 4096
+
+static void Usage(void)
+{
+	SDL_Log("Usage: fontbake [--sdf] <font.ttf> <output> <atlas width> <pixel height> <first>[-<last>] ...");
+	SDL_Log("  --sdf  Bake signed distance fields at the pixel height, which scale to any size");
+}
+
+static bool ParseNumber(const char* restrict arg, unsigned long* restrict outValue, const char** restrict outEnd)
+{
+	char* end;
+	*outValue = SDL_strtoul(arg, &end, 0);
+	if (end == arg)
+	{
+		return false;
+	}
+	if (outEnd)
+	{
+		*outEnd = end;
+	}
+	else if (*end != '\0')
+	{
+		return false;
+	}
+	return true;
+}
+
+static bool ParseRange(const char* restrict arg, uint32_t* restrict outFirst, uint32_t* restrict outLast)
+{
+	unsigned long first, last;
+	const char* end;
+	if (!ParseNumber(arg, &first, &end))
+	{
+		return false;
+	}
+	if (*end == '\0')
+	{
+		last = first;
+	}
+	else if (*end != '-' || !ParseNumber(end + 1, &last, NULL))
+	{
+		return false;
+	}
+	if (first > last || last > 0x10FFFF)
+	{
+		return false;
+	}
+	*outFirst = (uint32_t)first;
+	*outLast = (uint32_t)last;
+	return true;
+}
+
+int main(int argc, char* argv[])
+{
+	int arg = 1;
+	const bool sdf = arg < argc && SDL_strcmp(argv[arg], "--sdf") == 0;
+	if (sdf)
+	{
+		++arg;
+	}
+	unsigned long width, pixelHeight;
+	if (argc - arg < 5 || !ParseNumber(argv[arg + 2], &width, NULL) || !ParseNumber(argv[arg + 3], &pixelHeight, NULL)
+		|| width == 0 || width > UINT16_MAX || pixelHeight == 0 || pixelHeight >= UINT16_MAX)
+	{
+		Usage();
+		return 1;
+	}
+	const char* ttfPath = argv[arg];
+	const char* outPath = argv[arg + 1];
+
+	// Paths are taken as given rather than relative to the executable
+	NeHeContext ctx = { .baseDir = "" };
+	NeHeGlyphCache cache;
+	if (!NeHe_CreateGlyphCache(&ctx, &cache, ttfPath, (uint32_t)width, 8, BAKE_MAX_HEIGHT,
+		sdf ? (unsigned)pixelHeight : 0))
+	{
+		return 1;
+	}
+
+	int status = 0;
+	for (arg += 4; arg < argc && status == 0; ++arg)
+	{
+		uint32_t first, last;
+		if (!ParseRange(argv[arg], &first, &last))
+		{
+			SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Invalid codepoint range \"%s\"", argv[arg]);
+			status = 1;
+			break;
+		}
+		for (uint32_t codepoint = first; codepoint <= last; ++codepoint)
+		{
+			NeHeGlyph glyph;
+			if (!NeHe_GetGlyph(&cache, codepoint, (unsigned)pixelHeight, &glyph))
+			{
+				SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "NeHe_GetGlyph: %s", SDL_GetError());
+				status = 1;
+				break;
+			}
+		}
+	}
+
+	if (status == 0 && !NeHe_SaveGlyphCache(&cache, outPath))
+	{
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Failed to write \"%s\": %s", outPath, SDL_GetError());
+		status = 1;
+	}
+	else if (status == 0)
+	{
+		SDL_Log("Baked %u glyphs into a %ux%u atlas", cache.numEntries, cache.width, cache.nextShelfY);
+	}
+
+	NeHe_DestroyGlyphCache(&ctx, &cache);
+	return status;
+}
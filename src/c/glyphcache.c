@@ -0,0 +1,843 @@
+/*
+ * SPDX-FileCopyrightText: (C) 2025 a dinosaur
+ * SPDX-License-Identifier: Zlib
+ */
+
+#include "glyphcache.h"
+#include "sdl_stbtt.h"
+
+
+extern inline float NeHe_GlyphScale(const NeHeGlyphCache* cache, unsigned pixelHeight);
+
+#define GLYPH_EMPTY       UINT32_MAX
+#define GLYPH_NO_SHELF    UINT16_MAX
+#define GLYPH_SHELF_ROUND 8u
+
+// Distance fields cover this many texels either side of the outline
+#define GLYPH_SDF_PADDING 4
+#define GLYPH_SDF_EDGE    128
+
+// Baked glyph files start with "NGLY" and a version, everything in them is little-endian
+#define GLYPH_BAKE_MAGIC   0x594C474Eu
+#define GLYPH_BAKE_VERSION 1
+
+struct NeHeGlyphEntry
+{
+	NeHeGlyph glyph;
+	uint32_t codepoint;
+	uint16_t pixelHeight;  // 0 for entries on the free list
+	uint32_t next;  // Next glyph on the same shelf, or the next free entry
+};
+
+struct NeHeGlyphShelf
+{
+	uint32_t y, height, x;
+	uint32_t lastUsed;
+	uint32_t firstEntry;
+};
+
+
+static inline uint32_t NeHe_HashGlyph(uint32_t codepoint, unsigned pixelHeight)
+{
+	uint32_t hash = codepoint * 0x9E3779B1u ^ (uint32_t)pixelHeight * 0x85EBCA77u;
+	hash ^= hash >> 16;
+	return hash * 0x7FEB352Du;
+}
+
+static void NeHe_DirtyGlyphRect(NeHeGlyphCache* cache, uint32_t x, uint32_t y, uint32_t w, uint32_t h)
+{
+	// Once there are too many little rectangles just upload the band of rows they all fit in
+	if (cache->numDirty == NEHE_GLYPH_MAX_UPLOADS)
+	{
+		uint32_t top = y, bottom = y + h;
+		for (unsigned i = 0; i < cache->numDirty; ++i)
+		{
+			top = SDL_min(top, cache->dirty[i].y);
+			bottom = SDL_max(bottom, (uint32_t)cache->dirty[i].y + cache->dirty[i].h);
+		}
+		cache->dirty[0] = (NeHeGlyphRect){ 0, (uint16_t)top, (uint16_t)cache->width, (uint16_t)(bottom - top) };
+		cache->numDirty = 1;
+		return;
+	}
+	cache->dirty[cache->numDirty++] = (NeHeGlyphRect){ (uint16_t)x, (uint16_t)y, (uint16_t)w, (uint16_t)h };
+}
+
+static bool NeHe_RehashGlyphs(NeHeGlyphCache* cache, uint32_t tableSize)
+{
+	uint32_t* table = SDL_malloc(sizeof(uint32_t) * tableSize);
+	if (!table)
+	{
+		return false;
+	}
+	SDL_memset(table, 0xFF, sizeof(uint32_t) * tableSize);
+	for (uint32_t i = 0; i < cache->entryCapacity; ++i)
+	{
+		const NeHeGlyphEntry* entry = &cache->entries[i];
+		if (entry->pixelHeight == 0)
+		{
+			continue;
+		}
+		uint32_t slot = NeHe_HashGlyph(entry->codepoint, entry->pixelHeight) & (tableSize - 1);
+		while (table[slot] != GLYPH_EMPTY)
+		{
+			slot = (slot + 1) & (tableSize - 1);
+		}
+		table[slot] = i;
+	}
+	SDL_free(cache->table);
+	cache->table = table;
+	cache->tableSize = tableSize;
+	return true;
+}
+
+static uint32_t NeHe_FindGlyphSlot(const NeHeGlyphCache* cache, uint32_t codepoint, unsigned pixelHeight)
+{
+	const uint32_t mask = cache->tableSize - 1;
+	uint32_t slot = NeHe_HashGlyph(codepoint, pixelHeight) & mask;
+	while (cache->table[slot] != GLYPH_EMPTY)
+	{
+		const NeHeGlyphEntry* entry = &cache->entries[cache->table[slot]];
+		if (entry->codepoint == codepoint && entry->pixelHeight == pixelHeight)
+		{
+			break;
+		}
+		slot = (slot + 1) & mask;
+	}
+	return slot;
+}
+
+static void NeHe_FreeGlyphEntry(NeHeGlyphCache* cache, uint32_t entryIdx)
+{
+	NeHeGlyphEntry* entry = &cache->entries[entryIdx];
+	entry->pixelHeight = 0;
+	entry->next = cache->freeEntry;
+	cache->freeEntry = entryIdx;
+	--cache->numEntries;
+}
+
+static void NeHe_RemoveGlyph(NeHeGlyphCache* cache, uint32_t entryIdx)
+{
+	NeHeGlyphEntry* entry = &cache->entries[entryIdx];
+	const uint32_t mask = cache->tableSize - 1;
+	uint32_t slot = NeHe_FindGlyphSlot(cache, entry->codepoint, entry->pixelHeight);
+	SDL_assert(cache->table[slot] == entryIdx);
+
+	// Shift later members of the probe run back into the hole so lookups never stop short
+	for (uint32_t next = (slot + 1) & mask; cache->table[next] != GLYPH_EMPTY; next = (next + 1) & mask)
+	{
+		const NeHeGlyphEntry* moved = &cache->entries[cache->table[next]];
+		const uint32_t home = NeHe_HashGlyph(moved->codepoint, moved->pixelHeight) & mask;
+		if (((next - home) & mask) >= ((next - slot) & mask))
+		{
+			cache->table[slot] = cache->table[next];
+			slot = next;
+		}
+	}
+	cache->table[slot] = GLYPH_EMPTY;
+
+	NeHe_FreeGlyphEntry(cache, entryIdx);
+}
+
+static bool NeHe_AddShelf(NeHeGlyphCache* cache, uint32_t height)
+{
+	if (cache->numShelves == cache->shelfCapacity)
+	{
+		const unsigned capacity = SDL_max(cache->shelfCapacity * 2, 16);
+		NeHeGlyphShelf* shelves = SDL_realloc(cache->shelves, sizeof(NeHeGlyphShelf) * capacity);
+		if (!shelves)
+		{
+			return false;
+		}
+		cache->shelves = shelves;
+		cache->shelfCapacity = capacity;
+	}
+	cache->shelves[cache->numShelves++] = (NeHeGlyphShelf)
+	{
+		.y = cache->nextShelfY,
+		.height = height,
+		.x = 0,
+		.lastUsed = cache->frame,
+		.firstEntry = GLYPH_EMPTY
+	};
+	cache->nextShelfY += height;
+	return true;
+}
+
+static bool NeHe_GrowGlyphAtlas(NeHeGlyphCache* cache, uint32_t minHeight)
+{
+	uint32_t height = cache->height;
+	while (height < minHeight)
+	{
+		height *= 2;
+	}
+	height = SDL_min(height, cache->maxHeight);
+	if (height < minHeight)
+	{
+		return false;
+	}
+
+	// New rows start out clear, the texture itself is replaced on the next update
+	uint8_t* pixels = SDL_realloc(cache->pixels, (size_t)cache->width * height);
+	if (!pixels)
+	{
+		return false;
+	}
+	SDL_memset(pixels + (size_t)cache->width * cache->height, 0, (size_t)cache->width * (height - cache->height));
+	NeHe_DirtyGlyphRect(cache, 0, cache->height, cache->width, height - cache->height);
+	cache->pixels = pixels;
+	cache->height = height;
+	return true;
+}
+
+static inline uint32_t NeHe_ShelfHeight(const NeHeGlyphCache* cache, uint32_t h)
+{
+	return SDL_min((h + GLYPH_SHELF_ROUND - 1) & ~(GLYPH_SHELF_ROUND - 1), cache->maxHeight);
+}
+
+// Evict a run of neighbouring shelves and merge them into the first one, any height beyond what's needed is split
+// off into an empty shelf after it
+static void NeHe_EvictShelves(NeHeGlyphCache* cache, unsigned first, unsigned count, uint32_t height)
+{
+	NeHeGlyphShelf* shelf = &cache->shelves[first];
+	for (unsigned i = first; i < first + count; ++i)
+	{
+		for (uint32_t entryIdx = cache->shelves[i].firstEntry; entryIdx != GLYPH_EMPTY;)
+		{
+			const uint32_t next = cache->entries[entryIdx].next;
+			NeHe_RemoveGlyph(cache, entryIdx);
+			entryIdx = next;
+		}
+		cache->shelves[i].firstEntry = GLYPH_EMPTY;
+		if (i != first)
+		{
+			// Merged shelves are left empty rather than removed so entries can keep referring to shelves by index
+			shelf->height += cache->shelves[i].height;
+			cache->shelves[i].height = 0;
+		}
+	}
+	shelf->x = 0;
+
+	// Clear out the old glyphs so nothing bleeds into the padding of new ones
+	SDL_memset(cache->pixels + (size_t)cache->width * shelf->y, 0, (size_t)cache->width * shelf->height);
+	NeHe_DirtyGlyphRect(cache, 0, shelf->y, cache->width, shelf->height);
+	++cache->generation;
+
+	NeHeGlyphShelf* next = first + 1 < cache->numShelves ? &cache->shelves[first + 1] : NULL;
+	if (next && next->height == 0 && shelf->height >= height + GLYPH_SHELF_ROUND)
+	{
+		*next = (NeHeGlyphShelf)
+		{
+			.y = shelf->y + height,
+			.height = shelf->height - height,
+			.lastUsed = shelf->lastUsed,
+			.firstEntry = GLYPH_EMPTY
+		};
+		shelf->height = height;
+	}
+}
+
+static bool NeHe_AllocGlyphRect(NeHeGlyphCache* cache, uint32_t w, uint32_t h, unsigned* outShelf)
+{
+	// Tightest shelf with room left, short glyphs on much taller shelves are only a last resort before eviction
+	uint32_t best = GLYPH_EMPTY, loose = GLYPH_EMPTY;
+	for (unsigned i = 0; i < cache->numShelves; ++i)
+	{
+		const NeHeGlyphShelf* shelf = &cache->shelves[i];
+		if (shelf->height >= h && cache->width - shelf->x >= w
+			&& (loose == GLYPH_EMPTY || shelf->height < cache->shelves[loose].height))
+		{
+			loose = i;
+		}
+	}
+	if (loose != GLYPH_EMPTY && (h * 4 >= cache->shelves[loose].height * 3
+		|| NeHe_ShelfHeight(cache, h) >= cache->shelves[loose].height))
+	{
+		*outShelf = loose;
+		return true;
+	}
+
+	// Start a new shelf at the bottom, growing the atlas if it doesn't fit. Heights are rounded up so shelves
+	// left behind by one font size can be reused for others after eviction
+	const uint32_t shelfHeight = NeHe_ShelfHeight(cache, h);
+	const uint32_t bottom = cache->nextShelfY + shelfHeight;
+	if ((bottom <= cache->height || NeHe_GrowGlyphAtlas(cache, bottom)) && NeHe_AddShelf(cache, shelfHeight))
+	{
+		*outShelf = cache->numShelves - 1;
+		return true;
+	}
+	if (loose != GLYPH_EMPTY)
+	{
+		*outShelf = loose;
+		return true;
+	}
+
+	// Out of space, throw out the least recently used run of shelves that's tall enough. Shelves are kept in order
+	// top to bottom, so neighbours in the list are neighbours in the atlas and can be merged to fit taller glyphs
+	unsigned bestCount = 0;
+	uint32_t bestUsed = 0;
+	for (unsigned i = 0; i < cache->numShelves; ++i)
+	{
+		uint32_t height = 0, lastUsed = 0;
+		unsigned count = 0;
+		while (height < h && i + count < cache->numShelves && cache->shelves[i + count].lastUsed != cache->frame)
+		{
+			height += cache->shelves[i + count].height;
+			lastUsed = SDL_max(lastUsed, cache->shelves[i + count].lastUsed);
+			++count;
+		}
+		if (height >= h && (best == GLYPH_EMPTY || lastUsed < bestUsed || (lastUsed == bestUsed && count < bestCount)))
+		{
+			best = i;
+			bestCount = count;
+			bestUsed = lastUsed;
+		}
+	}
+	if (best == GLYPH_EMPTY)
+	{
+		return SDL_SetError("Glyph atlas is full");
+	}
+	NeHe_EvictShelves(cache, best, bestCount, NeHe_ShelfHeight(cache, h));
+	*outShelf = best;
+	return true;
+}
+
+static uint32_t NeHe_NewGlyphEntry(NeHeGlyphCache* cache)
+{
+	if (cache->freeEntry == GLYPH_EMPTY)
+	{
+		// Grow the pool and thread the new entries onto the free list
+		const uint32_t capacity = SDL_max(cache->entryCapacity * 2, 128);
+		NeHeGlyphEntry* entries = SDL_realloc(cache->entries, sizeof(NeHeGlyphEntry) * capacity);
+		if (!entries)
+		{
+			return GLYPH_EMPTY;
+		}
+		for (uint32_t i = cache->entryCapacity; i < capacity; ++i)
+		{
+			entries[i].pixelHeight = 0;
+			entries[i].next = i + 1 < capacity ? i + 1 : GLYPH_EMPTY;
+		}
+		cache->entries = entries;
+		cache->freeEntry = cache->entryCapacity;
+		cache->entryCapacity = capacity;
+	}
+	// Keep the table at most half full
+	if (2 * (cache->numEntries + 1) > cache->tableSize && !NeHe_RehashGlyphs(cache, cache->tableSize * 2))
+	{
+		return GLYPH_EMPTY;
+	}
+
+	const uint32_t entryIdx = cache->freeEntry;
+	cache->freeEntry = cache->entries[entryIdx].next;
+	++cache->numEntries;
+	return entryIdx;
+}
+
+
+static bool NeHe_LoadGlyphFont(NeHeGlyphCache* restrict cache, const char* restrict path)
+{
+	cache->ttf = SDL_LoadFile(path, NULL);
+	if (!cache->ttf)
+	{
+		return false;
+	}
+	cache->font = SDL_malloc(sizeof(stbtt_fontinfo));
+	if (!cache->font || !stbtt_InitFont(cache->font, cache->ttf, stbtt_GetFontOffsetForIndex(cache->ttf, 0)))
+	{
+		SDL_free(cache->font);
+		SDL_free(cache->ttf);
+		cache->font = NULL;
+		cache->ttf = NULL;
+		return SDL_SetError("Failed to load font \"%s\"", path);
+	}
+	return true;
+}
+
+static bool NeHe_InitGlyphCache(NeHeGlyphCache* cache, uint32_t width, uint32_t height, uint32_t maxHeight,
+	unsigned sdfHeight)
+{
+	SDL_assert(width > 0 && width <= UINT16_MAX && height > 0 && height <= maxHeight && maxHeight <= UINT16_MAX);
+
+	// The whole atlas starts out clear and dirty, so the first update defines every texel
+	cache->pixels = SDL_calloc((size_t)width * height, 1);
+	cache->freeEntry = GLYPH_EMPTY;
+	if (!cache->pixels || !NeHe_RehashGlyphs(cache, 256))
+	{
+		return false;
+	}
+	cache->width = width;
+	cache->height = height;
+	cache->maxHeight = maxHeight;
+	cache->sdfHeight = sdfHeight;
+	NeHe_DirtyGlyphRect(cache, 0, 0, width, height);
+	return true;
+}
+
+static bool NeHe_ReadBakedGlyph(SDL_IOStream* restrict file, NeHeGlyphEntry* restrict entry)
+{
+	uint16_t pixelHeight, x, y, w, h, shelf;
+	Sint16 xOffset, yOffset;
+	uint32_t advance;
+	if (!SDL_ReadU32LE(file, &entry->codepoint) || !SDL_ReadU16LE(file, &pixelHeight)
+		|| !SDL_ReadU16LE(file, &x) || !SDL_ReadU16LE(file, &y) || !SDL_ReadU16LE(file, &w) || !SDL_ReadU16LE(file, &h)
+		|| !SDL_ReadS16LE(file, &xOffset) || !SDL_ReadS16LE(file, &yOffset)
+		|| !SDL_ReadU16LE(file, &shelf) || !SDL_ReadU32LE(file, &advance))
+	{
+		return false;
+	}
+	entry->pixelHeight = pixelHeight;
+	entry->glyph = (NeHeGlyph)
+	{
+		.x = x, .y = y, .w = w, .h = h,
+		.xOffset = xOffset, .yOffset = yOffset,
+		.shelf = shelf
+	};
+	SDL_memcpy(&entry->glyph.advance, &advance, sizeof(float));
+	return true;
+}
+
+static bool NeHe_WriteBakedGlyph(SDL_IOStream* restrict file, const NeHeGlyphEntry* restrict entry)
+{
+	const NeHeGlyph* glyph = &entry->glyph;
+	uint32_t advance;
+	SDL_memcpy(&advance, &glyph->advance, sizeof(float));
+	return SDL_WriteU32LE(file, entry->codepoint) && SDL_WriteU16LE(file, entry->pixelHeight)
+		&& SDL_WriteU16LE(file, glyph->x) && SDL_WriteU16LE(file, glyph->y)
+		&& SDL_WriteU16LE(file, glyph->w) && SDL_WriteU16LE(file, glyph->h)
+		&& SDL_WriteS16LE(file, glyph->xOffset) && SDL_WriteS16LE(file, glyph->yOffset)
+		&& SDL_WriteU16LE(file, glyph->shelf) && SDL_WriteU32LE(file, advance);
+}
+
+static bool NeHe_ReadBakedGlyphs(NeHeGlyphCache* restrict cache, SDL_IOStream* restrict file, uint32_t maxHeight)
+{
+	uint32_t magic, numGlyphs;
+	uint16_t version, sdfHeight, width, height, numShelves;
+	if (!SDL_ReadU32LE(file, &magic) || !SDL_ReadU16LE(file, &version) || !SDL_ReadU16LE(file, &sdfHeight)
+		|| !SDL_ReadU16LE(file, &width) || !SDL_ReadU16LE(file, &height)
+		|| !SDL_ReadU16LE(file, &numShelves) || !SDL_ReadU32LE(file, &numGlyphs))
+	{
+		return false;
+	}
+	if (magic != GLYPH_BAKE_MAGIC || version != GLYPH_BAKE_VERSION)
+	{
+		return SDL_SetError("Not a baked glyph file, or from a different version of fontbake");
+	}
+	if (width == 0 || height == 0 || height > maxHeight)
+	{
+		return SDL_SetError("Baked atlas is %ux%u, taller than the maximum of %u", width, height, maxHeight);
+	}
+	if (!NeHe_InitGlyphCache(cache, width, height, maxHeight, sdfHeight)
+		|| SDL_ReadIO(file, cache->pixels, (size_t)width * height) != (size_t)width * height)
+	{
+		return false;
+	}
+
+	// Shelves are restored exactly as they were left, so glyphs rasterised later pack around the baked ones
+	cache->shelves = SDL_malloc(sizeof(NeHeGlyphShelf) * SDL_max(numShelves, 1u));
+	if (!cache->shelves)
+	{
+		return false;
+	}
+	cache->shelfCapacity = SDL_max(numShelves, 1u);
+	for (; cache->numShelves < numShelves; ++cache->numShelves)
+	{
+		uint16_t y, shelfHeight, x;
+		if (!SDL_ReadU16LE(file, &y) || !SDL_ReadU16LE(file, &shelfHeight) || !SDL_ReadU16LE(file, &x))
+		{
+			return false;
+		}
+		if ((uint32_t)y + shelfHeight > height || x > width)
+		{
+			return SDL_SetError("Baked shelf %u is outside of the atlas", cache->numShelves);
+		}
+		cache->shelves[cache->numShelves] = (NeHeGlyphShelf)
+		{
+			.y = y, .height = shelfHeight, .x = x,
+			.lastUsed = cache->frame,
+			.firstEntry = GLYPH_EMPTY
+		};
+		cache->nextShelfY = SDL_max(cache->nextShelfY, (uint32_t)y + shelfHeight);
+	}
+
+	for (uint32_t i = 0; i < numGlyphs; ++i)
+	{
+		NeHeGlyphEntry baked;
+		if (!NeHe_ReadBakedGlyph(file, &baked))
+		{
+			return false;
+		}
+		const NeHeGlyph* glyph = &baked.glyph;
+		if (baked.pixelHeight == 0 || (glyph->shelf != GLYPH_NO_SHELF && (glyph->shelf >= numShelves
+			|| (uint32_t)glyph->x + glyph->w > width || (uint32_t)glyph->y + glyph->h > height)))
+		{
+			return SDL_SetError("Baked glyph U+%04X is outside of the atlas", baked.codepoint);
+		}
+		if (cache->table[NeHe_FindGlyphSlot(cache, baked.codepoint, baked.pixelHeight)] != GLYPH_EMPTY)
+		{
+			continue;
+		}
+
+		const uint32_t entryIdx = NeHe_NewGlyphEntry(cache);
+		if (entryIdx == GLYPH_EMPTY)
+		{
+			return false;
+		}
+		NeHeGlyphEntry* entry = &cache->entries[entryIdx];
+		*entry = baked;
+		entry->next = GLYPH_EMPTY;
+		if (glyph->shelf != GLYPH_NO_SHELF)
+		{
+			entry->next = cache->shelves[glyph->shelf].firstEntry;
+			cache->shelves[glyph->shelf].firstEntry = entryIdx;
+		}
+		cache->table[NeHe_FindGlyphSlot(cache, baked.codepoint, baked.pixelHeight)] = entryIdx;
+	}
+	return true;
+}
+
+
+bool NeHe_CreateGlyphCache(NeHeContext* restrict ctx, NeHeGlyphCache* restrict cache,
+	const char* restrict ttfResourcePath, uint32_t width, uint32_t height, uint32_t maxHeight, unsigned sdfHeight)
+{
+	SDL_zerop(cache);
+
+	char* path = NeHe_ResourcePath(ctx, ttfResourcePath);
+	if (!path)
+	{
+		return false;
+	}
+	const bool loaded = NeHe_LoadGlyphFont(cache, path);
+	SDL_free(path);
+	if (!loaded)
+	{
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Failed to read font file: %s", SDL_GetError());
+		return false;
+	}
+
+	if (!NeHe_InitGlyphCache(cache, width, height, maxHeight, sdfHeight))
+	{
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Failed to allocate glyph cache: %s", SDL_GetError());
+		NeHe_DestroyGlyphCache(ctx, cache);
+		return false;
+	}
+	return true;
+}
+
+bool NeHe_LoadGlyphCache(NeHeContext* restrict ctx, NeHeGlyphCache* restrict cache,
+	const char* restrict bakedResourcePath, const char* restrict ttfResourcePath, uint32_t maxHeight)
+{
+	SDL_zerop(cache);
+	SDL_assert(maxHeight <= UINT16_MAX);
+
+	SDL_IOStream* file = NeHe_OpenResource(ctx, bakedResourcePath, "rb");
+	if (!file)
+	{
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "SDL_IOFromFile: %s", SDL_GetError());
+		return false;
+	}
+	const bool loaded = NeHe_ReadBakedGlyphs(cache, file, maxHeight);
+	SDL_CloseIO(file);
+	if (!loaded)
+	{
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Failed to load baked glyphs \"%s\": %s",
+			bakedResourcePath, SDL_GetError());
+		NeHe_DestroyGlyphCache(ctx, cache);
+		return false;
+	}
+
+	if (ttfResourcePath && (cache->ttfPath = NeHe_ResourcePath(ctx, ttfResourcePath)) == NULL)
+	{
+		NeHe_DestroyGlyphCache(ctx, cache);
+		return false;
+	}
+	return true;
+}
+
+bool NeHe_SaveGlyphCache(const NeHeGlyphCache* restrict cache, const char* restrict path)
+{
+	SDL_IOStream* file = SDL_IOFromFile(path, "wb");
+	if (!file)
+	{
+		return false;
+	}
+
+	// Rows below the last shelf were never touched, so they're left out
+	const uint32_t height = SDL_max(cache->nextShelfY, 1u);
+	bool written = SDL_WriteU32LE(file, GLYPH_BAKE_MAGIC) && SDL_WriteU16LE(file, GLYPH_BAKE_VERSION)
+		&& SDL_WriteU16LE(file, (uint16_t)cache->sdfHeight)
+		&& SDL_WriteU16LE(file, (uint16_t)cache->width) && SDL_WriteU16LE(file, (uint16_t)height)
+		&& SDL_WriteU16LE(file, (uint16_t)cache->numShelves) && SDL_WriteU32LE(file, cache->numEntries)
+		&& SDL_WriteIO(file, cache->pixels, (size_t)cache->width * height) == (size_t)cache->width * height;
+	for (unsigned i = 0; written && i < cache->numShelves; ++i)
+	{
+		const NeHeGlyphShelf* shelf = &cache->shelves[i];
+		written = SDL_WriteU16LE(file, (uint16_t)shelf->y) && SDL_WriteU16LE(file, (uint16_t)shelf->height)
+			&& SDL_WriteU16LE(file, (uint16_t)shelf->x);
+	}
+	for (uint32_t i = 0; written && i < cache->entryCapacity; ++i)
+	{
+		if (cache->entries[i].pixelHeight != 0)
+		{
+			written = NeHe_WriteBakedGlyph(file, &cache->entries[i]);
+		}
+	}
+	return SDL_CloseIO(file) && written;
+}
+
+void NeHe_DestroyGlyphCache(NeHeContext* restrict ctx, NeHeGlyphCache* restrict cache)
+{
+	SDL_free(cache->shelves);
+	SDL_free(cache->table);
+	SDL_free(cache->entries);
+	SDL_free(cache->font);
+	SDL_free(cache->ttf);
+	SDL_free(cache->ttfPath);
+	SDL_free(cache->pixels);
+	SDL_ReleaseGPUTransferBuffer(ctx->device, cache->xferBuffer);
+	SDL_ReleaseGPUTexture(ctx->device, cache->texture);
+	SDL_zerop(cache);
+}
+
+bool NeHe_GetGlyph(NeHeGlyphCache* restrict cache, uint32_t codepoint, unsigned pixelHeight,
+	NeHeGlyph* restrict outGlyph)
+{
+	// Distance fields scale, so they're only stored at one size
+	pixelHeight = cache->sdfHeight ? cache->sdfHeight : pixelHeight;
+	SDL_assert(pixelHeight > 0 && pixelHeight < UINT16_MAX);
+
+	const uint32_t slot = NeHe_FindGlyphSlot(cache, codepoint, pixelHeight);
+	if (cache->table[slot] != GLYPH_EMPTY)
+	{
+		*outGlyph = cache->entries[cache->table[slot]].glyph;
+		NeHe_TouchGlyph(cache, outGlyph->shelf);
+		return true;
+	}
+
+	// A baked cache only reads its font once it's missing a glyph
+	if (!cache->font)
+	{
+		if (!cache->ttfPath)
+		{
+			return SDL_SetError("Glyph U+%04X at %u pixels wasn't baked", codepoint, pixelHeight);
+		}
+		const bool loaded = NeHe_LoadGlyphFont(cache, cache->ttfPath);
+		SDL_free(cache->ttfPath);
+		cache->ttfPath = NULL;
+		if (!loaded)
+		{
+			SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Failed to read font file: %s", SDL_GetError());
+			return false;
+		}
+	}
+
+	// Measure the glyph, distance fields have to be generated up front to know their size
+	const stbtt_fontinfo* font = cache->font;
+	const float scale = stbtt_ScaleForPixelHeight(font, (float)pixelHeight);
+	const int glyphIdx = stbtt_FindGlyphIndex(font, (int)codepoint);
+	int advance, x0 = 0, y0 = 0, w = 0, h = 0;
+	unsigned char* sdf = NULL;
+	stbtt_GetGlyphHMetrics(font, glyphIdx, &advance, NULL);
+	if (cache->sdfHeight)
+	{
+		sdf = stbtt_GetGlyphSDF(font, scale, glyphIdx, GLYPH_SDF_PADDING, GLYPH_SDF_EDGE,
+			(float)GLYPH_SDF_EDGE / (float)GLYPH_SDF_PADDING, &w, &h, &x0, &y0);
+	}
+	else
+	{
+		int x1, y1;
+		stbtt_GetGlyphBitmapBox(font, glyphIdx, scale, scale, &x0, &y0, &x1, &y1);
+		w = x1 - x0;
+		h = y1 - y0;
+	}
+	NeHeGlyph glyph =
+	{
+		.w = (uint16_t)w, .h = (uint16_t)h,
+		.xOffset = (int16_t)x0, .yOffset = (int16_t)y0,
+		.shelf = GLYPH_NO_SHELF,
+		.advance = scale * (float)advance
+	};
+	if ((uint32_t)glyph.w + 1 > cache->width || (uint32_t)glyph.h + 1 > cache->maxHeight)
+	{
+		stbtt_FreeSDF(sdf, NULL);
+		return SDL_SetError("Glyph U+%04X at %u pixels is larger than the atlas", codepoint, pixelHeight);
+	}
+
+	// Take an entry before any atlas space, so failing to grow the pool can't leave a rect allocated to nothing
+	const uint32_t entryIdx = NeHe_NewGlyphEntry(cache);
+	if (entryIdx == GLYPH_EMPTY)
+	{
+		stbtt_FreeSDF(sdf, NULL);
+		return false;
+	}
+
+	// Blank glyphs like space take no room in the atlas, everything else gets a clear texel to its right & below
+	if (glyph.w > 0 && glyph.h > 0)
+	{
+		const uint32_t rectW = glyph.w + 1u, rectH = glyph.h + 1u;
+		unsigned shelfNum;
+		if (!NeHe_AllocGlyphRect(cache, rectW, rectH, &shelfNum))
+		{
+			NeHe_FreeGlyphEntry(cache, entryIdx);
+			stbtt_FreeSDF(sdf, NULL);
+			return false;
+		}
+		NeHeGlyphShelf* shelf = &cache->shelves[shelfNum];
+		glyph.x = (uint16_t)shelf->x;
+		glyph.y = (uint16_t)shelf->y;
+		shelf->x += rectW;
+		shelf->lastUsed = cache->frame;
+		glyph.shelf = (uint16_t)shelfNum;
+
+		uint8_t* dst = cache->pixels + (size_t)cache->width * glyph.y + glyph.x;
+		for (uint32_t row = 0; row < rectH; ++row)
+		{
+			SDL_memset(dst + (size_t)cache->width * row, 0, rectW);
+		}
+		if (sdf)
+		{
+			for (uint32_t row = 0; row < glyph.h; ++row)
+			{
+				SDL_memcpy(dst + (size_t)cache->width * row, sdf + (size_t)glyph.w * row, glyph.w);
+			}
+		}
+		else
+		{
+			stbtt_MakeGlyphBitmap(font, dst, glyph.w, glyph.h, (int)cache->width, scale, scale, glyphIdx);
+		}
+		NeHe_DirtyGlyphRect(cache, glyph.x, glyph.y, rectW, rectH);
+	}
+	stbtt_FreeSDF(sdf, NULL);
+
+	NeHeGlyphEntry* entry = &cache->entries[entryIdx];
+	*entry = (NeHeGlyphEntry)
+	{
+		.glyph = glyph,
+		.codepoint = codepoint,
+		.pixelHeight = (uint16_t)pixelHeight,
+		.next = GLYPH_EMPTY
+	};
+	if (glyph.shelf != GLYPH_NO_SHELF)
+	{
+		entry->next = cache->shelves[glyph.shelf].firstEntry;
+		cache->shelves[glyph.shelf].firstEntry = entryIdx;
+	}
+	cache->table[NeHe_FindGlyphSlot(cache, codepoint, pixelHeight)] = entryIdx;
+
+	*outGlyph = glyph;
+	return true;
+}
+
+void NeHe_TouchGlyph(NeHeGlyphCache* cache, uint16_t shelf)
+{
+	if (shelf != GLYPH_NO_SHELF)
+	{
+		cache->shelves[shelf].lastUsed = cache->frame;
+	}
+}
+
+bool NeHe_UpdateGlyphCache(NeHeContext* restrict ctx, NeHeGlyphCache* restrict cache,
+	SDL_GPUCommandBuffer* restrict cmd)
+{
+	++cache->frame;
+	if (cache->numDirty == 0 && cache->textureHeight == cache->height)
+	{
+		return true;
+	}
+
+	// Replace the texture when the atlas has grown, keeping what's already on the GPU
+	SDL_GPUTexture* oldTexture = NULL;
+	if (cache->textureHeight != cache->height)
+	{
+		SDL_GPUTexture* texture = SDL_CreateGPUTexture(ctx->device, &(const SDL_GPUTextureCreateInfo)
+		{
+			.type = SDL_GPU_TEXTURETYPE_2D,
+			.format = SDL_GPU_TEXTUREFORMAT_A8_UNORM,
+			.usage = SDL_GPU_TEXTUREUSAGE_SAMPLER,
+			.width = cache->width, .height = cache->height, .layer_count_or_depth = 1,
+			.num_levels = 1,
+			.sample_count = SDL_GPU_SAMPLECOUNT_1
+		});
+		if (!texture)
+		{
+			SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "SDL_CreateGPUTexture: %s", SDL_GetError());
+			return false;
+		}
+		oldTexture = cache->texture;
+		cache->texture = texture;
+	}
+
+	// Pack dirty rectangles back-to-back into the transfer buffer
+	uint32_t size = 0;
+	for (unsigned i = 0; i < cache->numDirty; ++i)
+	{
+		size += (uint32_t)cache->dirty[i].w * cache->dirty[i].h;
+	}
+	if (size > cache->xferSize)
+	{
+		SDL_ReleaseGPUTransferBuffer(ctx->device, cache->xferBuffer);
+		cache->xferBuffer = SDL_CreateGPUTransferBuffer(ctx->device, &(const SDL_GPUTransferBufferCreateInfo)
+		{
+			.usage = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD,
+			.size = size
+		});
+		cache->xferSize = cache->xferBuffer ? size : 0;
+		if (!cache->xferBuffer)
+		{
+			SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "SDL_CreateGPUTransferBuffer: %s", SDL_GetError());
+			SDL_ReleaseGPUTexture(ctx->device, oldTexture);
+			return false;
+		}
+	}
+	uint8_t* map = size ? SDL_MapGPUTransferBuffer(ctx->device, cache->xferBuffer, true) : NULL;
+	if (size && !map)
+	{
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "SDL_MapGPUTransferBuffer: %s", SDL_GetError());
+		SDL_ReleaseGPUTexture(ctx->device, oldTexture);
+		return false;
+	}
+	for (unsigned i = 0, offset = 0; i < cache->numDirty; ++i)
+	{
+		const NeHeGlyphRect* rect = &cache->dirty[i];
+		for (uint32_t row = 0; row < rect->h; ++row, offset += rect->w)
+		{
+			SDL_memcpy(map + offset, cache->pixels + (size_t)cache->width * (rect->y + row) + rect->x, rect->w);
+		}
+	}
+	if (map)
+	{
+		SDL_UnmapGPUTransferBuffer(ctx->device, cache->xferBuffer);
+	}
+
+	SDL_GPUCopyPass* copyPass = SDL_BeginGPUCopyPass(cmd);
+	if (oldTexture)
+	{
+		// Old rows are copied on the GPU, only the freshly added rows are in the dirty list
+		SDL_CopyGPUTextureToTexture(copyPass,
+			&(const SDL_GPUTextureLocation){ .texture = oldTexture },
+			&(const SDL_GPUTextureLocation){ .texture = cache->texture },
+			cache->width, cache->textureHeight, 1, false);
+		SDL_ReleaseGPUTexture(ctx->device, oldTexture);
+	}
+	for (unsigned i = 0, offset = 0; i < cache->numDirty; ++i)
+	{
+		const NeHeGlyphRect* rect = &cache->dirty[i];
+		SDL_UploadToGPUTexture(copyPass, &(const SDL_GPUTextureTransferInfo)
+		{
+			.transfer_buffer = cache->xferBuffer,
+			.offset = offset,
+			.pixels_per_row = rect->w,
+			.rows_per_layer = rect->h
+		}, &(const SDL_GPUTextureRegion)
+		{
+			.texture = cache->texture,
+			.x = rect->x, .y = rect->y,
+			.w = rect->w, .h = rect->h, .d = 1
+		}, false);
+		offset += (unsigned)rect->w * rect->h;
+	}
+	SDL_EndGPUCopyPass(copyPass);
+
+	cache->textureHeight = cache->height;
+	cache->numDirty = 0;
+	return true;
+}
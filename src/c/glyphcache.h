@@ -0,0 +1,84 @@
+#ifndef GLYPHCACHE_H
+#define GLYPHCACHE_H
+
+#include "nehe.h"
+
+struct stbtt_fontinfo;
+
+typedef struct
+{
+	uint16_t x, y, w, h;       // Rectangle in the atlas, in texels
+	int16_t xOffset, yOffset;  // From the pen position to the top left of the rectangle, Y down
+	uint16_t shelf;            // Where the glyph lives in the atlas, UINT16_MAX for blank glyphs
+	float advance;
+} NeHeGlyph;
+
+typedef struct NeHeGlyphEntry NeHeGlyphEntry;
+typedef struct NeHeGlyphShelf NeHeGlyphShelf;
+
+#define NEHE_GLYPH_MAX_UPLOADS 32
+
+typedef struct
+{
+	uint16_t x, y, w, h;
+} NeHeGlyphRect;
+
+typedef struct
+{
+	SDL_GPUTexture* texture;  // A8 atlas, replaced when the atlas grows
+	SDL_GPUTransferBuffer* xferBuffer;
+	uint8_t* pixels;  // CPU-side copy of the atlas, dirty rectangles are uploaded from here
+	uint32_t width, height, maxHeight;
+	uint32_t textureHeight;  // Height of the current texture, catches up with height on the next update
+	uint32_t xferSize;
+	NeHeGlyphRect dirty[NEHE_GLYPH_MAX_UPLOADS];
+	unsigned numDirty;
+
+	struct stbtt_fontinfo* font;
+	void* ttf;
+	char* ttfPath;  // Font of a baked cache, only read once a glyph that wasn't baked is looked up
+	unsigned sdfHeight;  // Non-zero when glyphs are stored once as distance fields at this height
+
+	// Glyphs are looked up by codepoint & pixel size through an open addressed table of entry numbers
+	NeHeGlyphEntry* entries;
+	uint32_t* table;
+	uint32_t numEntries, entryCapacity, freeEntry, tableSize;
+
+	// Shelves are evicted as a whole, least recently used first
+	NeHeGlyphShelf* shelves;
+	unsigned numShelves, shelfCapacity;
+	uint32_t nextShelfY;
+
+	uint32_t frame;
+	uint32_t generation;  // Changes whenever glyphs are evicted, so retained layouts know to look them up again
+} NeHeGlyphCache;
+
+// With a non-zero sdfHeight, glyphs are rasterised as signed distance fields that are 0.5 on the outline. Every pixel
+// height then shares the same atlas rectangles, scale the metrics by NeHe_GlyphScale to lay out text
+bool NeHe_CreateGlyphCache(NeHeContext* restrict ctx, NeHeGlyphCache* restrict cache,
+	const char* restrict ttfResourcePath, uint32_t width, uint32_t height, uint32_t maxHeight, unsigned sdfHeight);
+// Create a cache holding glyphs baked ahead of time with fontbake, so no font has to be parsed at startup. Glyphs
+// that weren't baked are rasterised from ttfResourcePath as usual, or fail to look up if it's NULL
+bool NeHe_LoadGlyphCache(NeHeContext* restrict ctx, NeHeGlyphCache* restrict cache,
+	const char* restrict bakedResourcePath, const char* restrict ttfResourcePath, uint32_t maxHeight);
+// Write the atlas & every glyph in it out for NeHe_LoadGlyphCache
+bool NeHe_SaveGlyphCache(const NeHeGlyphCache* restrict cache, const char* restrict path);
+void NeHe_DestroyGlyphCache(NeHeContext* restrict ctx, NeHeGlyphCache* restrict cache);
+
+// Look up a glyph at a pixel height, rasterising it into the atlas on first use. Glyphs looked up since the last
+// update are never evicted, fails if there's no room left for a new one
+bool NeHe_GetGlyph(NeHeGlyphCache* restrict cache, uint32_t codepoint, unsigned pixelHeight,
+	NeHeGlyph* restrict outGlyph);
+// Mark the shelf of a glyph looked up on an earlier frame as still in use, so it's kept without looking it up again
+void NeHe_TouchGlyph(NeHeGlyphCache* cache, uint16_t shelf);
+// Size of glyph metrics in pixels at a given pixel height
+inline float NeHe_GlyphScale(const NeHeGlyphCache* cache, unsigned pixelHeight)
+{
+	return cache->sdfHeight ? (float)pixelHeight / (float)cache->sdfHeight : 1.0f;
+}
+
+// Grow the atlas texture & upload new glyphs, call once per frame after all lookups and before drawing with it
+bool NeHe_UpdateGlyphCache(NeHeContext* restrict ctx, NeHeGlyphCache* restrict cache,
+	SDL_GPUCommandBuffer* restrict cmd);
+
+#endif//GLYPHCACHE_H
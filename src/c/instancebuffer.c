@@ -0,0 +1,247 @@
+/*
+ * SPDX-FileCopyrightText: (C) 2025 a dinosaur
+ * SPDX-License-Identifier: Zlib
+ */
+
+#include "instancebuffer.h"
+
+
+bool NeHe_CreateInstanceBuffer(NeHeContext* restrict ctx, NeHeInstanceBuffer* restrict ib,
+	uint32_t stride, uint32_t capacity, SDL_GPUBufferUsageFlags usage)
+{
+	SDL_zerop(ib);
+	SDL_assert(stride > 0 && capacity > 0);
+
+	ib->buffer = SDL_CreateGPUBuffer(ctx->device, &(const SDL_GPUBufferCreateInfo)
+	{
+		.usage = usage,
+		.size = stride * capacity
+	});
+	if (!ib->buffer)
+	{
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "SDL_CreateGPUBuffer: %s", SDL_GetError());
+		return false;
+	}
+
+	// The transfer buffer only ever holds dirty spans, so it never needs to be bigger than the buffer itself
+	ib->xferBuffer = SDL_CreateGPUTransferBuffer(ctx->device, &(const SDL_GPUTransferBufferCreateInfo)
+	{
+		.usage = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD,
+		.size = stride * capacity
+	});
+	if (!ib->xferBuffer)
+	{
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "SDL_CreateGPUTransferBuffer: %s", SDL_GetError());
+		SDL_ReleaseGPUBuffer(ctx->device, ib->buffer);
+		ib->buffer = NULL;
+		return false;
+	}
+
+	ib->shadow = SDL_calloc(capacity, stride);
+	if (!ib->shadow)
+	{
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "SDL_calloc: %s", SDL_GetError());
+		SDL_ReleaseGPUTransferBuffer(ctx->device, ib->xferBuffer);
+		SDL_ReleaseGPUBuffer(ctx->device, ib->buffer);
+		ib->xferBuffer = NULL;
+		ib->buffer = NULL;
+		return false;
+	}
+
+	ib->usage = usage;
+	ib->stride = stride;
+	ib->capacity = capacity;
+
+	// GPU buffer contents start out undefined, so the first upload needs to cover everything
+	NeHe_InvalidateInstances(ib, 0, capacity);
+	return true;
+}
+
+void NeHe_DestroyInstanceBuffer(NeHeContext* restrict ctx, NeHeInstanceBuffer* restrict ib)
+{
+	SDL_free(ib->shadow);
+	SDL_ReleaseGPUTransferBuffer(ctx->device, ib->xferBuffer);
+	SDL_ReleaseGPUBuffer(ctx->device, ib->buffer);
+	SDL_zerop(ib);
+}
+
+bool NeHe_ResizeInstanceBuffer(NeHeContext* restrict ctx, NeHeInstanceBuffer* restrict ib, uint32_t capacity)
+{
+	if (capacity == ib->capacity)
+	{
+		return true;
+	}
+
+	// Create the replacement before touching anything so failure leaves the old buffer intact
+	NeHeInstanceBuffer resized;
+	if (!NeHe_CreateInstanceBuffer(ctx, &resized, ib->stride, capacity, ib->usage))
+	{
+		return false;
+	}
+
+	// Carry over the shadow contents, the new GPU buffer is already fully dirty
+	SDL_memcpy(resized.shadow, ib->shadow, (size_t)SDL_min(capacity, ib->capacity) * ib->stride);
+	NeHe_DestroyInstanceBuffer(ctx, ib);
+	*ib = resized;
+	return true;
+}
+
+
+static void NeHe_MergeClosestDirtyRanges(NeHeInstanceBuffer* ib)
+{
+	SDL_assert(ib->numDirty >= 2);
+
+	// Find the pair of neighbouring ranges with the smallest gap between them
+	unsigned best = 0;
+	uint32_t bestGap = UINT32_MAX;
+	for (unsigned i = 0; i < ib->numDirty - 1; ++i)
+	{
+		const uint32_t gap = ib->dirty[i + 1].first - ib->dirty[i].last;
+		if (gap < bestGap)
+		{
+			bestGap = gap;
+			best = i;
+		}
+	}
+
+	// Uploading the gap again is cheaper than running out of ranges to track
+	ib->dirty[best].last = ib->dirty[best + 1].last;
+	SDL_memmove(&ib->dirty[best + 1], &ib->dirty[best + 2],
+		sizeof(NeHeInstanceRange) * (ib->numDirty - best - 2));
+	--ib->numDirty;
+}
+
+void NeHe_InvalidateInstances(NeHeInstanceBuffer* ib, uint32_t first, uint32_t count)
+{
+	if (count == 0)
+	{
+		return;
+	}
+	SDL_assert(first + count <= ib->capacity);
+	uint32_t last = first + count;
+
+	// Ranges are kept sorted, skip past those that end before the new one begins
+	unsigned i = 0;
+	while (i < ib->numDirty && ib->dirty[i].last < first)
+	{
+		++i;
+	}
+
+	// Absorb any ranges that overlap or touch the new one
+	unsigned j = i;
+	while (j < ib->numDirty && ib->dirty[j].first <= last)
+	{
+		first = SDL_min(first, ib->dirty[j].first);
+		last  = SDL_max(last, ib->dirty[j].last);
+		++j;
+	}
+	if (j > i)
+	{
+		ib->dirty[i] = (NeHeInstanceRange){ first, last };
+		SDL_memmove(&ib->dirty[i + 1], &ib->dirty[j], sizeof(NeHeInstanceRange) * (ib->numDirty - j));
+		ib->numDirty -= j - i - 1;
+		return;
+	}
+
+	// Disjoint from everything else, make room if needed and insert it
+	if (ib->numDirty == NEHE_INSTANCE_MAX_DIRTY)
+	{
+		NeHe_MergeClosestDirtyRanges(ib);
+		NeHe_InvalidateInstances(ib, first, last - first);
+		return;
+	}
+	SDL_memmove(&ib->dirty[i + 1], &ib->dirty[i], sizeof(NeHeInstanceRange) * (ib->numDirty - i));
+	ib->dirty[i] = (NeHeInstanceRange){ first, last };
+	++ib->numDirty;
+}
+
+void* NeHe_MapInstances(NeHeInstanceBuffer* ib, uint32_t first, uint32_t count)
+{
+	// Caller is going to write to the whole span, so mark it dirty up front
+	NeHe_InvalidateInstances(ib, first, count);
+	return ib->shadow + (size_t)first * ib->stride;
+}
+
+uint32_t NeHe_WriteInstances(NeHeInstanceBuffer* restrict ib, uint32_t first, uint32_t count,
+	const void* restrict data)
+{
+	SDL_assert(first + count <= ib->capacity);
+
+	const size_t stride = ib->stride;
+	const uint8_t* src = data;
+	uint8_t* dst = ib->shadow + first * stride;
+
+	// Only mark the instances that actually differ from what's already in the buffer
+	uint32_t numChanged = 0, runStart = UINT32_MAX;
+	for (uint32_t i = 0; i < count; ++i, src += stride, dst += stride)
+	{
+		if (SDL_memcmp(dst, src, stride) != 0)
+		{
+			SDL_memcpy(dst, src, stride);
+			if (runStart == UINT32_MAX)
+			{
+				runStart = i;
+			}
+			++numChanged;
+		}
+		else if (runStart != UINT32_MAX)
+		{
+			NeHe_InvalidateInstances(ib, first + runStart, i - runStart);
+			runStart = UINT32_MAX;
+		}
+	}
+	if (runStart != UINT32_MAX)
+	{
+		NeHe_InvalidateInstances(ib, first + runStart, count - runStart);
+	}
+	return numChanged;
+}
+
+bool NeHe_UploadInstances(NeHeContext* restrict ctx, NeHeInstanceBuffer* restrict ib,
+	SDL_GPUCommandBuffer* restrict cmd)
+{
+	// Nothing changed since the last upload, don't bother with a copy pass
+	if (ib->numDirty == 0)
+	{
+		return true;
+	}
+
+	// Pack dirty spans back-to-back into the transfer buffer
+	uint8_t* map = SDL_MapGPUTransferBuffer(ctx->device, ib->xferBuffer, true);
+	if (!map)
+	{
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "SDL_MapGPUTransferBuffer: %s", SDL_GetError());
+		return false;
+	}
+	uint32_t offset = 0;
+	for (unsigned i = 0; i < ib->numDirty; ++i)
+	{
+		const uint32_t size = (ib->dirty[i].last - ib->dirty[i].first) * ib->stride;
+		SDL_memcpy(map + offset, ib->shadow + ib->dirty[i].first * ib->stride, size);
+		offset += size;
+	}
+	SDL_UnmapGPUTransferBuffer(ctx->device, ib->xferBuffer);
+
+	// Upload each span to where it belongs, partial updates mustn't cycle or the rest of the buffer would be lost
+	SDL_GPUCopyPass* copyPass = SDL_BeginGPUCopyPass(cmd);
+	offset = 0;
+	for (unsigned i = 0; i < ib->numDirty; ++i)
+	{
+		const uint32_t size = (ib->dirty[i].last - ib->dirty[i].first) * ib->stride;
+		SDL_UploadToGPUBuffer(copyPass, &(const SDL_GPUTransferBufferLocation)
+		{
+			.transfer_buffer = ib->xferBuffer,
+			.offset = offset
+		}, &(const SDL_GPUBufferRegion)
+		{
+			.buffer = ib->buffer,
+			.offset = ib->dirty[i].first * ib->stride,
+			.size = size
+		}, false);
+		offset += size;
+	}
+	SDL_EndGPUCopyPass(copyPass);
+
+	ib->numDirty = 0;
+	return true;
+}
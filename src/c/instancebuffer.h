@@ -0,0 +1,36 @@
+#ifndef INSTANCEBUFFER_H
+#define INSTANCEBUFFER_H
+
+#include "nehe.h"
+
+#define NEHE_INSTANCE_MAX_DIRTY 8
+
+typedef struct
+{
+	uint32_t first, last;  // Half-open range of instances
+} NeHeInstanceRange;
+
+typedef struct
+{
+	SDL_GPUBuffer* buffer;
+	SDL_GPUTransferBuffer* xferBuffer;
+	SDL_GPUBufferUsageFlags usage;
+	uint8_t* shadow;  // CPU-side copy of what the GPU buffer holds (or will after the next upload)
+	uint32_t stride, capacity;
+	NeHeInstanceRange dirty[NEHE_INSTANCE_MAX_DIRTY];
+	unsigned numDirty;
+} NeHeInstanceBuffer;
+
+bool NeHe_CreateInstanceBuffer(NeHeContext* restrict ctx, NeHeInstanceBuffer* restrict ib,
+	uint32_t stride, uint32_t capacity, SDL_GPUBufferUsageFlags usage);
+void NeHe_DestroyInstanceBuffer(NeHeContext* restrict ctx, NeHeInstanceBuffer* restrict ib);
+bool NeHe_ResizeInstanceBuffer(NeHeContext* restrict ctx, NeHeInstanceBuffer* restrict ib, uint32_t capacity);
+
+void NeHe_InvalidateInstances(NeHeInstanceBuffer* ib, uint32_t first, uint32_t count);
+void* NeHe_MapInstances(NeHeInstanceBuffer* ib, uint32_t first, uint32_t count);
+uint32_t NeHe_WriteInstances(NeHeInstanceBuffer* restrict ib, uint32_t first, uint32_t count,
+	const void* restrict data);
+bool NeHe_UploadInstances(NeHeContext* restrict ctx, NeHeInstanceBuffer* restrict ib,
+	SDL_GPUCommandBuffer* restrict cmd);
+
+#endif//INSTANCEBUFFER_H
@@ -4,6 +4,7 @@
  */
 
 #include "nehe.h"
+#include "spritebatch.h"
 
 
 typedef struct
@@ -14,8 +15,7 @@ typedef struct
 } Instance;
 
 static SDL_GPUGraphicsPipeline* pso = NULL;
-static SDL_GPUBuffer* instanceBuffer = NULL;
-static SDL_GPUTransferBuffer* instanceXferBuffer = NULL;
+static NeHeSpriteBatch sprites;
 static SDL_GPUTexture* texture = NULL;
 static SDL_GPUSampler* sampler = NULL;
 
@@ -133,21 +133,7 @@ static bool Lesson9_Init(NeHeContext* ctx)
 
 	const int numStars = SDL_arraysize(stars);
 
-	instanceBuffer = SDL_CreateGPUBuffer(ctx->device, &(const SDL_GPUBufferCreateInfo)
-	{
-		.usage = SDL_GPU_BUFFERUSAGE_VERTEX,
-		.size = sizeof(Instance) * 2 * numStars
-	});
-	if (!instanceBuffer)
-	{
-		return false;
-	}
-	instanceXferBuffer = SDL_CreateGPUTransferBuffer(ctx->device, &(const SDL_GPUTransferBufferCreateInfo)
-	{
-		.usage = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD,
-		.size = sizeof(Instance) * 2 * numStars
-	});
-	if (!instanceXferBuffer)
+	if (!NeHe_CreateSpriteBatch(ctx, &sprites, sizeof(Instance), 6, 2 * (uint32_t)numStars))
 	{
 		return false;
 	}
@@ -170,8 +156,7 @@ static bool Lesson9_Init(NeHeContext* ctx)
 
 static void Lesson9_Quit(NeHeContext* ctx)
 {
-	SDL_ReleaseGPUTransferBuffer(ctx->device, instanceXferBuffer);
-	SDL_ReleaseGPUBuffer(ctx->device, instanceBuffer);
+	NeHe_DestroySpriteBatch(ctx, &sprites);
 	SDL_ReleaseGPUSampler(ctx->device, sampler);
 	SDL_ReleaseGPUTexture(ctx->device, texture);
 	SDL_ReleaseGPUGraphicsPipeline(ctx->device, pso);
@@ -202,12 +187,22 @@ static void Lesson9_Draw(NeHeContext* restrict ctx, SDL_GPUCommandBuffer* restri
 
 	static const int numStars = SDL_arraysize(stars);
 
+	// Setup the view matrix, stars outside its frustum are dropped before filling the instance buffer
+	Mtx view = Mtx_Translation(0.0f ,0.0f, zoom);
+	Mtx_Rotate(&view, tilt, 1.0f, 0.0f, 0.0f);
+	const Mtx viewProj = Mtx_Multiply(&projection, &view);
+	Vec4f planes[6];
+	Mtx_FrustumPlanes(planes, &viewProj);
+
 	// Animate stars
-	Instance* instances = SDL_MapGPUTransferBuffer(ctx->device, instanceXferBuffer, true);
-	for (int i = 0, instanceIdx = 0; i < numStars; ++i, ++instanceIdx)
+	static Instance starInstances[2 * SDL_arraysize(stars)];
+	static Vec4f starBounds[SDL_arraysize(stars)];
+	static unsigned visibleStars[SDL_arraysize(stars)];
+	const unsigned instancesPerStar = twinkle ? 2 : 1;
+	for (int i = 0; i < numStars; ++i)
 	{
 		struct Star* star = &stars[i];
-		Instance* instance = &instances[instanceIdx];
+		Instance* instance = &starInstances[i * 2];
 
 		float theta = star->angle * (SDL_PI_F / 180.0f);
 
@@ -215,6 +210,9 @@ static void Lesson9_Draw(NeHeContext* restrict ctx, SDL_GPUCommandBuffer* restri
 		instance->y = 0.0f;
 		instance->z = star->distance * -SDL_sinf(theta);
 
+		// Spinning star quads reach out to the corners of a 2x2 square
+		starBounds[i] = (Vec4f){ instance->x, instance->y, instance->z, SDL_sqrtf(2.0f) };
+
 		if (twinkle)
 		{
 			instance->c = 1.0f;
@@ -222,8 +220,8 @@ static void Lesson9_Draw(NeHeContext* restrict ctx, SDL_GPUCommandBuffer* restri
 			instance->r = (float)stars[numStars - i - 1].r / 255.0f;
 			instance->g = (float)stars[numStars - i - 1].g / 255.0f;
 			instance->b = (float)stars[numStars - i - 1].b / 255.0f;
-			SDL_memcpy(&instances[++instanceIdx].x, &instance->x, sizeof(float) * 3);
-			instance = &instances[instanceIdx];
+			SDL_memcpy(&instance[1].x, &instance->x, sizeof(float) * 3);
+			++instance;
 		}
 
 		theta = spin * (SDL_PI_F / 180.0f);
@@ -245,49 +243,36 @@ static void Lesson9_Draw(NeHeContext* restrict ctx, SDL_GPUCommandBuffer* restri
 			star->b = (uint8_t)(NeHe_Random() % 256);
 		}
 	}
-	SDL_UnmapGPUTransferBuffer(ctx->device, instanceXferBuffer);
-
-	const unsigned numInstances = twinkle ? 2 * (unsigned)numStars : (unsigned)numStars;
-
-	// Upload instances buffer to the GPU
-	SDL_GPUCopyPass* copyPass = SDL_BeginGPUCopyPass(cmd);
-	SDL_UploadToGPUBuffer(copyPass, &(const SDL_GPUTransferBufferLocation)
-	{
-		.transfer_buffer = instanceXferBuffer,
-		.offset = 0
-	}, &(const SDL_GPUBufferRegion)
-	{
-		.buffer = instanceBuffer,
-		.offset = 0,
-		.size = sizeof(Instance) * numInstances
-	}, true);
-	SDL_EndGPUCopyPass(copyPass);
 
-	// Begin pass & bind pipeline state
-	SDL_GPURenderPass* renderPass = SDL_BeginGPURenderPass(cmd, &colorInfo, 1, NULL);
-	SDL_BindGPUGraphicsPipeline(renderPass, pso);
-
-	// Bind particle texture
-	SDL_BindGPUFragmentSamplers(renderPass, 0, &(const SDL_GPUTextureSamplerBinding)
+	// Copy only the visible stars into the instance buffer
+	const unsigned numVisible = Mtx_CullSpheres(planes, starBounds, (unsigned)numStars, visibleStars);
+	NeHe_BeginSprites(&sprites);
+	Instance* instances = NeHe_PushSprites(&sprites, &(const NeHeSpriteMaterial)
 	{
+		.pipeline = pso,
 		.texture = texture,
 		.sampler = sampler
-	}, 1);
-
-	// Bind instances buffer
-	SDL_BindGPUVertexBuffers(renderPass, 0, &(const SDL_GPUBufferBinding)
+	}, instancesPerStar * numVisible);
+	if (instances)
 	{
-		.buffer = instanceBuffer,
-		.offset = 0
-	}, 1);
+		for (unsigned i = 0; i < numVisible; ++i)
+		{
+			SDL_memcpy(&instances[i * instancesPerStar], &starInstances[visibleStars[i] * 2],
+				sizeof(Instance) * instancesPerStar);
+		}
+	}
+	// Upload instances buffer to the GPU
+	NeHe_UploadSprites(ctx, &sprites, cmd);
+
+	// Begin pass
+	SDL_GPURenderPass* renderPass = SDL_BeginGPURenderPass(cmd, &colorInfo, 1, NULL);
 
 	// Push matrix uniforms
-	Mtx view = Mtx_Translation(0.0f ,0.0f, zoom);
-	Mtx_Rotate(&view, tilt, 1.0f, 0.0f, 0.0f);
 	struct Uniform { Mtx view, projection; } u = { view, projection };
 	SDL_PushGPUVertexUniformData(cmd, 0, &u, sizeof(u));
 
-	SDL_DrawGPUPrimitives(renderPass, 6, numInstances, 0, 0);
+	// Draw stars
+	NeHe_DrawSprites(&sprites, renderPass, 0);
 
 	SDL_EndGPURenderPass(renderPass);
 
@@ -4,25 +4,9 @@
  */
 
 #include "nehe.h"
+#include "world.h"
 
 
-typedef struct
-{
-	float x, y, z;
-	float u, v;
-} Vertex;
-
-typedef struct
-{
-	Vertex vertices[3];
-} Triangle;
-
-typedef struct
-{
-	int numTriangles;
-	Triangle* tris;
-} Sector;
-
 typedef struct
 {
 	float x, z;
@@ -32,7 +16,7 @@ typedef struct
 
 
 static SDL_GPUGraphicsPipeline* pso = NULL, * psoBlend = NULL;
-static SDL_GPUBuffer* vtxBuffer = NULL;
+static SDL_GPUBuffer* vtxBuffer = NULL, * idxBuffer = NULL;
 static SDL_GPUTexture* texture = NULL;
 static SDL_GPUSampler* samplers[3] = { NULL, NULL, NULL };
 
@@ -46,62 +30,50 @@ static Camera camera =
 	.yaw = 0.0f, .pitch = 0.0f,
 	.walkBob = 0.0f, .walkBobTheta = 0.0f
 };
-static Sector world = { .numTriangles = 0, .tris = NULL };
+static World world = { .vertices = NULL, .indices = NULL };
+static WorldRange* visibleRanges = NULL;
 
+// Tab switches to a small world of two rooms joined by portals
+static const char* const worldPaths[] = { "Data/World.txt", "Data/Rooms.txt" };
+static unsigned worldIdx = 0;
 
-static void ReadLine(SDL_IOStream* restrict file, char* restrict str, int max)
-{
-	do
-	{
-		char* p = str;
-		for (int n = max - 1; n > 0; --n)
-		{
-			int8_t c;
-			if (!SDL_ReadS8(file, &c))
-				break;
-			(*p++) = c;
-			if (c == '\n')
-				break;
-		}
-		(*p) = '\0';
-	} while (str[0] == '/' || str[0] == '\n' || str[0] == '\r');
-}
 
-static void SetupWorld(const NeHeContext* ctx)
+static bool Lesson10_LoadWorld(NeHeContext* restrict ctx, const char* restrict resourcePath)
 {
-	SDL_IOStream* file = NeHe_OpenResource(ctx, "Data/World.txt", "r");
-	if (!file)
+	World newWorld;
+	if (!World_Load(ctx, &newWorld, resourcePath))
 	{
-		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Failed to open \"%s\": %s", "Data/World.txt", SDL_GetError());
-		return;
+		return false;
 	}
-
-	int numTris;
-	char line[255];
-	ReadLine(file, line, sizeof(line));
-	SDL_sscanf(line, "NUMPOLLIES %d\n", &numTris);
-
-	world.tris = SDL_malloc(sizeof(Triangle) * (size_t)numTris);
-	world.numTriangles = numTris;
-	for (int tri = 0; tri < numTris; ++tri)
+	WorldRange* newRanges = SDL_malloc(sizeof(WorldRange) * SDL_max(newWorld.numClusters, 1));
+	SDL_GPUBuffer* newVtxBuffer, * newIdxBuffer;
+	if (!newRanges || !NeHe_CreateVertexIndexBuffer(ctx, &newVtxBuffer, &newIdxBuffer,
+		newWorld.vertices, sizeof(WorldVertex) * newWorld.numVertices,
+		newWorld.indices, newWorld.indexSize * newWorld.numIndices))
 	{
-		for (int vtx = 0; vtx < 3; ++vtx)
-		{
-			ReadLine(file, line, sizeof(line));
-			SDL_sscanf(line, "%f %f %f %f %f",
-				&world.tris[tri].vertices[vtx].x,
-				&world.tris[tri].vertices[vtx].y,
-				&world.tris[tri].vertices[vtx].z,
-				&world.tris[tri].vertices[vtx].u,
-				&world.tris[tri].vertices[vtx].v);
-		}
+		SDL_free(newRanges);
+		World_Free(&newWorld);
+		return false;
 	}
-}
 
+	// Only replace the current world once the new one is ready
+	SDL_ReleaseGPUBuffer(ctx->device, idxBuffer);
+	SDL_ReleaseGPUBuffer(ctx->device, vtxBuffer);
+	SDL_free(visibleRanges);
+	World_Free(&world);
+	world = newWorld;
+	visibleRanges = newRanges;
+	vtxBuffer = newVtxBuffer;
+	idxBuffer = newIdxBuffer;
+	return true;
+}
 
 static bool Lesson10_Init(NeHeContext* ctx)
 {
-	SetupWorld(ctx);
+	if (!Lesson10_LoadWorld(ctx, worldPaths[worldIdx]))
+	{
+		return false;
+	}
 
 	SDL_GPUShader* vertexShader, * fragmentShader;
 	if (!NeHe_LoadShaders(ctx, &vertexShader, &fragmentShader, "lesson6",
@@ -116,13 +88,13 @@ static bool Lesson10_Init(NeHeContext* ctx)
 			.location = 0,
 			.buffer_slot = 0,
 			.format = SDL_GPU_VERTEXELEMENTFORMAT_FLOAT3,
-			.offset = offsetof(Vertex, x)
+			.offset = offsetof(WorldVertex, x)
 		},
 		{
 			.location = 1,
 			.buffer_slot = 0,
 			.format = SDL_GPU_VERTEXELEMENTFORMAT_FLOAT2,
-			.offset = offsetof(Vertex, u)
+			.offset = offsetof(WorldVertex, u)
 		}
 	};
 	SDL_GPUGraphicsPipelineCreateInfo psoInfo =
@@ -135,7 +107,7 @@ static bool Lesson10_Init(NeHeContext* ctx)
 			.vertex_buffer_descriptions = &(const SDL_GPUVertexBufferDescription)
 			{
 				.slot = 0,
-				.pitch = sizeof(Vertex),
+				.pitch = sizeof(WorldVertex),
 				.input_rate = SDL_GPU_VERTEXINPUTRATE_VERTEX
 			},
 			.num_vertex_buffers = 1,
@@ -230,17 +202,12 @@ static bool Lesson10_Init(NeHeContext* ctx)
 		return false;
 	}
 
-	if ((vtxBuffer = NeHe_CreateBuffer(ctx, world.tris, sizeof(Triangle) * (uint32_t)world.numTriangles,
-		SDL_GPU_BUFFERUSAGE_VERTEX)) == NULL)
-	{
-		return false;
-	}
-
 	return true;
 }
 
 static void Lesson10_Quit(NeHeContext* ctx)
 {
+	SDL_ReleaseGPUBuffer(ctx->device, idxBuffer);
 	SDL_ReleaseGPUBuffer(ctx->device, vtxBuffer);
 	for (int i = SDL_arraysize(samplers) - 1; i > 0; --i)
 	{
@@ -249,7 +216,8 @@ static void Lesson10_Quit(NeHeContext* ctx)
 	SDL_ReleaseGPUTexture(ctx->device, texture);
 	SDL_ReleaseGPUGraphicsPipeline(ctx->device, pso);
 	SDL_ReleaseGPUGraphicsPipeline(ctx->device, psoBlend);
-	SDL_free(world.tris);
+	SDL_free(visibleRanges);
+	World_Free(&world);
 }
 
 static void Lesson10_Resize(NeHeContext* ctx, int width, int height)
@@ -262,6 +230,21 @@ static void Lesson10_Resize(NeHeContext* ctx, int width, int height)
 	projection = Mtx_Perspective(45.0f, (float)width / (float)height, 0.1f, 100.0f);
 }
 
+static void Lesson10_Walk(float dx, float dz)
+{
+#ifdef NEHE_EXTENDED
+	// Stop short of walls instead of walking through them
+	const float radius = 0.2f, length = SDL_sqrtf(dx * dx + dz * dz);
+	const Vec3f eye = { camera.x, 0.25f, camera.z }, dir = { dx / length, 0.0f, dz / length };
+	if (World_Raycast(&world, eye, dir, length + radius, NULL))
+	{
+		return;
+	}
+#endif
+	camera.x += dx;
+	camera.z += dz;
+}
+
 static void Lesson10_Draw(NeHeContext* restrict ctx, SDL_GPUCommandBuffer* restrict cmd,
 	SDL_GPUTexture* restrict swapchain, unsigned swapchainW, unsigned swapchainH)
 {
@@ -297,12 +280,17 @@ static void Lesson10_Draw(NeHeContext* restrict ctx, SDL_GPUCommandBuffer* restr
 		.sampler = samplers[filter]
 	}, 1);
 
-	// Bind world vertex buffer
+	// Bind world vertex & index buffers
 	SDL_BindGPUVertexBuffers(pass, 0, &(SDL_GPUBufferBinding)
 	{
 		.buffer = vtxBuffer,
 		.offset = 0
 	}, 1);
+	SDL_BindGPUIndexBuffer(pass, &(SDL_GPUBufferBinding)
+	{
+		.buffer = idxBuffer,
+		.offset = 0
+	}, world.indexSize == sizeof(uint32_t) ? SDL_GPU_INDEXELEMENTSIZE_32BIT : SDL_GPU_INDEXELEMENTSIZE_16BIT);
 
 	// Setup the camera view matrix
 	Mtx modelView = Mtx_Rotation(camera.pitch, 1.0f, 0.0f, 0.0f);
@@ -313,8 +301,15 @@ static void Lesson10_Draw(NeHeContext* restrict ctx, SDL_GPUCommandBuffer* restr
 	Mtx modelViewProj = Mtx_Multiply(&projection, &modelView);
 	SDL_PushGPUVertexUniformData(cmd, 0, &modelViewProj, sizeof(Mtx));
 
-	// Draw world
-	SDL_DrawGPUPrimitives(pass, 3u * (uint32_t)world.numTriangles, 1, 0, 0);
+	// Draw only the parts of the world that can be seen through portals from the camera's sector
+	Vec4f planes[6];
+	Mtx_FrustumPlanes(planes, &modelViewProj);
+	const Vec3f eye = { camera.x, 0.25f + camera.walkBob, camera.z };
+	const unsigned numRanges = World_CullPortals(&world, eye, planes, visibleRanges);
+	for (unsigned i = 0; i < numRanges; ++i)
+	{
+		SDL_DrawGPUIndexedPrimitives(pass, visibleRanges[i].numIndices, 1, visibleRanges[i].firstIndex, 0, 0);
+	}
 
 	SDL_EndGPURenderPass(pass);
 
@@ -325,8 +320,7 @@ static void Lesson10_Draw(NeHeContext* restrict ctx, SDL_GPUCommandBuffer* restr
 
 	if (keys[SDL_SCANCODE_UP])
 	{
-		camera.x -= SDL_sinf(camera.yaw * piover180) * 0.05f;
-		camera.z -= SDL_cosf(camera.yaw * piover180) * 0.05f;
+		Lesson10_Walk(-SDL_sinf(camera.yaw * piover180) * 0.05f, -SDL_cosf(camera.yaw * piover180) * 0.05f);
 		if (camera.walkBobTheta >= 359.0f)
 		{
 			camera.walkBobTheta = 0.0f;
@@ -340,8 +334,7 @@ static void Lesson10_Draw(NeHeContext* restrict ctx, SDL_GPUCommandBuffer* restr
 
 	if (keys[SDL_SCANCODE_DOWN])
 	{
-		camera.x += SDL_sinf(camera.yaw * piover180) * 0.05f;
-		camera.z += SDL_cosf(camera.yaw * piover180) * 0.05f;
+		Lesson10_Walk(SDL_sinf(camera.yaw * piover180) * 0.05f, SDL_cosf(camera.yaw * piover180) * 0.05f);
 		if (camera.walkBobTheta <= 1.0f)
 		{
 			camera.walkBobTheta = 359.0f;
@@ -361,12 +354,17 @@ static void Lesson10_Draw(NeHeContext* restrict ctx, SDL_GPUCommandBuffer* restr
 
 static void Lesson10_Key(NeHeContext* ctx, SDL_Keycode key, bool down, bool repeat)
 {
-	(void)ctx;
-
 	if (down && !repeat)
 	{
 		switch (key)
 		{
+		case SDLK_TAB:
+			if (Lesson10_LoadWorld(ctx, worldPaths[(worldIdx + 1) % SDL_arraysize(worldPaths)]))
+			{
+				worldIdx = (worldIdx + 1) % SDL_arraysize(worldPaths);
+				camera = (Camera){ .x = 0.0f, .z = 0.0f };
+			}
+			break;
 		case SDLK_B:
 			blend = !blend;
 			break;
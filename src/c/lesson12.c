@@ -4,6 +4,7 @@
  */
 
 #include "nehe.h"
+#include "instancebuffer.h"
 
 
 typedef struct
@@ -68,8 +69,7 @@ static const uint16_t indices[] =
 static SDL_GPUGraphicsPipeline* pso = NULL;
 static SDL_GPUBuffer* vtxBuffer = NULL;
 static SDL_GPUBuffer* idxBuffer = NULL;
-static SDL_GPUBuffer* instanceBuffer = NULL;
-static SDL_GPUTransferBuffer* instanceXferBuffer = NULL;
+static NeHeInstanceBuffer instanceBuffer;
 static SDL_GPUSampler* sampler = NULL;
 static SDL_GPUTexture* texture = NULL;
 
@@ -78,8 +78,8 @@ static Mtx projection;
 static float xRot = 0.0f, yRot = 0.0f;
 static float z = -20.0f;
 
-static const int numRows = 5;
-#define NUM_INSTANCES (numRows * (numRows + 1) / 2)  // Triangular number
+#define NUM_ROWS 5
+#define NUM_INSTANCES (NUM_ROWS * (NUM_ROWS + 1) / 2)  // Triangular number
 
 
 static bool Lesson12_Init(NeHeContext* restrict ctx)
@@ -233,21 +233,8 @@ static bool Lesson12_Init(NeHeContext* restrict ctx)
 		return false;
 	}
 
-	instanceBuffer = SDL_CreateGPUBuffer(ctx->device, &(const SDL_GPUBufferCreateInfo)
-	{
-		.usage = SDL_GPU_BUFFERUSAGE_GRAPHICS_STORAGE_READ,
-		.size = sizeof(Instance) * NUM_INSTANCES
-	});
-	if (!instanceBuffer)
-	{
-		return false;
-	}
-	instanceXferBuffer = SDL_CreateGPUTransferBuffer(ctx->device, &(const SDL_GPUTransferBufferCreateInfo)
-	{
-		.usage = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD,
-		.size = sizeof(Instance) * NUM_INSTANCES
-	});
-	if (!instanceXferBuffer)
+	if (!NeHe_CreateInstanceBuffer(ctx, &instanceBuffer, sizeof(Instance), NUM_INSTANCES,
+		SDL_GPU_BUFFERUSAGE_VERTEX))
 	{
 		return false;
 	}
@@ -257,8 +244,7 @@ static bool Lesson12_Init(NeHeContext* restrict ctx)
 
 static void Lesson12_Quit(NeHeContext* restrict ctx)
 {
-	SDL_ReleaseGPUTransferBuffer(ctx->device, instanceXferBuffer);
-	SDL_ReleaseGPUBuffer(ctx->device, instanceBuffer);
+	NeHe_DestroyInstanceBuffer(ctx, &instanceBuffer);
 	SDL_ReleaseGPUBuffer(ctx->device, idxBuffer);
 	SDL_ReleaseGPUBuffer(ctx->device, vtxBuffer);
 	SDL_ReleaseGPUSampler(ctx->device, sampler);
@@ -309,43 +295,61 @@ static void Lesson12_Draw(NeHeContext* restrict ctx, SDL_GPUCommandBuffer* restr
 		{ 0.0f, 1.0f, 1.0f }   // Cyan
 	};
 
-	Instance* instances = SDL_MapGPUTransferBuffer(ctx->device, instanceXferBuffer, true);
-	for (int row = 0; row < numRows; ++row)
+	// Cube centres only depend on their place in the pyramid, and rotating keeps each within a sphere of radius sqrt(3)
+	static Vec4f cubeBounds[NUM_INSTANCES];
+	static unsigned visibleCubes[NUM_INSTANCES];
+	for (int row = 0, cube = 0; row < NUM_ROWS; ++row)
 	{
 		const float rowFact = (float)(row + 1);
 		for (int x = 0; x <= row; ++x)
 		{
-			Instance* instance = instances++;
-
-			instance->model = Mtx_Translation(
+			cubeBounds[cube++] = (Vec4f)
+			{
 				1.4f + (float)x * 2.8f - rowFact * 1.4f,
-				((float)(numRows + 1) - rowFact) * 2.4f - (float)(numRows + 2),
-				0);
-			Mtx_Rotate(&instance->model, 45.0f - 2.0f * rowFact + xRot, 1.0f, 0.0f, 0.0f);
-			Mtx_Rotate(&instance->model, 45.0f + yRot, 0.0f, 1.0f, 0.0f);
+				((float)(NUM_ROWS + 1) - rowFact) * 2.4f - (float)(NUM_ROWS + 2),
+				0.0f,
+				SDL_sqrtf(3.0f)
+			};
+		}
+	}
+
+	// Drop cubes outside the view frustum
+	Mtx view = Mtx_Translation(0.0f, 0.0f, z);
+	const Mtx viewProj = Mtx_Multiply(&projection, &view);
+	Vec4f planes[6];
+	Mtx_FrustumPlanes(planes, &viewProj);
+	const unsigned numVisible = Mtx_CullSpheres(planes, cubeBounds, NUM_INSTANCES, visibleCubes);
+
+	// Rebuild visible instances, only the ones that changed since last frame get marked for upload
+	uint32_t instanceIdx = 0;
+	for (int row = 0, cube = 0; row < NUM_ROWS; ++row)
+	{
+		const float rowFact = (float)(row + 1);
+		for (int x = 0; x <= row; ++x, ++cube)
+		{
+			if (instanceIdx == numVisible || visibleCubes[instanceIdx] != (unsigned)cube)
+			{
+				continue;
+			}
+
+			Instance instance;
+
+			instance.model = Mtx_Translation(cubeBounds[cube].x, cubeBounds[cube].y, cubeBounds[cube].z);
+			Mtx_Rotate(&instance.model, 45.0f - 2.0f * rowFact + xRot, 1.0f, 0.0f, 0.0f);
+			Mtx_Rotate(&instance.model, 45.0f + yRot, 0.0f, 1.0f, 0.0f);
 
 			const int colIdx = SDL_min(row, (int)SDL_arraysize(boxColors) - 1);
-			instance->r = boxColors[colIdx][0];
-			instance->g = boxColors[colIdx][1];
-			instance->b = boxColors[colIdx][2];
-			instance->a = 1.0f;
+			instance.r = boxColors[colIdx][0];
+			instance.g = boxColors[colIdx][1];
+			instance.b = boxColors[colIdx][2];
+			instance.a = 1.0f;
+
+			NeHe_WriteInstances(&instanceBuffer, instanceIdx++, 1, &instance);
 		}
 	}
-	SDL_UnmapGPUTransferBuffer(ctx->device, instanceXferBuffer);
 
-	// Upload instances to the GPU
-	SDL_GPUCopyPass* copyPass = SDL_BeginGPUCopyPass(cmd);
-		SDL_UploadToGPUBuffer(copyPass, &(const SDL_GPUTransferBufferLocation)
-	{
-		.transfer_buffer = instanceXferBuffer,
-		.offset = 0
-	}, &(const SDL_GPUBufferRegion)
-	{
-		.buffer = instanceBuffer,
-		.offset = 0,
-		.size = sizeof(Instance) * NUM_INSTANCES
-	}, true);
-	SDL_EndGPUCopyPass(copyPass);
+	// Upload changed instances to the GPU, skipped entirely when the scene is static
+	NeHe_UploadInstances(ctx, &instanceBuffer, cmd);
 
 	// Begin pass & bind pipeline state
 	SDL_GPURenderPass* pass = SDL_BeginGPURenderPass(cmd, &colorInfo, 1, &depthInfo);
@@ -362,7 +366,7 @@ static void Lesson12_Draw(NeHeContext* restrict ctx, SDL_GPUCommandBuffer* restr
 	const SDL_GPUBufferBinding vertexBindings[] =
 	{
 		{ .buffer = vtxBuffer, .offset = 0 },
-		{ .buffer = instanceBuffer, .offset = 0 }
+		{ .buffer = instanceBuffer.buffer, .offset = 0 }
 	};
 	SDL_BindGPUVertexBuffers(pass, 0, vertexBindings, SDL_arraysize(vertexBindings));
 	SDL_BindGPUIndexBuffer(pass, &(const SDL_GPUBufferBinding)
@@ -372,12 +376,11 @@ static void Lesson12_Draw(NeHeContext* restrict ctx, SDL_GPUCommandBuffer* restr
 	}, SDL_GPU_INDEXELEMENTSIZE_16BIT);
 
 	// Push shader uniforms
-	Mtx view = Mtx_Translation(0.0f, 0.0f, z);
 	struct Uniform { Mtx view, projection; } u = { view, projection };
 	SDL_PushGPUVertexUniformData(cmd, 0, &u, sizeof(u));
 
 	// Draw textured cube instances
-	SDL_DrawGPUIndexedPrimitives(pass, SDL_arraysize(indices), NUM_INSTANCES, 0, 0, 0);
+	SDL_DrawGPUIndexedPrimitives(pass, SDL_arraysize(indices), numVisible, 0, 0, 0);
 
 	SDL_EndGPURenderPass(pass);
 
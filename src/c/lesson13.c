@@ -4,25 +4,17 @@
  */
 
 #include "nehe.h"
-#include "sdl_stbtt.h"
+#include "spritebatch.h"
+#include "text.h"
 
 
-typedef struct
-{
-	float srcX, srcY, srcW, srcH;
-	float dstX, dstY, dstW, dstH;
-} ShaderCharacter;
-
-
-#define MAX_CHARACTERS 255
-
 static SDL_GPUGraphicsPipeline* pso = NULL;
-static SDL_GPUBuffer* charBuffer = NULL;
-static SDL_GPUTransferBuffer* charXferBuffer = NULL;
+static NeHeSpriteBatch textSprites;
 static SDL_GPUSampler* sampler = NULL;
 
-static SDL_GPUTexture* fontTex = NULL;
-static stbtt_packedchar fontChars[96];
+static NeHeGlyphCache glyphCache;
+static NeHeFont font;
+static NeHeText text;
 
 static Mtx perspective, ortho;
 
@@ -30,93 +22,12 @@ static Mtx perspective, ortho;
 static float counter1 = 0.0f, counter2 = 0.0f;
 
 
-#define FONT_ATLAS_W 256
-#define FONT_ATLAS_H 192
-
-static bool NeHe_BuildFont(NeHeContext* restrict ctx, const char* const restrict ttfResourcePath, int fontSize)
-{
-	void* ttf = NeHe_ReadResourceBlob(ctx, ttfResourcePath, NULL);
-	if (!ttf)
-	{
-		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Failed to read font file: %s", SDL_GetError());
-		return false;
-	}
-
-	uint8_t pixels[FONT_ATLAS_W * FONT_ATLAS_H];
-
-	//FW_BOLD is 700
-	stbtt_pack_context packCtx;
-	int res = stbtt_PackBegin(&packCtx, pixels, FONT_ATLAS_W, FONT_ATLAS_H, 0, 1, NULL);
-	if (!res) { return false; }
-	res = stbtt_PackFontRange(&packCtx, (const unsigned char*)ttf, 0, (float)fontSize, ' ', 96, fontChars);
-	if (!res) { return false; }
-	SDL_free(ttf);
-	stbtt_PackEnd(&packCtx);
-
-	const SDL_GPUTextureCreateInfo fontInfo =
-	{
-		.type = SDL_GPU_TEXTURETYPE_2D,
-		.format = SDL_GPU_TEXTUREFORMAT_A8_UNORM,
-		.usage = SDL_GPU_TEXTUREUSAGE_SAMPLER,
-		.width = FONT_ATLAS_W, .height = FONT_ATLAS_H, .layer_count_or_depth = 1,
-		.num_levels = 1,
-		.sample_count = SDL_GPU_SAMPLECOUNT_1,
-		.props = 0
-	};
-	if ((fontTex = NeHe_CreateGPUTextureFromPixels(ctx, pixels, sizeof(pixels), &fontInfo, false)) == NULL)
-	{
-		return false;
-	}
-
-	return true;
-}
-
-static unsigned NeHe_DrawText(ShaderCharacter* restrict outChars, float x, float y, const unsigned char* restrict text)
-{
-	for (unsigned numChars = 0; numChars < MAX_CHARACTERS;)
-	{
-		const int c = *(text++);
-		if (c == '\0')
-		{
-			return numChars;
-		}
-
-		if (c >= 0x20 && c < 0x80)
-		{
-			stbtt_aligned_quad quad;
-			stbtt_GetPackedQuad(fontChars, FONT_ATLAS_W, FONT_ATLAS_H, c - 0x20, &x, &y, &quad, 1);
-
-			outChars[numChars++] = (ShaderCharacter)
-			{
-				.srcX = quad.s0, .srcY =  quad.t0,
-				.srcW = quad.s1 - quad.s0, .srcH = quad.t1 - quad.t0,
-				.dstX = quad.x0, .dstY = -quad.y0,
-				.dstW = quad.x1 - quad.x0, .dstH = quad.y0 - quad.y1
-			};
-		}
-	}
-	return MAX_CHARACTERS;
-}
-
-#ifdef __GNUC__
-__attribute__((format(printf, 2, 3)))
-#endif
-static unsigned NeHe_Printf(ShaderCharacter* restrict outChars, SDL_PRINTF_FORMAT_STRING const char* restrict fmt, ...)
-{
-	char text[MAX_CHARACTERS + 1];
-	va_list args;
-
-	va_start(args, fmt);
-		SDL_vsnprintf(text, sizeof(text), fmt, args);
-	va_end(args);
-
-	return NeHe_DrawText(outChars, 0, 0, (unsigned char*)text);
-}
+#define FONT_SIZE 24
 
 static bool Lesson13_Init(NeHeContext* ctx)
 {
 	SDL_GPUShader* vertexShader, * fragmentShader;
-	if (!NeHe_LoadShaders(ctx, &vertexShader, &fragmentShader, "lesson13",
+	if (!NeHe_LoadShaders(ctx, &vertexShader, &fragmentShader, "lesson13_sdf",
 		&(const NeHeShaderProgramCreateInfo){ .vertexUniforms = 1, .fragmentSamplers = 1 }))
 	{
 		return false;
@@ -127,14 +38,20 @@ static bool Lesson13_Init(NeHeContext* ctx)
 		{
 			.location = 0,
 			.buffer_slot = 0,
-			.format = SDL_GPU_VERTEXELEMENTFORMAT_FLOAT4,
-			.offset = offsetof(ShaderCharacter, srcX)
+			.format = SDL_GPU_VERTEXELEMENTFORMAT_USHORT4_NORM,
+			.offset = offsetof(NeHeTextInstance, srcX)
 		},
 		{
 			.location = 1,
 			.buffer_slot = 0,
-			.format = SDL_GPU_VERTEXELEMENTFORMAT_FLOAT4,
-			.offset = offsetof(ShaderCharacter, dstX)
+			.format = SDL_GPU_VERTEXELEMENTFORMAT_SHORT4,
+			.offset = offsetof(NeHeTextInstance, dstX)
+		},
+		{
+			.location = 2,
+			.buffer_slot = 0,
+			.format = SDL_GPU_VERTEXELEMENTFORMAT_UBYTE4_NORM,
+			.offset = offsetof(NeHeTextInstance, color)
 		}
 	};
 	pso = SDL_CreateGPUGraphicsPipeline(ctx->device, &(const SDL_GPUGraphicsPipelineCreateInfo)
@@ -147,7 +64,7 @@ static bool Lesson13_Init(NeHeContext* ctx)
 			.vertex_buffer_descriptions = &(const SDL_GPUVertexBufferDescription)
 			{
 				.slot = 0,
-				.pitch = sizeof(ShaderCharacter),
+				.pitch = sizeof(NeHeTextInstance),
 				.input_rate = SDL_GPU_VERTEXINPUTRATE_INSTANCE
 			},
 			.num_vertex_buffers = 1,
@@ -181,7 +98,14 @@ static bool Lesson13_Init(NeHeContext* ctx)
 		}
 	});
 
-	if (!NeHe_BuildFont(ctx, "Data/NimbusMonoPS-Bold.ttf", 24))
+	// Glyphs are distance fields baked at build time, one small atlas then serves every text size. The font itself
+	// is only read if the text ever needs a glyph that wasn't baked
+	if (!NeHe_LoadGlyphCache(ctx, &glyphCache, "Data/NimbusMonoPS-Bold.glyphs", "Data/NimbusMonoPS-Bold.ttf", 1024))
+	{
+		return false;
+	}
+	NeHe_CreateTrueTypeFont(&font, &glyphCache, FONT_SIZE);
+	if (!NeHe_CreateText(&text, &font))
 	{
 		return false;
 	}
@@ -196,21 +120,7 @@ static bool Lesson13_Init(NeHeContext* ctx)
 		return false;
 	}
 
-	charBuffer = SDL_CreateGPUBuffer(ctx->device, &(const SDL_GPUBufferCreateInfo)
-	{
-		.usage = SDL_GPU_BUFFERUSAGE_VERTEX,
-		.size = sizeof(ShaderCharacter) * MAX_CHARACTERS
-	});
-	if (!charBuffer)
-	{
-		return false;
-	}
-	charXferBuffer = SDL_CreateGPUTransferBuffer(ctx->device, &(const SDL_GPUTransferBufferCreateInfo)
-	{
-		.usage = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD,
-		.size = sizeof(ShaderCharacter) * MAX_CHARACTERS
-	});
-	if (!charXferBuffer)
+	if (!NeHe_CreateSpriteBatch(ctx, &textSprites, sizeof(NeHeTextInstance), 4, 64))
 	{
 		return false;
 	}
@@ -220,10 +130,10 @@ static bool Lesson13_Init(NeHeContext* ctx)
 
 static void Lesson13_Quit(NeHeContext* ctx)
 {
-	SDL_ReleaseGPUTransferBuffer(ctx->device, charXferBuffer);
-	SDL_ReleaseGPUBuffer(ctx->device, charBuffer);
+	NeHe_DestroySpriteBatch(ctx, &textSprites);
 	SDL_ReleaseGPUSampler(ctx->device, sampler);
-	SDL_ReleaseGPUTexture(ctx->device, fontTex);
+	NeHe_DestroyText(&text);
+	NeHe_DestroyGlyphCache(ctx, &glyphCache);
 	SDL_ReleaseGPUGraphicsPipeline(ctx->device, pso);
 }
 
@@ -249,42 +159,23 @@ static void Lesson13_Draw(NeHeContext* restrict ctx, SDL_GPUCommandBuffer* restr
 		.store_op = SDL_GPU_STOREOP_STORE
 	};
 
-	// Print text to character buffer
-	ShaderCharacter* characters = (ShaderCharacter*)SDL_MapGPUTransferBuffer(ctx->device, charXferBuffer, true);
-	unsigned numChars = NeHe_Printf(characters, "Active OpenGL Text With NeHe - %7.2f", (double)counter1);
-	SDL_UnmapGPUTransferBuffer(ctx->device, charXferBuffer);
-
-	// Copy characters to the GPU
-	SDL_GPUCopyPass* copyPass = SDL_BeginGPUCopyPass(cmd);
-	SDL_UploadToGPUBuffer(copyPass, &(const SDL_GPUTransferBufferLocation)
-	{
-		.transfer_buffer = charXferBuffer,
-		.offset = 0
-	}, &(const SDL_GPUBufferRegion)
+	// Only the part of the string that changed since last frame (usually just the counter digits) is laid out again,
+	// then any glyphs it needed that weren't in the atlas yet are uploaded
+	NeHe_TextPrintf(&text, "Active OpenGL Text With NeHe - %7.2f", (double)counter1);
+	if (!NeHe_UpdateGlyphCache(ctx, &glyphCache, cmd))
 	{
-		.buffer = charBuffer,
-		.offset = 0,
-		.size = sizeof(ShaderCharacter) * numChars
-	}, true);
-	SDL_EndGPUCopyPass(copyPass);
+		return;
+	}
 
-	// Begin pass & bind pipeline state
-	SDL_GPURenderPass* renderPass = SDL_BeginGPURenderPass(cmd, &colorInfo, 1, NULL);
-	SDL_BindGPUGraphicsPipeline(renderPass, pso);
+	NeHe_BeginSprites(&textSprites);
+	NeHe_PushText(&textSprites, &(const NeHeSpriteMaterial){ .pipeline = pso, .sampler = sampler }, &text,
+		0.0f, 0.0f, (const float[4]){ 1.0f, 1.0f, 1.0f, 1.0f });
 
-	// Bind font texture
-	SDL_BindGPUFragmentSamplers(renderPass, 0, &(const SDL_GPUTextureSamplerBinding)
-	{
-		.texture = fontTex,
-		.sampler = sampler
-	}, 1);
+	// Only the characters that differ from last frame (usually just the counter digits) get copied to the GPU
+	NeHe_UploadSprites(ctx, &textSprites, cmd);
 
-	// Bind characters buffer
-	SDL_BindGPUVertexBuffers(renderPass, 0, &(const SDL_GPUBufferBinding)
-	{
-		.buffer = charBuffer,
-		.offset = 0
-	}, 1);
+	// Begin pass
+	SDL_GPURenderPass* renderPass = SDL_BeginGPURenderPass(cmd, &colorInfo, 1, NULL);
 
 	// Text colour
 	float r = SDL_max(0.0f, SDL_cosf(counter1));
@@ -316,7 +207,7 @@ static void Lesson13_Draw(NeHeContext* restrict ctx, SDL_GPUCommandBuffer* restr
 	SDL_PushGPUVertexUniformData(cmd, 0, &u, sizeof(u));
 
 	// Draw characters
-	SDL_DrawGPUPrimitives(renderPass, 4, numChars, 0, 0);
+	NeHe_DrawSprites(&textSprites, renderPass, 0);
 
 	SDL_EndGPURenderPass(renderPass);
 
@@ -4,24 +4,10 @@
  */
 
 #include "nehe.h"
+#include "spritebatch.h"
+#include "text.h"
 
 
-typedef struct { float r, g, b; } Color;
-typedef struct
-{
-	Color color;
-	float x, y;
-	int charIdx;
-} ShaderCharacter;
-
-#define MAX_CHARACTERS 64
-
-typedef struct
-{
-	ShaderCharacter* characters;
-	unsigned remaining;
-} CharacterOutput;
-
 typedef struct
 {
 	float x, y, z;
@@ -48,48 +34,20 @@ static const uint16_t indices[12] =
 
 
 static SDL_GPUGraphicsPipeline* pso = NULL, * psoText = NULL;
-static SDL_GPUBuffer* vtxBuffer = NULL, * idxBuffer = NULL, * charBuffer = NULL;
-static SDL_GPUTransferBuffer* charXferBuffer = NULL;
+static SDL_GPUBuffer* vtxBuffer = NULL, * idxBuffer = NULL;
+static NeHeSpriteBatch textSprites;
 static SDL_GPUSampler* sampler = NULL;
-static SDL_GPUTexture* texture = NULL, * fontTex = NULL;
+static SDL_GPUTexture* texture = NULL;
+
+// The second font is the lower half of the same bitmap
+static NeHeFont fonts[2];
+static NeHeText textNeHe, textOpenGL, textCredit;
 
 static Mtx projection;
 
 static float counterA = 0.0f, counterB = 0.0f;
 
 
-static void NeHe_Print(CharacterOutput* restrict characters,
-	SDL_Point pos, Color color, const char* restrict text, int font)
-{
-	font = SDL_clamp(font, 0, 1);
-	characters->remaining = SDL_min(MAX_CHARACTERS, characters->remaining);
-	color.r = SDL_clamp(color.r, 0.0f, 1.0f);
-	color.g = SDL_clamp(color.g, 0.0f, 1.0f);
-	color.b = SDL_clamp(color.b, 0.0f, 1.0f);
-
-	while (characters->remaining)
-	{
-		const int c = *(text)++;
-		if (c == '\0')
-		{
-			return;
-		}
-
-		if (c >= 0x20 && c < 0x80)
-		{
-			characters->characters[MAX_CHARACTERS - characters->remaining--] = (ShaderCharacter)
-			{
-				.color = color,
-				.x = (float)pos.x, .y = (float)pos.y,
-				.charIdx = c - 0x20 + font * 0x80
-			};
-
-			pos.x += 10;
-		}
-	}
-}
-
-
 static bool Lesson17_Init(NeHeContext* restrict ctx)
 {
 	SDL_GPUShader* vertexShader, * fragmentShader;
@@ -163,7 +121,7 @@ static bool Lesson17_Init(NeHeContext* restrict ctx)
 		return false;
 	}
 
-	if (!NeHe_LoadShaders(ctx, &vertexShader, &fragmentShader, "lesson17",
+	if (!NeHe_LoadShaders(ctx, &vertexShader, &fragmentShader, "lesson13",
 		&(const NeHeShaderProgramCreateInfo){ .vertexUniforms = 1, .fragmentSamplers = 1 }))
 	{
 		return false;
@@ -174,20 +132,20 @@ static bool Lesson17_Init(NeHeContext* restrict ctx)
 		{
 			.location = 0,
 			.buffer_slot = 0,
-			.format = SDL_GPU_VERTEXELEMENTFORMAT_FLOAT3,
-			.offset = offsetof(ShaderCharacter, color)
+			.format = SDL_GPU_VERTEXELEMENTFORMAT_USHORT4_NORM,
+			.offset = offsetof(NeHeTextInstance, srcX)
 		},
 		{
 			.location = 1,
 			.buffer_slot = 0,
-			.format = SDL_GPU_VERTEXELEMENTFORMAT_FLOAT2,
-			.offset = offsetof(ShaderCharacter, x)
+			.format = SDL_GPU_VERTEXELEMENTFORMAT_SHORT4,
+			.offset = offsetof(NeHeTextInstance, dstX)
 		},
 		{
 			.location = 2,
 			.buffer_slot = 0,
-			.format = SDL_GPU_VERTEXELEMENTFORMAT_INT,
-			.offset = offsetof(ShaderCharacter, charIdx)
+			.format = SDL_GPU_VERTEXELEMENTFORMAT_UBYTE4_NORM,
+			.offset = offsetof(NeHeTextInstance, color)
 		}
 	};
 	psoText = SDL_CreateGPUGraphicsPipeline(ctx->device, &(const SDL_GPUGraphicsPipelineCreateInfo)
@@ -200,7 +158,7 @@ static bool Lesson17_Init(NeHeContext* restrict ctx)
 			.vertex_buffer_descriptions = &(const SDL_GPUVertexBufferDescription)
 			{
 				.slot = 0,
-				.pitch = sizeof(ShaderCharacter),
+				.pitch = sizeof(NeHeTextInstance),
 				.input_rate = SDL_GPU_VERTEXINPUTRATE_INSTANCE
 			},
 			.num_vertex_buffers = 1,
@@ -223,9 +181,9 @@ static bool Lesson17_Init(NeHeContext* restrict ctx)
 					.enable_blend = true,
 					.color_blend_op = SDL_GPU_BLENDOP_ADD,
 					.alpha_blend_op = SDL_GPU_BLENDOP_ADD,
-					.src_color_blendfactor = SDL_GPU_BLENDFACTOR_SRC_ALPHA,
+					.src_color_blendfactor = SDL_GPU_BLENDFACTOR_ONE,  // Text shader outputs premultiplied alpha
 					.dst_color_blendfactor = SDL_GPU_BLENDFACTOR_ONE,
-					.src_alpha_blendfactor = SDL_GPU_BLENDFACTOR_SRC_ALPHA,
+					.src_alpha_blendfactor = SDL_GPU_BLENDFACTOR_ONE,
 					.dst_alpha_blendfactor = SDL_GPU_BLENDFACTOR_ONE
 				}
 			},
@@ -240,11 +198,22 @@ static bool Lesson17_Init(NeHeContext* restrict ctx)
 		return false;
 	}
 
-	if ((fontTex = NeHe_LoadTexture(ctx, "Data/Font.bmp", true, false)) == NULL ||
+	// 16x16 pixel characters starting from space, laid out 16 to a row
+	if (!NeHe_LoadGridFont(ctx, &fonts[0], "Data/Font.bmp", 16, 16, 0x20, 96, 10.0f) ||
 		(texture = NeHe_LoadTexture(ctx, "Data/Bumps.bmp", true, false)) == NULL)
 	{
 		return false;
 	}
+	fonts[1] = fonts[0];
+	fonts[1].firstCell = 128;
+
+	// None of the strings ever change, so they're laid out once up front
+	if (!NeHe_CreateText(&textNeHe, &fonts[0]) || !NeHe_SetText(&textNeHe, "NeHe")
+		|| !NeHe_CreateText(&textOpenGL, &fonts[1]) || !NeHe_SetText(&textOpenGL, "OpenGL")
+		|| !NeHe_CreateText(&textCredit, &fonts[0]) || !NeHe_SetText(&textCredit, "Giuseppe D'Agata"))
+	{
+		return false;
+	}
 
 	sampler = SDL_CreateGPUSampler(ctx->device, &(const SDL_GPUSamplerCreateInfo)
 	{
@@ -257,22 +226,8 @@ static bool Lesson17_Init(NeHeContext* restrict ctx)
 		return false;
 	}
 
-	// Create GPU & transfer buffers for text characters
-	charBuffer = SDL_CreateGPUBuffer(ctx->device, &(const SDL_GPUBufferCreateInfo)
-	{
-		.usage = SDL_GPU_BUFFERUSAGE_VERTEX,
-		.size = sizeof(ShaderCharacter) * MAX_CHARACTERS
-	});
-	if (!charBuffer)
-	{
-		return false;
-	}
-	charXferBuffer = SDL_CreateGPUTransferBuffer(ctx->device, &(const SDL_GPUTransferBufferCreateInfo)
-	{
-		.usage = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD,
-		.size = sizeof(ShaderCharacter) * MAX_CHARACTERS
-	});
-	if (!charXferBuffer)
+	// Create batch for text characters
+	if (!NeHe_CreateSpriteBatch(ctx, &textSprites, sizeof(NeHeTextInstance), 4, 64))
 	{
 		return false;
 	}
@@ -292,11 +247,13 @@ static void Lesson17_Quit(NeHeContext* restrict ctx)
 {
 	SDL_ReleaseGPUBuffer(ctx->device, idxBuffer);
 	SDL_ReleaseGPUBuffer(ctx->device, vtxBuffer);
-	SDL_ReleaseGPUTransferBuffer(ctx->device, charXferBuffer);
-	SDL_ReleaseGPUBuffer(ctx->device, charBuffer);
+	NeHe_DestroySpriteBatch(ctx, &textSprites);
 	SDL_ReleaseGPUSampler(ctx->device, sampler);
 	SDL_ReleaseGPUTexture(ctx->device, texture);
-	SDL_ReleaseGPUTexture(ctx->device, fontTex);
+	NeHe_DestroyText(&textCredit);
+	NeHe_DestroyText(&textOpenGL);
+	NeHe_DestroyText(&textNeHe);
+	NeHe_DestroyFont(ctx, &fonts[0]);
 	SDL_ReleaseGPUGraphicsPipeline(ctx->device, psoText);
 	SDL_ReleaseGPUGraphicsPipeline(ctx->device, pso);
 }
@@ -335,57 +292,38 @@ static void Lesson17_Draw(NeHeContext* restrict ctx, SDL_GPUCommandBuffer* restr
 		.cycle = true
 	};
 
-	// Acquire character buffer to print to
-	CharacterOutput characters =
-	{
-		.characters = (ShaderCharacter*)SDL_MapGPUTransferBuffer(ctx->device, charXferBuffer, true),
-		.remaining = MAX_CHARACTERS
-	};
+	// Queue text, all of it shares the font texture so it's drawn at once
+	NeHe_BeginSprites(&textSprites);
+	const NeHeSpriteMaterial textMaterial = { .pipeline = psoText, .sampler = sampler };
 
-	NeHe_Print(&characters, (SDL_Point)
+	NeHe_PushText(&textSprites, &textMaterial, &textNeHe,
+		(float)(280 + (int)(250.0f * SDL_cosf(counterA))),
+		(float)(235 + (int)(200.0f * SDL_sinf(counterB))), (const float[4])
 	{
-		.x = 280 + (int)(250.0f * SDL_cosf(counterA)),
-		.y = 235 + (int)(200.0f * SDL_sinf(counterB))
-	}, (Color)
-	{
-		.r = SDL_cosf(counterA),
-		.g = SDL_sinf(counterB),
-		.b = 1.0f - 0.5f * SDL_cosf(counterA + counterB)
-	}, "NeHe", 0);
+		SDL_cosf(counterA),
+		SDL_sinf(counterB),
+		1.0f - 0.5f * SDL_cosf(counterA + counterB),
+		1.0f
+	});
 
-	NeHe_Print(&characters, (SDL_Point)
+	NeHe_PushText(&textSprites, &textMaterial, &textOpenGL,
+		(float)(280 + (int)(230.0f * SDL_cosf(counterB))),
+		(float)(235 + (int)(200.0f * SDL_sinf(counterA))), (const float[4])
 	{
-		.x = 280 + (int)(230.0f * SDL_cosf(counterB)),
-		.y = 235 + (int)(200.0f * SDL_sinf(counterA))
-	}, (Color)
-	{
-		.r = SDL_sinf(counterB),
-		.g = 1.0f - 0.5f * SDL_cosf(counterA + counterB),
-		.b = SDL_cosf(counterA)
-	}, "OpenGL", 1);
-
-	const Color blue  = { .r = 0.0f, .g = 0.0f, .b = 1.0f };
-	const Color white = { .r = 1.0f, .g = 1.0f, .b = 1.0f };
-	SDL_Point p = { .x = 240 + (int)(200.0f * SDL_cosf((counterA + counterB) / 5.0f)), .y = 2 };
-	NeHe_Print(&characters, p, blue, "Giuseppe D'Agata", 0);
-	p.x += 2;
-	NeHe_Print(&characters, p, white, "Giuseppe D'Agata", 0);
+		SDL_sinf(counterB),
+		1.0f - 0.5f * SDL_cosf(counterA + counterB),
+		SDL_cosf(counterA),
+		1.0f
+	});
+
+	const float blue[4]  = { 0.0f, 0.0f, 1.0f, 1.0f };
+	const float white[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+	const float creditX = (float)(240 + (int)(200.0f * SDL_cosf((counterA + counterB) / 5.0f)));
+	NeHe_PushText(&textSprites, &textMaterial, &textCredit, creditX, 2.0f, blue);
+	NeHe_PushText(&textSprites, &textMaterial, &textCredit, creditX + 2.0f, 2.0f, white);
 
 	// Copy characters to the GPU
-	SDL_UnmapGPUTransferBuffer(ctx->device, charXferBuffer);
-	SDL_GPUCopyPass* copyPass = SDL_BeginGPUCopyPass(cmd);
-	const unsigned numChars = MAX_CHARACTERS - characters.remaining;
-	SDL_UploadToGPUBuffer(copyPass, &(const SDL_GPUTransferBufferLocation)
-	{
-		.transfer_buffer = charXferBuffer,
-		.offset = 0
-	}, &(const SDL_GPUBufferRegion)
-	{
-		.buffer = charBuffer,
-		.offset = 0,
-		.size = sizeof(ShaderCharacter) * numChars
-	}, true);
-	SDL_EndGPUCopyPass(copyPass);
+	NeHe_UploadSprites(ctx, &textSprites, cmd);
 
 	// Begin pass & bind pipeline state
 	SDL_GPURenderPass* renderPass = SDL_BeginGPURenderPass(cmd, &colorInfo, 1, &depthInfo);
@@ -421,29 +359,16 @@ static void Lesson17_Draw(NeHeContext* restrict ctx, SDL_GPUCommandBuffer* restr
 	// Draw textured 3D object
 	SDL_DrawGPUIndexedPrimitives(renderPass, SDL_arraysize(indices), 1, 0, 0, 0);
 
-	// Bind text rendering pipeline
-	SDL_BindGPUGraphicsPipeline(renderPass, psoText);
-
-	// Bind font texture
-	SDL_BindGPUFragmentSamplers(renderPass, 0, &(const SDL_GPUTextureSamplerBinding)
-	{
-		.texture = fontTex,
-		.sampler = sampler
-	}, 1);
-
-	// Bind characters buffer
-	SDL_BindGPUVertexBuffers(renderPass, 0, &(const SDL_GPUBufferBinding)
-	{
-		.buffer = charBuffer,
-		.offset = 0
-	}, 1);
-
 	// Push matrix uniforms
-	const Mtx ortho = Mtx_Orthographic2D(0.0f, 640.0f, 0.0f, 480.0f);
-	SDL_PushGPUVertexUniformData(cmd, 0, &ortho, sizeof(ortho));
+	const struct { Mtx ortho; float color[4]; } textUniform =
+	{
+		.ortho = Mtx_Orthographic2D(0.0f, 640.0f, 0.0f, 480.0f),
+		.color = { 1.0f, 1.0f, 1.0f, 1.0f }
+	};
+	SDL_PushGPUVertexUniformData(cmd, 0, &textUniform, sizeof(textUniform));
 
 	// Draw characters
-	SDL_DrawGPUPrimitives(renderPass, 4, numChars, 0, 0);
+	NeHe_DrawSprites(&textSprites, renderPass, 0);
 
 	SDL_EndGPURenderPass(renderPass);
 
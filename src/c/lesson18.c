@@ -5,6 +5,7 @@
 
 #include "nehe.h"
 #include "quadric.h"
+#include "meshopt.h"
 
 
 static const QuadVertexNormalTexture cubeVertices[] =
@@ -51,9 +52,6 @@ static const uint16_t cubeIndices[] =
 	20, 21, 22,  22, 23, 20   // Left
 };
 
-#define QUADRIC_VERTEX_CAPACITY 1089
-#define QUADRIC_INDEX_CAPACITY  0x1800
-
 static enum Object
 {
 	OBJECT_CUBE,
@@ -68,8 +66,8 @@ static enum Object
 
 static SDL_GPUGraphicsPipeline* psoUnlit = NULL, * psoLight = NULL;
 static SDL_GPUBuffer* objVtxBuffers[NUM_OBJECTS], * objIdxBuffers[NUM_OBJECTS];
-static SDL_GPUTransferBuffer* objDynamicVtxXferBuffer = NULL, * objDynamicIdxXferBuffer = NULL;
-static unsigned objIdxCounts[NUM_OBJECTS];
+static QuadricLodChain objLods[NUM_OBJECTS];
+static SDL_GPUIndexElementSize objIdxSizes[NUM_OBJECTS];
 static SDL_GPUSampler* samplers[3] = { NULL, NULL, NULL };
 static SDL_GPUTexture* texture = NULL;
 
@@ -92,6 +90,88 @@ static float z = -5.0f;
 static int angleCounter = 0;
 
 
+static const int lodSlices[] = { 32, 16, 8, 4 };
+
+// One slice per degree so the animated sweep lands exactly on slice boundaries
+#define DYNAMIC_SLICES 360
+#define DYNAMIC_LOOPS  32
+
+static bool Lesson18_OptimizeLod(enum Object obj, unsigned level, Quadric* restrict quadric)
+{
+	// Reorder generated grid for vertex cache reuse and linear vertex fetch
+	const unsigned indexSize = Quad_IndexSize(quadric->indexType);
+	MeshCacheStats before, after;
+	if (!Mesh_AnalyzeVertexCache(&before, quadric->indexData, indexSize, quadric->numIndices, quadric->numVertices,
+			MESH_VERTEX_CACHE_SIZE)
+		|| !Mesh_OptimizeVertexCache(quadric->indexData, indexSize, quadric->numIndices, quadric->numVertices)
+		|| !Mesh_OptimizeVertexFetch(quadric->vertexData, sizeof(QuadVertexNormalTexture),
+			quadric->indexData, indexSize, quadric->numIndices, quadric->numVertices)
+		|| !Mesh_AnalyzeVertexCache(&after, quadric->indexData, indexSize, quadric->numIndices, quadric->numVertices,
+			MESH_VERTEX_CACHE_SIZE))
+	{
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Mesh optimisation failed: %s", SDL_GetError());
+		return false;
+	}
+	SDL_Log("Quadric %d LOD %u: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f", (int)obj, level,
+		(double)before.acmr, (double)after.acmr, (double)before.atvr, (double)after.atvr);
+	return true;
+}
+
+static bool Lesson18_UploadObject(NeHeContext* restrict ctx, enum Object obj,
+	const QuadVertexNormalTexture* restrict vertices, unsigned numVertices,
+	const void* restrict indices, unsigned numIndices, QuadIndexType indexType)
+{
+	// Pack vertices to halve their size before they go to the GPU
+	QuadVertexPacked* packed = SDL_malloc(sizeof(QuadVertexPacked) * numVertices);
+	if (!packed)
+	{
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "SDL_malloc: %s", SDL_GetError());
+		return false;
+	}
+	Quad_PackVertices(packed, vertices, numVertices);
+
+	objIdxSizes[obj] = indexType == QUAD_INDEX_32
+		? SDL_GPU_INDEXELEMENTSIZE_32BIT
+		: SDL_GPU_INDEXELEMENTSIZE_16BIT;
+	const bool result = NeHe_CreateVertexIndexBuffer(ctx, &objVtxBuffers[obj], &objIdxBuffers[obj],
+		packed, sizeof(QuadVertexPacked) * numVertices,
+		indices, Quad_IndexSize(indexType) * numIndices);
+	SDL_free(packed);
+	return result;
+}
+
+static bool Lesson18_CreateQuadric(NeHeContext* restrict ctx, enum Object obj, const QuadricDesc* restrict desc)
+{
+	// Generate every level of detail into one shared vertex & index buffer
+	const unsigned numLods = SDL_arraysize(lodSlices);
+	Quadric quadric;
+	if (!Quad_Alloc(&quadric, Quad_LodChainSize(desc, lodSlices, numLods)))
+	{
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Quad_Alloc: %s", SDL_GetError());
+		return false;
+	}
+	if (!Quad_LodChain(&quadric, &objLods[obj], desc, lodSlices, numLods))
+	{
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Quad_LodChain: %s", SDL_GetError());
+		Quad_Free(&quadric);
+		return false;
+	}
+	for (unsigned i = 0; i < numLods; ++i)
+	{
+		Quadric lod = Quad_LodView(&quadric, &objLods[obj].lods[i]);
+		if (!Lesson18_OptimizeLod(obj, i, &lod))
+		{
+			Quad_Free(&quadric);
+			return false;
+		}
+	}
+
+	const bool result = Lesson18_UploadObject(ctx, obj, quadric.vertexData, quadric.numVertices,
+		quadric.indexData, quadric.numIndices, quadric.indexType);
+	Quad_Free(&quadric);
+	return result;
+}
+
 static bool Lesson18_Init(NeHeContext* restrict ctx)
 {
 	SDL_GPUShader* vertexShaderUnlit, * fragmentShaderUnlit;
@@ -101,7 +181,7 @@ static bool Lesson18_Init(NeHeContext* restrict ctx)
 	{
 		return false;
 	}
-	if (!NeHe_LoadShaders(ctx, &vertexShaderLight, &fragmentShaderLight, "lesson7",
+	if (!NeHe_LoadShaders(ctx, &vertexShaderLight, &fragmentShaderLight, "lesson7_oct",
 		&(const NeHeShaderProgramCreateInfo){ .vertexUniforms = 2, .fragmentSamplers = 1 }))
 	{
 		SDL_ReleaseGPUShader(ctx->device, fragmentShaderUnlit);
@@ -114,20 +194,20 @@ static bool Lesson18_Init(NeHeContext* restrict ctx)
 		{
 			.location = 0,
 			.buffer_slot = 0,
-			.format = SDL_GPU_VERTEXELEMENTFORMAT_FLOAT3,
-			.offset = offsetof(QuadVertexNormalTexture, x)
+			.format = SDL_GPU_VERTEXELEMENTFORMAT_HALF4,
+			.offset = offsetof(QuadVertexPacked, x)
 		},
 		{
 			.location = 1,
 			.buffer_slot = 0,
-			.format = SDL_GPU_VERTEXELEMENTFORMAT_FLOAT2,
-			.offset = offsetof(QuadVertexNormalTexture, u)
+			.format = SDL_GPU_VERTEXELEMENTFORMAT_USHORT2_NORM,
+			.offset = offsetof(QuadVertexPacked, u)
 		},
 		{
 			.location = 2,
 			.buffer_slot = 0,
-			.format = SDL_GPU_VERTEXELEMENTFORMAT_FLOAT3,
-			.offset = offsetof(QuadVertexNormalTexture, nx)
+			.format = SDL_GPU_VERTEXELEMENTFORMAT_SHORT2_NORM,
+			.offset = offsetof(QuadVertexPacked, nx)
 		}
 	};
 
@@ -136,7 +216,7 @@ static bool Lesson18_Init(NeHeContext* restrict ctx)
 		.vertex_buffer_descriptions = &(const SDL_GPUVertexBufferDescription)
 		{
 			.slot = 0,
-			.pitch = sizeof(QuadVertexNormalTexture),
+			.pitch = sizeof(QuadVertexPacked),
 			.input_rate = SDL_GPU_VERTEXINPUTRATE_VERTEX
 		},
 		.num_vertex_buffers = 1,
@@ -237,102 +317,53 @@ static bool Lesson18_Init(NeHeContext* restrict ctx)
 	}
 
 	// Upload pre-made cube
-	if (!NeHe_CreateVertexIndexBuffer(ctx, &objVtxBuffers[OBJECT_CUBE], &objIdxBuffers[OBJECT_CUBE],
-		cubeVertices, sizeof(cubeVertices),
-		cubeIndices, sizeof(cubeIndices)))
-	{
-		return false;
-	}
-	objIdxCounts[OBJECT_CUBE] = SDL_arraysize(cubeIndices);
-
-	// Pre-generate static quadrics
-	QuadVertexNormalTexture quadricVertices[QUADRIC_VERTEX_CAPACITY];
-	QuadIndex quadricIndices[QUADRIC_INDEX_CAPACITY];
-	Quadric quadric =
-	{
-		.vertexData = quadricVertices,
-		.indices    = quadricIndices,
-		.vertexCapacity = SDL_arraysize(quadricVertices),
-		.indexCapacity  = SDL_arraysize(quadricIndices)
-	};
-	Quad_Cylinder(&quadric, 1.0f, 1.0f, 3.0f, 32, 32);
-	objIdxCounts[OBJECT_CYLINDER] = quadric.numIndices;
-	if (!NeHe_CreateVertexIndexBuffer(ctx, &objVtxBuffers[OBJECT_CYLINDER], &objIdxBuffers[OBJECT_CYLINDER],
-		quadric.vertexData, sizeof(QuadVertexNormalTexture) * quadric.numVertices,
-		quadric.indices, sizeof(QuadIndex) * quadric.numIndices))
-	{
-		return false;
-	}
-	Quad_Disc(&quadric, 0.5f, 1.5f, 32, 32);
-	objIdxCounts[OBJECT_DISC] = quadric.numIndices;
-	if (!NeHe_CreateVertexIndexBuffer(ctx, &objVtxBuffers[OBJECT_DISC], &objIdxBuffers[OBJECT_DISC],
-		quadric.vertexData, sizeof(QuadVertexNormalTexture) * quadric.numVertices,
-		quadric.indices, sizeof(QuadIndex) * quadric.numIndices))
+	if (!Lesson18_UploadObject(ctx, OBJECT_CUBE, cubeVertices, SDL_arraysize(cubeVertices),
+		cubeIndices, SDL_arraysize(cubeIndices), QUAD_INDEX_16))
 	{
 		return false;
 	}
-	Quad_Cylinder(&quadric, 1.0f, 0.0f, 3.0f, 32, 32);
-	objIdxCounts[OBJECT_CONE] = quadric.numIndices;
-	if (!NeHe_CreateVertexIndexBuffer(ctx, &objVtxBuffers[OBJECT_CONE], &objIdxBuffers[OBJECT_CONE],
-		quadric.vertexData, sizeof(QuadVertexNormalTexture) * quadric.numVertices,
-		quadric.indices, sizeof(QuadIndex) * quadric.numIndices))
+	objLods[OBJECT_CUBE] = (QuadricLodChain)
 	{
-		return false;
-	}
-	Quad_Sphere(&quadric, 1.3f, 32, 32);
-	objIdxCounts[OBJECT_SPHERE] = quadric.numIndices;
-	if (!NeHe_CreateVertexIndexBuffer(ctx, &objVtxBuffers[OBJECT_SPHERE], &objIdxBuffers[OBJECT_SPHERE],
-		quadric.vertexData, sizeof(QuadVertexNormalTexture) * quadric.numVertices,
-		quadric.indices, sizeof(QuadIndex) * quadric.numIndices))
-	{
-		return false;
-	}
+		.lods[0] = { .numIndices = SDL_arraysize(cubeIndices), .numVertices = SDL_arraysize(cubeVertices) },
+		.numLods = 1,
+		.radius = SDL_sqrtf(3.0f)
+	};
 
-	// Create GPU buffers for dynamic object
-	const unsigned dynamicVtxSize = sizeof(QuadVertexNormalTexture) * QUADRIC_VERTEX_CAPACITY;
-	const unsigned dynamicIdxSize = sizeof(QuadIndex) * QUADRIC_INDEX_CAPACITY;
-	if ((objVtxBuffers[OBJECT_DYNAMIC] = SDL_CreateGPUBuffer(ctx->device, &(const SDL_GPUBufferCreateInfo)
-	{
-		.usage = SDL_GPU_BUFFERUSAGE_VERTEX,
-		.size = dynamicVtxSize
-	})) == NULL)
-	{
-		return false;
-	}
-	if ((objIdxBuffers[OBJECT_DYNAMIC] = SDL_CreateGPUBuffer(ctx->device, &(const SDL_GPUBufferCreateInfo)
-	{
-		.usage = SDL_GPU_BUFFERUSAGE_INDEX,
-		.size = dynamicIdxSize
-	})) == NULL)
+	// Pre-generate static quadrics
+	if (!Lesson18_CreateQuadric(ctx, OBJECT_CYLINDER, &(const QuadricDesc)
+		{ .shape = QUAD_SHAPE_CYLINDER, .radius = 1.0f, .topRadius = 1.0f, .height = 3.0f })
+	|| !Lesson18_CreateQuadric(ctx, OBJECT_DISC, &(const QuadricDesc)
+		{ .shape = QUAD_SHAPE_DISC, .radius = 1.5f, .innerRadius = 0.5f })
+	|| !Lesson18_CreateQuadric(ctx, OBJECT_SPHERE, &(const QuadricDesc)
+		{ .shape = QUAD_SHAPE_SPHERE, .radius = 1.3f })
+	|| !Lesson18_CreateQuadric(ctx, OBJECT_CONE, &(const QuadricDesc)
+		{ .shape = QUAD_SHAPE_CYLINDER, .radius = 1.0f, .topRadius = 0.0f, .height = 3.0f }))
 	{
 		return false;
 	}
 
-	// Create transfer buffers for dynamic object
-	if ((objDynamicVtxXferBuffer = SDL_CreateGPUTransferBuffer(ctx->device, &(const SDL_GPUTransferBufferCreateInfo)
-	{
-		.usage = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD,
-		.size = dynamicVtxSize
-	})) == NULL)
+	// The animated disc is generated once at full resolution, its sweep is just an index range
+	Quadric quadric;
+	if (!Quad_Alloc(&quadric, Quad_DiscSweepableSize(0.5f, DYNAMIC_SLICES, DYNAMIC_LOOPS)))
 	{
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Quad_Alloc: %s", SDL_GetError());
 		return false;
 	}
-	if ((objDynamicIdxXferBuffer = SDL_CreateGPUTransferBuffer(ctx->device, &(const SDL_GPUTransferBufferCreateInfo)
-	{
-		.usage = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD,
-		.size = dynamicIdxSize
-	})) == NULL)
+	if (!Quad_DiscSweepable(&quadric, 0.5f, 1.5f, DYNAMIC_SLICES, DYNAMIC_LOOPS))
 	{
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Quad_DiscSweepable: %s", SDL_GetError());
+		Quad_Free(&quadric);
 		return false;
 	}
-
-	return true;
+	objLods[OBJECT_DYNAMIC] = (QuadricLodChain){ .numLods = 1, .radius = 1.5f };
+	const bool result = Lesson18_UploadObject(ctx, OBJECT_DYNAMIC, quadric.vertexData, quadric.numVertices,
+		quadric.indexData, quadric.numIndices, quadric.indexType);
+	Quad_Free(&quadric);
+	return result;
 }
 
 static void Lesson18_Quit(NeHeContext* restrict ctx)
 {
-	SDL_ReleaseGPUTransferBuffer(ctx->device, objDynamicIdxXferBuffer);
-	SDL_ReleaseGPUTransferBuffer(ctx->device, objDynamicVtxXferBuffer);
 	for (int i = NUM_OBJECTS - 1; i > 0; --i)
 	{
 		SDL_ReleaseGPUBuffer(ctx->device, objIdxBuffers[i]);
@@ -360,7 +391,7 @@ static void Lesson18_Resize(NeHeContext* restrict ctx, int width, int height)
 static void Lesson18_Draw(NeHeContext* restrict ctx, SDL_GPUCommandBuffer* restrict cmd,
 	SDL_GPUTexture* restrict swapchain, unsigned swapchainW, unsigned swapchainH)
 {
-	(void)swapchainW; (void)swapchainH;
+	(void)swapchainW;
 
 	const SDL_GPUColorTargetInfo colorInfo =
 	{
@@ -395,39 +426,10 @@ static void Lesson18_Draw(NeHeContext* restrict ctx, SDL_GPUCommandBuffer* restr
 			? (float)angleCounter
 			: (float)(720 - angleCounter);
 
-		// Generate dynamic disc mesh in the transfer buffers
-		Quadric quadric =
-		{
-			.vertexData = SDL_MapGPUTransferBuffer(ctx->device, objDynamicVtxXferBuffer, true),
-			.indices    = (QuadIndex*)SDL_MapGPUTransferBuffer(ctx->device, objDynamicIdxXferBuffer, true),
-			.vertexCapacity = QUADRIC_VERTEX_CAPACITY,
-			.indexCapacity  = QUADRIC_INDEX_CAPACITY
-		};
-		SDL_assert(quadric.vertexData && quadric.indices);
-		Quad_DiscPartial(&quadric, 0.5f, 1.5f, 32, 32, angleStart, angleSweep);
-		SDL_UnmapGPUTransferBuffer(ctx->device, objDynamicIdxXferBuffer);
-		SDL_UnmapGPUTransferBuffer(ctx->device, objDynamicVtxXferBuffer);
-
-		// Update the dynamic mesh on the GPU
-		SDL_GPUCopyPass* pass = SDL_BeginGPUCopyPass(cmd);
-		SDL_UploadToGPUBuffer(pass, &(const SDL_GPUTransferBufferLocation)
-		{
-			.transfer_buffer = objDynamicVtxXferBuffer
-		}, &(const SDL_GPUBufferRegion)
-		{
-			.buffer = objVtxBuffers[OBJECT_DYNAMIC],
-			.size = sizeof(QuadVertexNormalTexture) * quadric.numVertices
-		}, true);
-		SDL_UploadToGPUBuffer(pass, &(const SDL_GPUTransferBufferLocation)
-		{
-			.transfer_buffer = objDynamicIdxXferBuffer
-		}, &(const SDL_GPUBufferRegion)
-		{
-			.buffer = objIdxBuffers[OBJECT_DYNAMIC],
-			.size = sizeof(QuadIndex) * quadric.numIndices
-		}, true);
-		SDL_EndGPUCopyPass(pass);
-		objIdxCounts[OBJECT_DYNAMIC] = quadric.numIndices;
+		// Select the slices covered by the current sweep
+		const QuadricRange range = Quad_DiscSweepRange(0.5f, DYNAMIC_SLICES, DYNAMIC_LOOPS, angleStart, angleSweep);
+		objLods[OBJECT_DYNAMIC].lods[0].firstIndex = range.firstIndex;
+		objLods[OBJECT_DYNAMIC].lods[0].numIndices = range.numIndices;
 	}
 
 	// Begin pass & bind pipeline state
@@ -461,8 +463,11 @@ static void Lesson18_Draw(NeHeContext* restrict ctx, SDL_GPUCommandBuffer* restr
 	{
 		.buffer = objIdxBuffers[object],
 		.offset = 0
-	}, SDL_GPU_INDEXELEMENTSIZE_16BIT);
-	unsigned numIndices = objIdxCounts[object];
+	}, objIdxSizes[object]);
+
+	// Distant objects draw with coarser tessellation
+	const QuadricLodChain* chain = &objLods[object];
+	const QuadricLod* lod = &chain->lods[Quad_SelectLod(chain, &projection, &model, (float)swapchainH)];
 
 	// Push shader uniforms
 	if (lighting)
@@ -478,7 +483,7 @@ static void Lesson18_Draw(NeHeContext* restrict ctx, SDL_GPUCommandBuffer* restr
 	}
 
 	// Draw object
-	SDL_DrawGPUIndexedPrimitives(pass, numIndices, 1, 0, 0, 0);
+	SDL_DrawGPUIndexedPrimitives(pass, lod->numIndices, 1, lod->firstIndex, (Sint32)lod->vertexOffset, 0);
 
 	SDL_EndGPURenderPass(pass);
 
@@ -4,6 +4,7 @@
  */
 
 #include "nehe.h"
+#include "spritebatch.h"
 
 #define MAX_PARTICLES 1000
 
@@ -132,8 +133,7 @@ typedef struct
 static SDL_GPUGraphicsPipeline* pso = NULL;
 static SDL_GPUTexture* particleTexture = NULL;
 static SDL_GPUSampler* sampler = NULL;
-static SDL_GPUTransferBuffer* particleInstancesXferBuffer = NULL;
-static SDL_GPUBuffer* particleInstancesGPUBuffer = NULL;
+static NeHeSpriteBatch particleSprites;
 
 static Mtx projection;
 
@@ -230,23 +230,8 @@ static bool Lesson19_Init(NeHeContext* restrict ctx)
 		return false;
 	}
 
-	if ((particleInstancesXferBuffer = SDL_CreateGPUTransferBuffer(ctx->device, &(const SDL_GPUTransferBufferCreateInfo)
+	if (!NeHe_CreateSpriteBatch(ctx, &particleSprites, sizeof(Instance), 4, MAX_PARTICLES))
 	{
-		.usage = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD,
-		.size = sizeof(Instance) * MAX_PARTICLES
-	})) == NULL)
-	{
-		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "SDL_CreateGPUTransferBuffer: %s", SDL_GetError());
-		return false;
-	}
-
-	if ((particleInstancesGPUBuffer = SDL_CreateGPUBuffer(ctx->device, &(const SDL_GPUBufferCreateInfo)
-	{
-		.usage = SDL_GPU_BUFFERUSAGE_VERTEX,
-		.size = sizeof(Instance) * MAX_PARTICLES
-	})) == NULL)
-	{
-		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "SDL_CreateGPUBuffer: %s", SDL_GetError());
 		return false;
 	}
 
@@ -257,8 +242,7 @@ static bool Lesson19_Init(NeHeContext* restrict ctx)
 
 static void Lesson19_Quit(NeHeContext* restrict ctx)
 {
-	SDL_ReleaseGPUBuffer(ctx->device, particleInstancesGPUBuffer);
-	SDL_ReleaseGPUTransferBuffer(ctx->device, particleInstancesXferBuffer);
+	NeHe_DestroySpriteBatch(ctx, &particleSprites);
 	SDL_ReleaseGPUSampler(ctx->device, sampler);
 	SDL_ReleaseGPUTexture(ctx->device, particleTexture);
 	SDL_ReleaseGPUGraphicsPipeline(ctx->device, pso);
@@ -287,70 +271,67 @@ static void Lesson19_Draw(NeHeContext* restrict ctx, SDL_GPUCommandBuffer* restr
 		.store_op = SDL_GPU_STOREOP_STORE
 	};
 
-	// Fill instances buffer
-	Instance* instances = (Instance*)SDL_MapGPUTransferBuffer(ctx->device, particleInstancesXferBuffer, true);
-	unsigned numInstances = 0;
+	// Gather particle bounds, billboards reach out to the corners of a unit square
+	static Vec4f particleBounds[MAX_PARTICLES];
+	static unsigned visibleParticles[MAX_PARTICLES];
 	for (unsigned i = 0; i < MAX_PARTICLES; ++i)
 	{
-		const Particle* particle = &system.particles[i];
+		const Vec3f* position = &system.particles[i].position;
+		particleBounds[i] = (Vec4f){ position->x, position->y, position->z, SDL_sqrtf(0.5f) };
+	}
 
-		instances[numInstances++] = (Instance)
+	// Drop particles outside the view frustum
+	Mtx model = Mtx_Translation(0.0f, 0.0f, zoom);
+	Mtx modelViewProjection = Mtx_Multiply(&projection, &model);
+	Vec4f planes[6];
+	Mtx_FrustumPlanes(planes, &modelViewProjection);
+	const unsigned numVisible = Mtx_CullSpheres(planes, particleBounds, MAX_PARTICLES, visibleParticles);
+
+	// Fill instances buffer with the visible particles
+	NeHe_BeginSprites(&particleSprites);
+	Instance* instances = NeHe_PushSprites(&particleSprites, &(const NeHeSpriteMaterial)
+	{
+		.pipeline = pso,
+		.texture = particleTexture,
+		.sampler = sampler
+	}, numVisible);
+	if (instances)
+	{
+		for (unsigned i = 0; i < numVisible; ++i)
 		{
-			.position =
-			{
-				.x = particle->position.x,
-				.y = particle->position.y,
-				.z = particle->position.z,
-				.w = 1.0f
-			},
-			.color =
+			const Particle* particle = &system.particles[visibleParticles[i]];
+
+			instances[i] = (Instance)
 			{
-				.r = particle->color.r,
-				.g = particle->color.g,
-				.b = particle->color.b,
-				.a = particle->life
-			}
-		};
+				.position =
+				{
+					.x = particle->position.x,
+					.y = particle->position.y,
+					.z = particle->position.z,
+					.w = 1.0f
+				},
+				.color =
+				{
+					.r = particle->color.r,
+					.g = particle->color.g,
+					.b = particle->color.b,
+					.a = particle->life
+				}
+			};
+		}
 	}
-	SDL_UnmapGPUTransferBuffer(ctx->device, particleInstancesXferBuffer);
 
 	// Upload instances to the GPU
-	SDL_GPUCopyPass* copyPass = SDL_BeginGPUCopyPass(cmd);
-	SDL_UploadToGPUBuffer(copyPass, &(const SDL_GPUTransferBufferLocation)
-	{
-		.transfer_buffer = particleInstancesXferBuffer
-	}, &(const SDL_GPUBufferRegion)
-	{
-		.buffer = particleInstancesGPUBuffer,
-		.size = sizeof(Instance) * numInstances
-	}, true);
-	SDL_EndGPUCopyPass(copyPass);
+	NeHe_UploadSprites(ctx, &particleSprites, cmd);
 
-	// Begin render pass & bind pipeline state
+	// Begin render pass
 	SDL_GPURenderPass* renderPass = SDL_BeginGPURenderPass(cmd, &colorInfo, 1, NULL);
-	SDL_BindGPUGraphicsPipeline(renderPass, pso);
-
-	// Bind particle texture
-	SDL_BindGPUFragmentSamplers(renderPass, 0, &(const SDL_GPUTextureSamplerBinding)
-	{
-		.texture = particleTexture,
-		.sampler = sampler
-	}, 1);
-
-	// Bind particle instances buffer
-	SDL_BindGPUVertexBuffers(renderPass, 0, &(const SDL_GPUBufferBinding)
-	{
-		.buffer = particleInstancesGPUBuffer,
-		.offset = 0
-	}, 1);
 
 	// Push matrix uniform
-	Mtx model = Mtx_Translation(0.0f, 0.0f, zoom);
-	Mtx modelViewProjection = Mtx_Multiply(&projection, &model);
 	SDL_PushGPUVertexUniformData(cmd, 0, &modelViewProjection, sizeof(modelViewProjection));
 
 	// Draw particle instances
-	SDL_DrawGPUPrimitives(renderPass, 4, numInstances, 0, 0);
+	NeHe_DrawSprites(&particleSprites, renderPass, 0);
 
 	SDL_EndGPURenderPass(renderPass);
 
@@ -4,17 +4,19 @@
  */
 
 #include "nehe.h"
+#include "spritebatch.h"
 
 
 typedef struct
 {
-	Mtx modelViewProj;
+	Mtx model;
 	float texOffsetX, texOffsetY;
 	float texScaleX, texScaleY;
-} VertexUniform;
+} Instance;
 
 
 static SDL_GPUGraphicsPipeline* pso = NULL, * psoPremultiplied = NULL, * psoAdditive = NULL;
+static NeHeSpriteBatch sprites;
 static SDL_GPUTexture* textureLogo = NULL;
 static SDL_GPUTexture* textureImage1 = NULL, * textureImage2 = NULL;
 static SDL_GPUSampler* sampler = NULL;
@@ -37,6 +39,41 @@ static bool Lesson20_Init(NeHeContext* restrict ctx)
 		return false;
 	}
 
+	const SDL_GPUVertexAttribute vertexAttribs[] =
+	{
+		// Instance matrix attributes (one for each column)
+		{
+			.location = 0,
+			.buffer_slot = 0,
+			.format = SDL_GPU_VERTEXELEMENTFORMAT_FLOAT4,
+			.offset = offsetof(Instance, model.c[0])
+		},
+		{
+			.location = 1,
+			.buffer_slot = 0,
+			.format = SDL_GPU_VERTEXELEMENTFORMAT_FLOAT4,
+			.offset = offsetof(Instance, model.c[1])
+		},
+		{
+			.location = 2,
+			.buffer_slot = 0,
+			.format = SDL_GPU_VERTEXELEMENTFORMAT_FLOAT4,
+			.offset = offsetof(Instance, model.c[2])
+		},
+		{
+			.location = 3,
+			.buffer_slot = 0,
+			.format = SDL_GPU_VERTEXELEMENTFORMAT_FLOAT4,
+			.offset = offsetof(Instance, model.c[3])
+		},
+		// Texture offset & scale
+		{
+			.location = 4,
+			.buffer_slot = 0,
+			.format = SDL_GPU_VERTEXELEMENTFORMAT_FLOAT4,
+			.offset = offsetof(Instance, texOffsetX)
+		}
+	};
 	SDL_GPUColorTargetDescription colorDesc =
 	{
 		.format = SDL_GetGPUSwapchainTextureFormat(ctx->device, ctx->window)
@@ -46,6 +83,18 @@ static bool Lesson20_Init(NeHeContext* restrict ctx)
 		.vertex_shader = vertexShader,
 		.fragment_shader = fragmentShader,
 		.primitive_type = SDL_GPU_PRIMITIVETYPE_TRIANGLESTRIP,
+		.vertex_input_state =
+		{
+			.vertex_buffer_descriptions = &(const SDL_GPUVertexBufferDescription)
+			{
+				.slot = 0,
+				.pitch = sizeof(Instance),
+				.input_rate = SDL_GPU_VERTEXINPUTRATE_INSTANCE
+			},
+			.num_vertex_buffers = 1,
+			.vertex_attributes = vertexAttribs,
+			.num_vertex_attributes = SDL_arraysize(vertexAttribs)
+		},
 		.rasterizer_state =
 		{
 			.fill_mode = SDL_GPU_FILLMODE_FILL,
@@ -127,11 +176,18 @@ static bool Lesson20_Init(NeHeContext* restrict ctx)
 		return false;
 	}
 
+	// Background & overlay quads are batched as instances
+	if (!NeHe_CreateSpriteBatch(ctx, &sprites, sizeof(Instance), 4, 2))
+	{
+		return false;
+	}
+
 	return true;
 }
 
 static void Lesson20_Quit(NeHeContext* restrict ctx)
 {
+	NeHe_DestroySpriteBatch(ctx, &sprites);
 	SDL_ReleaseGPUSampler(ctx->device, sampler);
 	SDL_ReleaseGPUTexture(ctx->device, textureImage2);
 	SDL_ReleaseGPUTexture(ctx->device, textureImage1);
@@ -154,7 +210,7 @@ static void Lesson20_Resize(NeHeContext* restrict ctx, int width, int height)
 static void Lesson20_Draw(NeHeContext* restrict ctx, SDL_GPUCommandBuffer* restrict cmd,
 	SDL_GPUTexture* restrict swapchain, unsigned swapchainW, unsigned swapchainH)
 {
-	(void)ctx; (void)swapchainW; (void)swapchainH;
+	(void)swapchainW; (void)swapchainH;
 
 	const SDL_GPUColorTargetInfo colorInfo =
 	{
@@ -164,66 +220,76 @@ static void Lesson20_Draw(NeHeContext* restrict ctx, SDL_GPUCommandBuffer* restr
 		.store_op = SDL_GPU_STOREOP_STORE
 	};
 
-	// Begin pass
-	SDL_GPURenderPass* pass = SDL_BeginGPURenderPass(cmd, &colorInfo, 1, NULL);
-
+	NeHe_BeginSprites(&sprites);
 	Mtx model = Mtx_Translation(0.0f, 0.0f, -2.0f);
 
-	// Draw logo background
-	SDL_BindGPUGraphicsPipeline(pass, pso);  // Opaque
-	SDL_BindGPUFragmentSamplers(pass, 0, &(const SDL_GPUTextureSamplerBinding)
+	// Logo background
+	Instance* background = NeHe_PushSprites(&sprites, &(const NeHeSpriteMaterial)
 	{
+		.pipeline = pso,  // Opaque
 		.texture = textureLogo,
-		.sampler = sampler
+		.sampler = sampler,
+		.layer = 0
 	}, 1);
-	VertexUniform u =
-	{
-		.modelViewProj = Mtx_Multiply(&projection, &model),
-		.texOffsetX = 0.0f,
-		.texOffsetY = -animate,
-		.texScaleX = 3.0f,
-		.texScaleY = 3.0f
-	};
-	SDL_PushGPUVertexUniformData(cmd, 0, &u, sizeof(VertexUniform));
-	SDL_DrawGPUPrimitives(pass, 4, 1, 0, 0);
-
-	// Setup overlay uniforms
-	if (scene == 0)
-	{
-		u = (VertexUniform)
-		{
-			.modelViewProj = u.modelViewProj,  // Reuse background matrix
-			.texOffsetX = animate,
-			.texOffsetY = 0.0f,
-			.texScaleX = 4.0f,
-			.texScaleY = 4.0f,
-		};
-	}
-	else
+	if (background)
 	{
-		// Rotate around centre and move further into screen
-		Mtx_Translate(&model, 0.0f, 0.0f, -1.0f);
-		Mtx_Rotate(&model, 360.0f * animate, 0.0f, 0.0f, 1.0f);
-
-		u = (VertexUniform)
+		*background = (Instance)
 		{
-			.modelViewProj = Mtx_Multiply(&projection, &model),
+			.model = model,
 			.texOffsetX = 0.0f,
-			.texOffsetY = 0.0f,
-			.texScaleX = 1.0f,
-			.texScaleY = 1.0f,
+			.texOffsetY = -animate,
+			.texScaleX = 3.0f,
+			.texScaleY = 3.0f
 		};
 	}
-	SDL_PushGPUVertexUniformData(cmd, 0, &u, sizeof(VertexUniform));
 
-	// Draw "scene" overlay with pre-multiplied or additive blending
-	SDL_BindGPUGraphicsPipeline(pass, masking ? psoPremultiplied : psoAdditive);
-	SDL_BindGPUFragmentSamplers(pass, 0, &(const SDL_GPUTextureSamplerBinding)
+	// "Scene" overlay with pre-multiplied or additive blending
+	Instance* overlay = NeHe_PushSprites(&sprites, &(const NeHeSpriteMaterial)
 	{
+		.pipeline = masking ? psoPremultiplied : psoAdditive,
 		.texture = (scene == 0) ? textureImage1 : textureImage2,
-		.sampler = sampler
+		.sampler = sampler,
+		.layer = 1  // Always on top of the background
 	}, 1);
-	SDL_DrawGPUPrimitives(pass, 4, 1, 0, 0);
+	if (overlay)
+	{
+		if (scene == 0)
+		{
+			*overlay = (Instance)
+			{
+				.model = model,  // Reuse background matrix
+				.texOffsetX = animate,
+				.texOffsetY = 0.0f,
+				.texScaleX = 4.0f,
+				.texScaleY = 4.0f,
+			};
+		}
+		else
+		{
+			// Rotate around centre and move further into screen
+			Mtx_Translate(&model, 0.0f, 0.0f, -1.0f);
+			Mtx_Rotate(&model, 360.0f * animate, 0.0f, 0.0f, 1.0f);
+
+			*overlay = (Instance)
+			{
+				.model = model,
+				.texOffsetX = 0.0f,
+				.texOffsetY = 0.0f,
+				.texScaleX = 1.0f,
+				.texScaleY = 1.0f,
+			};
+		}
+	}
+
+	// Upload quad instances
+	NeHe_UploadSprites(ctx, &sprites, cmd);
+
+	// Begin pass
+	SDL_GPURenderPass* pass = SDL_BeginGPURenderPass(cmd, &colorInfo, 1, NULL);
+
+	// Projection is shared by all quads, so it's pushed once for the whole batch
+	SDL_PushGPUVertexUniformData(cmd, 0, &projection, sizeof(Mtx));
+	NeHe_DrawSprites(&sprites, pass, 0);
 
 	SDL_EndGPURenderPass(pass);
 
@@ -8,15 +8,18 @@
 
 
 static NeHeSound* sndComplete = NULL, * sndDie = NULL, * sndFreeze = NULL, * sndHourglass = NULL;
+static NeHeSoundStream* music = NULL;
+static NeHeVoice musicVoice = 0;
+static bool logSoundStats = false;
 
 
 static bool Lesson21_Init(NeHeContext* restrict ctx)
 {
+	NeHe_OpenSound();
 	sndComplete  = NeHe_LoadSound(ctx, "Data/Complete.wav");
 	sndDie       = NeHe_LoadSound(ctx, "Data/Die.wav");
 	sndFreeze    = NeHe_LoadSound(ctx, "Data/freeze.wav");
 	sndHourglass = NeHe_LoadSound(ctx, "Data/hourglass.wav");
-	NeHe_OpenSound();
 
 	return true;
 }
@@ -25,11 +28,13 @@ static void Lesson21_Quit(NeHeContext* restrict ctx)
 {
 	(void)ctx;
 
+	NeHe_CloseSoundStream(music);
+	music = NULL;
 	NeHe_CloseSound();
-	SDL_free(sndHourglass);
-	SDL_free(sndFreeze);
-	SDL_free(sndDie);
-	SDL_free(sndComplete);
+	NeHe_FreeSound(sndHourglass);
+	NeHe_FreeSound(sndFreeze);
+	NeHe_FreeSound(sndDie);
+	NeHe_FreeSound(sndComplete);
 }
 
 static void Lesson21_Draw(NeHeContext* restrict ctx, SDL_GPUCommandBuffer* restrict cmd,
@@ -37,6 +42,8 @@ static void Lesson21_Draw(NeHeContext* restrict ctx, SDL_GPUCommandBuffer* restr
 {
 	(void)swapchainW; (void)swapchainH;
 
+	NeHe_UpdateSound();
+
 	const SDL_GPUColorTargetInfo colorInfo =
 	{
 		.texture = swapchain,
@@ -51,8 +58,6 @@ static void Lesson21_Draw(NeHeContext* restrict ctx, SDL_GPUCommandBuffer* restr
 
 static void Lesson21_Key(NeHeContext* ctx, SDL_Keycode key, bool down, bool repeat)
 {
-	(void)ctx;
-
 	if (down && !repeat)
 	{
 		switch (key)
@@ -72,6 +77,29 @@ static void Lesson21_Key(NeHeContext* ctx, SDL_Keycode key, bool down, bool repe
 		case SDLK_5:
 			NeHe_PlaySound(NULL, 0);
 			break;
+		case SDLK_6:
+			logSoundStats = !logSoundStats;
+			NeHe_LogSoundStats(logSoundStats ? 2000u : 0u);
+			break;
+		case SDLK_7:
+		{
+			// Toggle streaming a looping track from disk, a stream can only be played once so it's reopened each
+			// time. Closing a stream stops its voice, unless 5 already stopped it
+			const bool playing = music && NeHe_VoicePlaying(musicVoice);
+			NeHe_CloseSoundStream(music);
+			music = NULL;
+			if (playing || (music = NeHe_OpenSoundStream(ctx, "Data/hourglass.wav", true)) == NULL)
+			{
+				break;
+			}
+			// Music shouldn't be stolen by sound effects
+			musicVoice = NeHe_StartStreamVoice(music, &(const NeHeVoiceParams){ .gain = 1.0f, .priority = 1 });
+			if (!musicVoice)
+			{
+				SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "NeHe_StartStreamVoice: %s", SDL_GetError());
+			}
+			break;
+		}
 		default:
 			break;
 		}
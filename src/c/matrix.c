@@ -5,6 +5,7 @@
 
 #include "matrix.h"
 #include <SDL3/SDL_stdinc.h>
+#include <SDL3/SDL_intrin.h>
 
 
 extern inline Mtx Mtx_Init(Vec4f d);
@@ -134,6 +135,203 @@ Vec4f Mtx_VectorProject(Vec4f l, const Mtx* r)
 	};
 }
 
+void Mtx_FrustumPlanes(Vec4f planes[6], const Mtx* m)
+{
+	// Rows of the matrix, clip space coordinates are the dot product of each with the incoming point
+	const Vec4f r[4] =
+	{
+		{ m->c[0].x, m->c[1].x, m->c[2].x, m->c[3].x },
+		{ m->c[0].y, m->c[1].y, m->c[2].y, m->c[3].y },
+		{ m->c[0].z, m->c[1].z, m->c[2].z, m->c[3].z },
+		{ m->c[0].w, m->c[1].w, m->c[2].w, m->c[3].w }
+	};
+
+	// -w <= x <= w, -w <= y <= w, 0 <= z <= w
+	planes[0] = (Vec4f){ r[3].x + r[0].x, r[3].y + r[0].y, r[3].z + r[0].z, r[3].w + r[0].w };
+	planes[1] = (Vec4f){ r[3].x - r[0].x, r[3].y - r[0].y, r[3].z - r[0].z, r[3].w - r[0].w };
+	planes[2] = (Vec4f){ r[3].x + r[1].x, r[3].y + r[1].y, r[3].z + r[1].z, r[3].w + r[1].w };
+	planes[3] = (Vec4f){ r[3].x - r[1].x, r[3].y - r[1].y, r[3].z - r[1].z, r[3].w - r[1].w };
+	planes[4] = r[2];
+	planes[5] = (Vec4f){ r[3].x - r[2].x, r[3].y - r[2].y, r[3].z - r[2].z, r[3].w - r[2].w };
+
+	for (int i = 0; i < 6; ++i)
+	{
+		const float len = SDL_sqrtf(planes[i].x * planes[i].x + planes[i].y * planes[i].y + planes[i].z * planes[i].z);
+		const float inv = len > 0.0f ? 1.0f / len : 0.0f;
+		planes[i] = (Vec4f){ planes[i].x * inv, planes[i].y * inv, planes[i].z * inv, planes[i].w * inv };
+	}
+}
+
+static inline bool Mtx_SphereVisible(const Vec4f planes[6], Vec4f s)
+{
+	for (int i = 0; i < 6; ++i)
+	{
+		if (planes[i].x * s.x + planes[i].y * s.y + planes[i].z * s.z + planes[i].w < -s.w)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+static inline bool Mtx_BoxVisible(const Vec4f planes[6], Vec3f min, Vec3f max)
+{
+	const Vec3f c = { 0.5f * (min.x + max.x), 0.5f * (min.y + max.y), 0.5f * (min.z + max.z) };
+	const Vec3f e = { 0.5f * (max.x - min.x), 0.5f * (max.y - min.y), 0.5f * (max.z - min.z) };
+	for (int i = 0; i < 6; ++i)
+	{
+		const Vec4f* p = &planes[i];
+		const float r = SDL_fabsf(p->x) * e.x + SDL_fabsf(p->y) * e.y + SDL_fabsf(p->z) * e.z;
+		if (p->x * c.x + p->y * c.y + p->z * c.z + p->w < -r)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+unsigned Mtx_CullSpheres(const Vec4f planes[6], const Vec4f* restrict spheres, unsigned count,
+	unsigned* restrict visible)
+{
+	unsigned numVisible = 0, i = 0;
+#if defined(SDL_SSE_INTRINSICS)
+	// Four spheres at a time, transposed so each register holds one component of all four
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 x = _mm_loadu_ps(&spheres[i].x), y = _mm_loadu_ps(&spheres[i + 1].x);
+		__m128 z = _mm_loadu_ps(&spheres[i + 2].x), r = _mm_loadu_ps(&spheres[i + 3].x);
+		_MM_TRANSPOSE4_PS(x, y, z, r);
+		const __m128 negR = _mm_sub_ps(_mm_setzero_ps(), r);
+		__m128 inside = _mm_cmpeq_ps(negR, negR);
+		for (int p = 0; p < 6; ++p)
+		{
+			const __m128 d = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(planes[p].x)), _mm_mul_ps(y, _mm_set1_ps(planes[p].y))),
+				_mm_add_ps(_mm_mul_ps(z, _mm_set1_ps(planes[p].z)), _mm_set1_ps(planes[p].w)));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(d, negR));
+		}
+		// Branchless compaction, every lane is written but only visible ones advance the output
+		const unsigned mask = (unsigned)_mm_movemask_ps(inside);
+		for (unsigned lane = 0; lane < 4; ++lane)
+		{
+			visible[numVisible] = i + lane;
+			numVisible += (mask >> lane) & 1u;
+		}
+	}
+#elif defined(SDL_NEON_INTRINSICS)
+	for (; i + 4 <= count; i += 4)
+	{
+		// De-interleaving load gives the same layout as the SSE transpose
+		const float32x4x4_t s = vld4q_f32(&spheres[i].x);
+		const float32x4_t negR = vnegq_f32(s.val[3]);
+		uint32x4_t inside = vdupq_n_u32(UINT32_MAX);
+		for (int p = 0; p < 6; ++p)
+		{
+			float32x4_t d = vdupq_n_f32(planes[p].w);
+			d = vmlaq_n_f32(d, s.val[0], planes[p].x);
+			d = vmlaq_n_f32(d, s.val[1], planes[p].y);
+			d = vmlaq_n_f32(d, s.val[2], planes[p].z);
+			inside = vandq_u32(inside, vcgeq_f32(d, negR));
+		}
+		const unsigned lanes[4] =
+		{
+			vgetq_lane_u32(inside, 0) & 1u, vgetq_lane_u32(inside, 1) & 1u,
+			vgetq_lane_u32(inside, 2) & 1u, vgetq_lane_u32(inside, 3) & 1u
+		};
+		for (unsigned lane = 0; lane < 4; ++lane)
+		{
+			visible[numVisible] = i + lane;
+			numVisible += lanes[lane];
+		}
+	}
+#endif
+	for (; i < count; ++i)
+	{
+		if (Mtx_SphereVisible(planes, spheres[i]))
+		{
+			visible[numVisible++] = i;
+		}
+	}
+	return numVisible;
+}
+
+unsigned Mtx_CullBoxes(const Vec4f planes[6], const Vec3f* restrict mins, const Vec3f* restrict maxs, unsigned count,
+	unsigned* restrict visible)
+{
+	unsigned numVisible = 0, i = 0;
+#if defined(SDL_SSE_INTRINSICS) || defined(SDL_NEON_INTRINSICS)
+	for (; i + 4 <= count; i += 4)
+	{
+# if defined(SDL_SSE_INTRINSICS)
+		const __m128 half = _mm_set1_ps(0.5f);
+		const __m128 minX = _mm_setr_ps(mins[i].x, mins[i + 1].x, mins[i + 2].x, mins[i + 3].x);
+		const __m128 minY = _mm_setr_ps(mins[i].y, mins[i + 1].y, mins[i + 2].y, mins[i + 3].y);
+		const __m128 minZ = _mm_setr_ps(mins[i].z, mins[i + 1].z, mins[i + 2].z, mins[i + 3].z);
+		const __m128 maxX = _mm_setr_ps(maxs[i].x, maxs[i + 1].x, maxs[i + 2].x, maxs[i + 3].x);
+		const __m128 maxY = _mm_setr_ps(maxs[i].y, maxs[i + 1].y, maxs[i + 2].y, maxs[i + 3].y);
+		const __m128 maxZ = _mm_setr_ps(maxs[i].z, maxs[i + 1].z, maxs[i + 2].z, maxs[i + 3].z);
+		const __m128 cx = _mm_mul_ps(_mm_add_ps(minX, maxX), half), ex = _mm_mul_ps(_mm_sub_ps(maxX, minX), half);
+		const __m128 cy = _mm_mul_ps(_mm_add_ps(minY, maxY), half), ey = _mm_mul_ps(_mm_sub_ps(maxY, minY), half);
+		const __m128 cz = _mm_mul_ps(_mm_add_ps(minZ, maxZ), half), ez = _mm_mul_ps(_mm_sub_ps(maxZ, minZ), half);
+		__m128 inside = _mm_cmpeq_ps(half, half);
+		for (int p = 0; p < 6; ++p)
+		{
+			// Centre distance must be no further behind the plane than the box's extent along its normal
+			const __m128 px = _mm_set1_ps(planes[p].x), py = _mm_set1_ps(planes[p].y), pz = _mm_set1_ps(planes[p].z);
+			const __m128 d = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(cx, px), _mm_mul_ps(cy, py)),
+				_mm_add_ps(_mm_mul_ps(cz, pz), _mm_set1_ps(planes[p].w)));
+			const __m128 r = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(ex, _mm_set1_ps(SDL_fabsf(planes[p].x))),
+					_mm_mul_ps(ey, _mm_set1_ps(SDL_fabsf(planes[p].y)))),
+				_mm_mul_ps(ez, _mm_set1_ps(SDL_fabsf(planes[p].z))));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(d, r), _mm_setzero_ps()));
+		}
+		const unsigned mask = (unsigned)_mm_movemask_ps(inside);
+		const unsigned lanes[4] = { mask & 1u, (mask >> 1) & 1u, (mask >> 2) & 1u, (mask >> 3) & 1u };
+# else
+		const float32x4x3_t lo = vld3q_f32(&mins[i].x), hi = vld3q_f32(&maxs[i].x);
+		const float32x4_t cx = vmulq_n_f32(vaddq_f32(lo.val[0], hi.val[0]), 0.5f);
+		const float32x4_t cy = vmulq_n_f32(vaddq_f32(lo.val[1], hi.val[1]), 0.5f);
+		const float32x4_t cz = vmulq_n_f32(vaddq_f32(lo.val[2], hi.val[2]), 0.5f);
+		const float32x4_t ex = vmulq_n_f32(vsubq_f32(hi.val[0], lo.val[0]), 0.5f);
+		const float32x4_t ey = vmulq_n_f32(vsubq_f32(hi.val[1], lo.val[1]), 0.5f);
+		const float32x4_t ez = vmulq_n_f32(vsubq_f32(hi.val[2], lo.val[2]), 0.5f);
+		uint32x4_t inside = vdupq_n_u32(UINT32_MAX);
+		for (int p = 0; p < 6; ++p)
+		{
+			float32x4_t d = vdupq_n_f32(planes[p].w);
+			d = vmlaq_n_f32(d, cx, planes[p].x);
+			d = vmlaq_n_f32(d, cy, planes[p].y);
+			d = vmlaq_n_f32(d, cz, planes[p].z);
+			d = vmlaq_n_f32(d, ex, SDL_fabsf(planes[p].x));
+			d = vmlaq_n_f32(d, ey, SDL_fabsf(planes[p].y));
+			d = vmlaq_n_f32(d, ez, SDL_fabsf(planes[p].z));
+			inside = vandq_u32(inside, vcgeq_f32(d, vdupq_n_f32(0.0f)));
+		}
+		const unsigned lanes[4] =
+		{
+			vgetq_lane_u32(inside, 0) & 1u, vgetq_lane_u32(inside, 1) & 1u,
+			vgetq_lane_u32(inside, 2) & 1u, vgetq_lane_u32(inside, 3) & 1u
+		};
+# endif
+		for (unsigned lane = 0; lane < 4; ++lane)
+		{
+			visible[numVisible] = i + lane;
+			numVisible += lanes[lane];
+		}
+	}
+#endif
+	for (; i < count; ++i)
+	{
+		if (Mtx_BoxVisible(planes, mins[i], maxs[i]))
+		{
+			visible[numVisible++] = i;
+		}
+	}
+	return numVisible;
+}
+
 void Mtx_Translate(Mtx* m, float x, float y, float z)
 {
 	/*
@@ -62,6 +62,16 @@ Mtx Mtx_Multiply(const Mtx* restrict l, const Mtx* restrict r);
 Vec4f Mtx_VectorProduct(const Mtx* l, Vec4f r);
 Vec4f Mtx_VectorProject(Vec4f l, const Mtx* r);
 
+// Extract the normalised left, right, bottom, top, near & far clip planes of a combined projection * view matrix,
+// a point p is inside a plane when dot(plane.xyz, p) + plane.w >= 0
+void Mtx_FrustumPlanes(Vec4f planes[6], const Mtx* m);
+// Test a batch of bounds against frustum planes, writing the indices of those at least partly inside to visible in
+// ascending order. The output must have room for count indices, returns the number written
+unsigned Mtx_CullSpheres(const Vec4f planes[6], const Vec4f* restrict spheres, unsigned count,
+	unsigned* restrict visible);  // Sphere centres in xyz & radii in w
+unsigned Mtx_CullBoxes(const Vec4f planes[6], const Vec3f* restrict mins, const Vec3f* restrict maxs, unsigned count,
+	unsigned* restrict visible);
+
 void Mtx_Translate(Mtx* m, float x, float y, float z);
 void Mtx_Scale(Mtx* m, float x, float y, float z);
 void Mtx_Rotate(Mtx* m, float angle, float x, float y, float z);
@@ -0,0 +1,341 @@
+/*
+ * SPDX-FileCopyrightText: (C) 2025 a dinosaur
+ * SPDX-License-Identifier: Zlib
+ */
+
+#include "meshopt.h"
+
+#include <SDL3/SDL_stdinc.h>
+#include <SDL3/SDL_assert.h>
+#include <SDL3/SDL_error.h>
+
+// Tuning constants from Tom Forsyth's "Linear-Speed Vertex Cache Optimisation"
+#define FORSYTH_CACHE_DECAY_POWER   1.5f
+#define FORSYTH_LAST_TRI_SCORE      0.75f
+#define FORSYTH_VALENCE_BOOST_SCALE 2.0f
+#define FORSYTH_VALENCE_BOOST_POWER 0.5f
+#define FORSYTH_MAX_VALENCE         32
+
+#define NO_TRIANGLE UINT32_MAX
+
+
+static inline uint32_t Mesh_GetIndex(const void* indices, unsigned indexSize, unsigned i)
+{
+	return indexSize == sizeof(uint32_t) ? ((const uint32_t*)indices)[i] : ((const uint16_t*)indices)[i];
+}
+
+static inline void Mesh_SetIndex(void* indices, unsigned indexSize, unsigned i, uint32_t value)
+{
+	if (indexSize == sizeof(uint32_t))
+	{
+		((uint32_t*)indices)[i] = value;
+	}
+	else
+	{
+		((uint16_t*)indices)[i] = (uint16_t)value;
+	}
+}
+
+
+bool Mesh_AnalyzeVertexCache(MeshCacheStats* restrict stats, const void* restrict indices, unsigned indexSize,
+	unsigned numIndices, unsigned numVertices, unsigned cacheSize)
+{
+	SDL_assert(indexSize == sizeof(uint16_t) || indexSize == sizeof(uint32_t));
+	SDL_assert(numIndices % 3 == 0 && cacheSize > 0);
+
+	*stats = (MeshCacheStats){ 0.0f, 0.0f };
+	if (numIndices == 0)
+	{
+		return true;
+	}
+
+	// A vertex is still cached if fewer than cacheSize misses happened since it was last loaded
+	uint32_t* loadedAt = SDL_malloc(sizeof(uint32_t) * numVertices);
+	if (!loadedAt)
+	{
+		return false;
+	}
+	SDL_memset(loadedAt, 0, sizeof(uint32_t) * numVertices);
+
+	uint32_t numMisses = 0, numUnique = 0;
+	for (unsigned i = 0; i < numIndices; ++i)
+	{
+		const uint32_t v = Mesh_GetIndex(indices, indexSize, i);
+		SDL_assert(v < numVertices);
+		if (loadedAt[v] == 0)
+		{
+			++numUnique;
+		}
+		// Misses are counted from 1 so a zero timestamp means never loaded
+		if (loadedAt[v] == 0 || numMisses + 1 - loadedAt[v] > cacheSize)
+		{
+			loadedAt[v] = ++numMisses;
+		}
+	}
+	SDL_free(loadedAt);
+
+	stats->acmr = (float)numMisses / (float)(numIndices / 3);
+	stats->atvr = (float)numMisses / (float)numUnique;
+	return true;
+}
+
+
+typedef struct
+{
+	float cacheScore[MESH_VERTEX_CACHE_SIZE];
+	float valenceScore[FORSYTH_MAX_VALENCE + 1];
+} ForsythScoreTable;
+
+static void Mesh_InitForsythScores(ForsythScoreTable* table)
+{
+	for (unsigned i = 0; i < MESH_VERTEX_CACHE_SIZE; ++i)
+	{
+		if (i < 3)
+		{
+			// The most recent triangle's vertices are scored flat so it isn't picked again
+			table->cacheScore[i] = FORSYTH_LAST_TRI_SCORE;
+		}
+		else
+		{
+			const float scale = 1.0f / (float)(MESH_VERTEX_CACHE_SIZE - 3);
+			table->cacheScore[i] = SDL_powf(1.0f - (float)(i - 3) * scale, FORSYTH_CACHE_DECAY_POWER);
+		}
+	}
+	// Favour vertices with few triangles left so they're finished off instead of lingering
+	table->valenceScore[0] = 0.0f;
+	for (unsigned i = 1; i <= FORSYTH_MAX_VALENCE; ++i)
+	{
+		table->valenceScore[i] = FORSYTH_VALENCE_BOOST_SCALE * SDL_powf((float)i, -FORSYTH_VALENCE_BOOST_POWER);
+	}
+}
+
+static inline float Mesh_ForsythVertexScore(const ForsythScoreTable* restrict table, int cachePos, uint32_t valence)
+{
+	if (valence == 0)
+	{
+		return -1.0f;
+	}
+	const float score = cachePos >= 0 ? table->cacheScore[cachePos] : 0.0f;
+	return score + table->valenceScore[SDL_min(valence, FORSYTH_MAX_VALENCE)];
+}
+
+bool Mesh_OptimizeVertexCache(void* indices, unsigned indexSize, unsigned numIndices, unsigned numVertices)
+{
+	SDL_assert(indexSize == sizeof(uint16_t) || indexSize == sizeof(uint32_t));
+	SDL_assert(numIndices % 3 == 0);
+
+	const unsigned numTris = numIndices / 3;
+	if (numTris < 2)
+	{
+		return true;
+	}
+
+	// Carve all working storage out of a single allocation
+	const size_t vertexBytes = (sizeof(uint32_t) * 3 + sizeof(int) + sizeof(float)) * numVertices;
+	const size_t triBytes = (sizeof(float) + sizeof(bool)) * numTris;
+	const size_t indexBytes = sizeof(uint32_t) * numIndices * 2;
+	uint8_t* storage = SDL_malloc(vertexBytes + triBytes + indexBytes);
+	if (!storage)
+	{
+		return false;
+	}
+	uint32_t* adjacency = (uint32_t*)storage;         // Triangles using each vertex, grouped by vertex
+	uint32_t* sorted    = adjacency + numIndices;     // Output triangle list
+	uint32_t* adjOffset = sorted + numIndices;        // Start of each vertex's adjacency run
+	uint32_t* valence   = adjOffset + numVertices;    // Triangles not yet emitted that use each vertex
+	uint32_t* adjCount  = valence + numVertices;
+	float* vtxScore     = (float*)(adjCount + numVertices);
+	int* cachePos       = (int*)(vtxScore + numVertices);
+	float* triScore     = (float*)(cachePos + numVertices);
+	bool* emitted       = (bool*)(triScore + numTris);
+
+	ForsythScoreTable table;
+	Mesh_InitForsythScores(&table);
+
+	// Build vertex to triangle adjacency
+	SDL_memset(valence, 0, sizeof(uint32_t) * numVertices);
+	for (unsigned i = 0; i < numIndices; ++i)
+	{
+		const uint32_t v = Mesh_GetIndex(indices, indexSize, i);
+		SDL_assert(v < numVertices);
+		++valence[v];
+	}
+	uint32_t offset = 0;
+	for (unsigned v = 0; v < numVertices; ++v)
+	{
+		adjOffset[v] = offset;
+		adjCount[v] = 0;
+		offset += valence[v];
+	}
+	for (unsigned i = 0; i < numIndices; ++i)
+	{
+		const uint32_t v = Mesh_GetIndex(indices, indexSize, i);
+		adjacency[adjOffset[v] + adjCount[v]++] = i / 3;
+	}
+
+	// Initial scores
+	for (unsigned v = 0; v < numVertices; ++v)
+	{
+		cachePos[v] = -1;
+		vtxScore[v] = Mesh_ForsythVertexScore(&table, -1, valence[v]);
+	}
+	uint32_t bestTri = NO_TRIANGLE;
+	float bestScore = -1.0f;
+	for (unsigned t = 0; t < numTris; ++t)
+	{
+		emitted[t] = false;
+		triScore[t] = vtxScore[Mesh_GetIndex(indices, indexSize, t * 3)]
+			+ vtxScore[Mesh_GetIndex(indices, indexSize, t * 3 + 1)]
+			+ vtxScore[Mesh_GetIndex(indices, indexSize, t * 3 + 2)];
+		if (triScore[t] > bestScore)
+		{
+			bestScore = triScore[t];
+			bestTri = t;
+		}
+	}
+
+	// Simulated LRU cache, with room for the 3 vertices being pushed in before the tail is evicted
+	uint32_t cache[MESH_VERTEX_CACHE_SIZE + 3];
+	unsigned cacheLen = 0;
+	unsigned scanCursor = 0;
+
+	for (unsigned numSorted = 0; numSorted < numTris; ++numSorted)
+	{
+		// Nothing in the cache scored, fall back to the next unemitted triangle in input order
+		if (bestTri == NO_TRIANGLE)
+		{
+			while (emitted[scanCursor])
+			{
+				++scanCursor;
+			}
+			bestTri = scanCursor;
+		}
+
+		uint32_t tri[3];
+		for (unsigned i = 0; i < 3; ++i)
+		{
+			tri[i] = Mesh_GetIndex(indices, indexSize, bestTri * 3 + i);
+			sorted[numSorted * 3 + i] = tri[i];
+		}
+		emitted[bestTri] = true;
+
+		// Remove the triangle from its vertices' adjacency
+		for (unsigned i = 0; i < 3; ++i)
+		{
+			const uint32_t v = tri[i];
+			uint32_t* adj = &adjacency[adjOffset[v]];
+			for (uint32_t j = 0; j < valence[v]; ++j)
+			{
+				if (adj[j] == bestTri)
+				{
+					adj[j] = adj[--valence[v]];
+					break;
+				}
+			}
+		}
+
+		// Move the triangle's vertices to the front of the cache
+		uint32_t newCache[MESH_VERTEX_CACHE_SIZE + 3];
+		unsigned newLen = 0;
+		for (unsigned i = 0; i < 3; ++i)
+		{
+			newCache[newLen++] = tri[i];
+		}
+		for (unsigned i = 0; i < cacheLen; ++i)
+		{
+			const uint32_t v = cache[i];
+			if (v != tri[0] && v != tri[1] && v != tri[2])
+			{
+				newCache[newLen++] = v;
+			}
+		}
+		SDL_memcpy(cache, newCache, sizeof(uint32_t) * newLen);
+		cacheLen = newLen;
+
+		// Rescore everything in the cache, vertices that fell out just lose their position
+		for (unsigned i = 0; i < cacheLen; ++i)
+		{
+			const uint32_t v = cache[i];
+			cachePos[v] = i < MESH_VERTEX_CACHE_SIZE ? (int)i : -1;
+			vtxScore[v] = Mesh_ForsythVertexScore(&table, cachePos[v], valence[v]);
+		}
+
+		// Only triangles touching the cache changed score, so the best next triangle is among them
+		bestTri = NO_TRIANGLE;
+		bestScore = -1.0f;
+		for (unsigned i = 0; i < cacheLen; ++i)
+		{
+			const uint32_t v = cache[i];
+			const uint32_t* adj = &adjacency[adjOffset[v]];
+			for (uint32_t j = 0; j < valence[v]; ++j)
+			{
+				const uint32_t t = adj[j];
+				triScore[t] = vtxScore[Mesh_GetIndex(indices, indexSize, t * 3)]
+					+ vtxScore[Mesh_GetIndex(indices, indexSize, t * 3 + 1)]
+					+ vtxScore[Mesh_GetIndex(indices, indexSize, t * 3 + 2)];
+				if (triScore[t] > bestScore)
+				{
+					bestScore = triScore[t];
+					bestTri = t;
+				}
+			}
+		}
+		cacheLen = SDL_min(cacheLen, MESH_VERTEX_CACHE_SIZE);
+	}
+
+	for (unsigned i = 0; i < numIndices; ++i)
+	{
+		Mesh_SetIndex(indices, indexSize, i, sorted[i]);
+	}
+	SDL_free(storage);
+	return true;
+}
+
+
+bool Mesh_OptimizeVertexFetch(void* restrict vertices, unsigned vertexStride,
+	void* restrict indices, unsigned indexSize, unsigned numIndices, unsigned numVertices)
+{
+	SDL_assert(indexSize == sizeof(uint16_t) || indexSize == sizeof(uint32_t));
+
+	uint32_t* remap = SDL_malloc(sizeof(uint32_t) * numVertices);
+	uint8_t* reordered = SDL_malloc((size_t)vertexStride * numVertices);
+	if (!remap || !reordered)
+	{
+		SDL_free(reordered);
+		SDL_free(remap);
+		return false;
+	}
+
+	// Number vertices in the order the index buffer first touches them
+	SDL_memset(remap, 0xFF, sizeof(uint32_t) * numVertices);
+	uint32_t next = 0;
+	for (unsigned i = 0; i < numIndices; ++i)
+	{
+		const uint32_t v = Mesh_GetIndex(indices, indexSize, i);
+		SDL_assert(v < numVertices);
+		if (remap[v] == UINT32_MAX)
+		{
+			remap[v] = next++;
+		}
+		Mesh_SetIndex(indices, indexSize, i, remap[v]);
+	}
+	// Unreferenced vertices are kept at the end so the vertex count doesn't change
+	for (unsigned v = 0; v < numVertices; ++v)
+	{
+		if (remap[v] == UINT32_MAX)
+		{
+			remap[v] = next++;
+		}
+	}
+
+	const uint8_t* src = vertices;
+	for (unsigned v = 0; v < numVertices; ++v)
+	{
+		SDL_memcpy(reordered + (size_t)remap[v] * vertexStride, src + (size_t)v * vertexStride, vertexStride);
+	}
+	SDL_memcpy(vertices, reordered, (size_t)vertexStride * numVertices);
+
+	SDL_free(reordered);
+	SDL_free(remap);
+	return true;
+}
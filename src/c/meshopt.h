@@ -0,0 +1,28 @@
+#ifndef MESHOPT_H
+#define MESHOPT_H
+
+#include <stdbool.h>
+
+// Post-transform cache size assumed by the optimiser & used for reporting
+#define MESH_VERTEX_CACHE_SIZE 32
+
+typedef struct
+{
+	float acmr;  // Average cache miss ratio, vertex shader invocations per triangle (0.5 is ideal for grids)
+	float atvr;  // Average transformed vertex ratio, vertex shader invocations per unique vertex (1.0 is ideal)
+} MeshCacheStats;
+
+// Indices are either 16 or 32-bit as given by indexSize, vertices are opaque blobs of vertexStride bytes
+
+// Simulate a FIFO post-transform cache over an indexed triangle list
+bool Mesh_AnalyzeVertexCache(MeshCacheStats* restrict stats, const void* restrict indices, unsigned indexSize,
+	unsigned numIndices, unsigned numVertices, unsigned cacheSize);
+
+// Reorder triangles for post-transform cache reuse (Forsyth's linear-speed algorithm)
+bool Mesh_OptimizeVertexCache(void* indices, unsigned indexSize, unsigned numIndices, unsigned numVertices);
+
+// Reorder vertices by first use so fetches walk memory linearly, indices are remapped to match
+bool Mesh_OptimizeVertexFetch(void* restrict vertices, unsigned vertexStride,
+	void* restrict indices, unsigned indexSize, unsigned numIndices, unsigned numVertices);
+
+#endif//MESHOPT_H
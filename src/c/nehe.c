@@ -4,6 +4,7 @@
  */
 
 #include "nehe.h"
+#include <SDL3/SDL_intrin.h>
 
 
 static uint32_t rngState = 1;
@@ -162,6 +163,158 @@ SDL_GPUTexture* NeHe_LoadTexture(NeHeContext* restrict ctx, const char* const re
 	return texture;
 }
 
+static void* BeginTextureUpload(NeHeContext* restrict ctx, const SDL_GPUTextureCreateInfo* restrict createInfo,
+	Uint32 dataSize, SDL_GPUTexture** restrict outTexture, SDL_GPUTransferBuffer** restrict outXferBuffer)
+{
+	SDL_GPUDevice* device = ctx->device;
+
+	SDL_GPUTexture* texture = SDL_CreateGPUTexture(device, createInfo);
+	if (!texture)
+	{
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "SDL_CreateGPUTexture: %s", SDL_GetError());
+		return NULL;
+	}
+
+	// Create a transfer buffer for the caller to write image data into
+	SDL_GPUTransferBuffer* xferBuffer = SDL_CreateGPUTransferBuffer(device, &(const SDL_GPUTransferBufferCreateInfo)
+	{
+		.usage = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD,
+		.size = dataSize
+	});
+	if (!xferBuffer)
+	{
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "SDL_CreateGPUTransferBuffer: %s", SDL_GetError());
+		SDL_ReleaseGPUTexture(device, texture);
+		return NULL;
+	}
+
+	void* map = SDL_MapGPUTransferBuffer(device, xferBuffer, false);
+	if (!map)
+	{
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "SDL_MapGPUTransferBuffer: %s", SDL_GetError());
+		SDL_ReleaseGPUTransferBuffer(device, xferBuffer);
+		SDL_ReleaseGPUTexture(device, texture);
+		return NULL;
+	}
+
+	*outTexture = texture;
+	*outXferBuffer = xferBuffer;
+	return map;
+}
+
+static SDL_GPUTexture* EndTextureUpload(NeHeContext* restrict ctx, const SDL_GPUTextureCreateInfo* restrict createInfo,
+	SDL_GPUTexture* restrict texture, SDL_GPUTransferBuffer* restrict xferBuffer, bool genMipmaps)
+{
+	SDL_GPUDevice* device = ctx->device;
+	SDL_UnmapGPUTransferBuffer(device, xferBuffer);
+
+	// Upload the transfer data to the GPU resources
+	SDL_GPUCommandBuffer* cmd = SDL_AcquireGPUCommandBuffer(device);
+	if (!cmd)
+	{
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "SDL_AcquireGPUCommandBuffer: %s", SDL_GetError());
+		SDL_ReleaseGPUTransferBuffer(device, xferBuffer);
+		SDL_ReleaseGPUTexture(device, texture);
+		return NULL;
+	}
+
+	SDL_GPUCopyPass* pass = SDL_BeginGPUCopyPass(cmd);
+	SDL_UploadToGPUTexture(pass, &(const SDL_GPUTextureTransferInfo)
+	{
+		.transfer_buffer = xferBuffer,
+		.offset = 0
+	}, &(const SDL_GPUTextureRegion)
+	{
+		.texture = texture,
+		.w = createInfo->width,
+		.h = createInfo->height,
+		.d = createInfo->layer_count_or_depth
+	}, false);
+	SDL_EndGPUCopyPass(pass);
+
+	if (genMipmaps)
+	{
+		SDL_GenerateMipmapsForGPUTexture(cmd, texture);
+	}
+
+	SDL_SubmitGPUCommandBuffer(cmd);
+	SDL_ReleaseGPUTransferBuffer(device, xferBuffer);
+	return texture;
+}
+
+#if defined(SDL_SSE4_1_INTRINSICS)
+static int SDL_TARGETING("sse4.1") MergeMaskRowSSE41(Uint8* restrict dst, const Uint8* restrict color,
+	const Uint8* restrict maskRed, int width)
+{
+	// Four pixels at a time, loads read 4 bytes past them so stay clear of the end of the row
+	const __m128i colorShuffle = _mm_setr_epi8(2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1);
+	const __m128i maskShuffle = _mm_setr_epi8(-1, -1, -1, 0, -1, -1, -1, 3, -1, -1, -1, 6, -1, -1, -1, 9);
+	const __m128i invertAlpha = _mm_setr_epi8(0, 0, 0, -1, 0, 0, 0, -1, 0, 0, 0, -1, 0, 0, 0, -1);
+	int x = 0;
+	for (; x + 6 <= width; x += 4)
+	{
+		const __m128i rgb = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)&color[3 * x]), colorShuffle);
+		const __m128i alpha = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)&maskRed[3 * x]), maskShuffle);
+		_mm_storeu_si128((__m128i*)&dst[4 * x], _mm_or_si128(rgb, _mm_xor_si128(alpha, invertAlpha)));
+	}
+	return x;
+}
+#elif defined(SDL_NEON_INTRINSICS)
+static int MergeMaskRowNEON(Uint8* restrict dst, const Uint8* restrict color,
+	const Uint8* restrict maskRed, int width)
+{
+	// Sixteen pixels at a time split into planes, the mask is read up to 2 bytes past them
+	int x = 0;
+	for (; x + 17 <= width; x += 16)
+	{
+		const uint8x16x3_t bgr = vld3q_u8(&color[3 * x]);
+		const uint8x16x3_t mask = vld3q_u8(&maskRed[3 * x]);
+		uint8x16x4_t rgba;
+		rgba.val[0] = bgr.val[2];
+		rgba.val[1] = bgr.val[1];
+		rgba.val[2] = bgr.val[0];
+		rgba.val[3] = vmvnq_u8(mask.val[0]);
+		vst4q_u8(&dst[4 * x], rgba);
+	}
+	return x;
+}
+#endif
+
+// Write a row of RGBA pixels from BGR colour, with the inverse of the mask's red channel as alpha over the first
+// maskWidth pixels and opaque after that
+static void MergeMaskRow(Uint8* restrict dst, const Uint8* restrict color, const Uint8* restrict mask,
+	int maskOffset, int maskStride, int maskWidth, int width, bool simd)
+{
+	int x = 0;
+#if defined(SDL_SSE4_1_INTRINSICS)
+	if (simd)
+	{
+		x = MergeMaskRowSSE41(dst, color, mask + maskOffset, maskWidth);
+	}
+#elif defined(SDL_NEON_INTRINSICS)
+	if (simd)
+	{
+		x = MergeMaskRowNEON(dst, color, mask + maskOffset, maskWidth);
+	}
+#else
+	(void)simd;
+#endif
+	for (; x < maskWidth; ++x)
+	{
+		dst[4 * x + 0] = color[3 * x + 2];
+		dst[4 * x + 1] = color[3 * x + 1];
+		dst[4 * x + 2] = color[3 * x];
+		dst[4 * x + 3] = mask[maskStride * x + maskOffset] ^ 0xFF;
+	}
+	for (; x < width; ++x)
+	{
+		dst[4 * x + 0] = color[3 * x + 2];
+		dst[4 * x + 1] = color[3 * x + 1];
+		dst[4 * x + 2] = color[3 * x];
+		dst[4 * x + 3] = 0xFF;
+	}
+}
+
 SDL_GPUTexture* NeHe_LoadTextureSeparateMask(NeHeContext* restrict ctx,
 	const char* const restrict colorResourcePath, const char* const restrict maskResourcePath,
 	bool flipVertical)
@@ -223,57 +376,91 @@ SDL_GPUTexture* NeHe_LoadTextureSeparateMask(NeHeContext* restrict ctx,
 		maskValueStride = 3;
 	}
 
-	// Create image from colour layer w/ alpha channel
-	SDL_Surface* image = SDL_ConvertSurface(color, SDL_PIXELFORMAT_BGRA8888);
-	SDL_DestroySurface(color);
-	if (!image)
+	// The colour layer is read as BGR bytes, anything else is converted to RGBA that only needs its alpha replaced
+	const bool colorBGR = color->format == SDL_PIXELFORMAT_BGR24;
+	if (!colorBGR)
 	{
-		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "SDL_ConvertSurface: %s", SDL_GetError());
-		SDL_DestroySurface(mask);
-		return NULL;
+		SDL_Surface* newColor = SDL_ConvertSurface(color, SDL_PIXELFORMAT_RGBA32);
+		SDL_DestroySurface(color);
+		if (!newColor)
+		{
+			SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "SDL_ConvertSurface: %s", SDL_GetError());
+			SDL_DestroySurface(mask);
+			return NULL;
+		}
+		color = newColor;
 	}
 
-	// Place an inverted copy of the mask's red channel in the image's alpha channel
-	if (!SDL_LockSurface(image) || !SDL_LockSurface(mask))
+	if (!SDL_LockSurface(color) || !SDL_LockSurface(mask))
 	{
 		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "SDL_LockSurface: %s", SDL_GetError());
-		SDL_DestroySurface(image);
+		SDL_DestroySurface(color);
 		SDL_DestroySurface(mask);
+		return NULL;
 	}
-	Uint8* src = (Uint8*)mask->pixels;
-	Uint8* dst = (Uint8*)image->pixels;
-	const int width = SDL_min(image->w, mask->w);
-	for (int height = SDL_min(image->h, mask->h); height; height--)
-	{
-		for (int x = 0; x < width; ++x)
-		{
-			dst[4 * x] = src[maskValueStride * x + maskValueOffset] ^ 0xFF;
-		}
-		src += mask->pitch;
-		dst += image->pitch;
-	}
-	SDL_UnlockSurface(mask);
-	SDL_UnlockSurface(image);
-
-	SDL_DestroySurface(mask);  // We can now free the mask
 
-	// Flip surface if requested
-	if (flipVertical && !SDL_FlipSurface(image, SDL_FLIP_VERTICAL))
+	// Merge straight into the upload buffer
+	const SDL_GPUTextureCreateInfo info =
 	{
-		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "SDL_FlipSurface: %s", SDL_GetError());
-		SDL_DestroySurface(image);
+		.type = SDL_GPU_TEXTURETYPE_2D,
+		.format = SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM,
+		.usage = SDL_GPU_TEXTUREUSAGE_SAMPLER,
+		.width = (Uint32)color->w,
+		.height = (Uint32)color->h,
+		.layer_count_or_depth = 1,
+		.num_levels = 1
+	};
+	const size_t dstPitch = 4 * (size_t)color->w;
+	SDL_assert(dstPitch * (size_t)color->h <= UINT32_MAX);
+	SDL_GPUTexture* texture;
+	SDL_GPUTransferBuffer* xferBuffer;
+	Uint8* map = BeginTextureUpload(ctx, &info, (Uint32)(dstPitch * (size_t)color->h), &texture, &xferBuffer);
+	if (!map)
+	{
+		SDL_UnlockSurface(mask);
+		SDL_UnlockSurface(color);
+		SDL_DestroySurface(mask);
+		SDL_DestroySurface(color);
 		return NULL;
 	}
 
-	// Upload texture to GPU
-	SDL_GPUTexture* texture = NeHe_CreateGPUTextureFromSurface(ctx, image, false);
-	SDL_DestroySurface(image);
-	if (!texture)
-	{
-		return NULL;
+#if defined(SDL_SSE4_1_INTRINSICS)
+	const bool simd = maskValueStride == 3 && SDL_HasSSE41();
+#elif defined(SDL_NEON_INTRINSICS)
+	const bool simd = maskValueStride == 3;
+#else
+	const bool simd = false;
+#endif
+
+	// Place an inverted copy of the mask's red channel in the alpha channel, flipping rows as they're written
+	const int maskWidth = SDL_min(color->w, mask->w);
+	const int maskHeight = SDL_min(color->h, mask->h);
+	for (int y = 0; y < color->h; ++y)
+	{
+		Uint8* dst = map + dstPitch * (size_t)(flipVertical ? color->h - 1 - y : y);
+		const Uint8* src = (const Uint8*)color->pixels + (size_t)color->pitch * (size_t)y;
+		const Uint8* srcMask = (const Uint8*)mask->pixels + (size_t)mask->pitch * (size_t)SDL_min(y, mask->h - 1);
+		const int rowMaskWidth = y < maskHeight ? maskWidth : 0;
+		if (colorBGR)
+		{
+			MergeMaskRow(dst, src, srcMask, maskValueOffset, maskValueStride, rowMaskWidth, color->w, simd);
+		}
+		else
+		{
+			SDL_memcpy(dst, src, dstPitch);
+			for (int x = 0; x < rowMaskWidth; ++x)
+			{
+				dst[4 * x + 3] = srcMask[maskValueStride * x + maskValueOffset] ^ 0xFF;
+			}
+		}
 	}
 
-	return texture;
+	SDL_UnlockSurface(mask);
+	SDL_UnlockSurface(color);
+	SDL_DestroySurface(mask);
+	SDL_DestroySurface(color);
+
+	return EndTextureUpload(ctx, &info, texture, xferBuffer, false);
 }
 
 SDL_GPUTexture* NeHe_CreateGPUTextureFromPixels(NeHeContext* restrict ctx, const void* restrict data,
@@ -281,71 +468,18 @@ SDL_GPUTexture* NeHe_CreateGPUTextureFromPixels(NeHeContext* restrict ctx, const
 {
 	SDL_assert(data && dataSize);
 	SDL_assert(dataSize <= UINT32_MAX);
-	SDL_GPUDevice* device = ctx->device;
-
-	SDL_GPUTexture* texture = SDL_CreateGPUTexture(device, createInfo);
-	if (!texture)
-	{
-		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "SDL_CreateGPUTexture: %s", SDL_GetError());
-		return NULL;
-	}
 
 	// Create and copy image data to a transfer buffer
-	SDL_GPUTransferBuffer* xferBuffer = SDL_CreateGPUTransferBuffer(device, &(const SDL_GPUTransferBufferCreateInfo)
-	{
-		.usage = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD,
-		.size = (Uint32)dataSize
-	});
-	if (!xferBuffer)
-	{
-		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "SDL_CreateGPUTransferBuffer: %s", SDL_GetError());
-		SDL_ReleaseGPUTexture(device, texture);
-		return NULL;
-	}
-
-	void* map = SDL_MapGPUTransferBuffer(device, xferBuffer, false);
+	SDL_GPUTexture* texture;
+	SDL_GPUTransferBuffer* xferBuffer;
+	void* map = BeginTextureUpload(ctx, createInfo, (Uint32)dataSize, &texture, &xferBuffer);
 	if (!map)
 	{
-		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "SDL_MapGPUTransferBuffer: %s", SDL_GetError());
-		SDL_ReleaseGPUTransferBuffer(device, xferBuffer);
-		SDL_ReleaseGPUTexture(device, texture);
 		return NULL;
 	}
 	SDL_memcpy(map, data, dataSize);
-	SDL_UnmapGPUTransferBuffer(device, xferBuffer);
-
-	// Upload the transfer data to the GPU resources
-	SDL_GPUCommandBuffer* cmd = SDL_AcquireGPUCommandBuffer(device);
-	if (!cmd)
-	{
-		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "SDL_AcquireGPUCommandBuffer: %s", SDL_GetError());
-		SDL_ReleaseGPUTransferBuffer(device, xferBuffer);
-		SDL_ReleaseGPUTexture(device, texture);
-		return NULL;
-	}
 
-	SDL_GPUCopyPass* pass = SDL_BeginGPUCopyPass(cmd);
-	SDL_UploadToGPUTexture(pass, &(const SDL_GPUTextureTransferInfo)
-	{
-		.transfer_buffer = xferBuffer,
-		.offset = 0
-	}, &(const SDL_GPUTextureRegion)
-	{
-		.texture = texture,
-		.w = createInfo->width,
-		.h = createInfo->height,
-		.d = createInfo->layer_count_or_depth
-	}, false);
-	SDL_EndGPUCopyPass(pass);
-
-	if (genMipmaps)
-	{
-		SDL_GenerateMipmapsForGPUTexture(cmd, texture);
-	}
-
-	SDL_SubmitGPUCommandBuffer(cmd);
-	SDL_ReleaseGPUTransferBuffer(device, xferBuffer);
-	return texture;
+	return EndTextureUpload(ctx, createInfo, texture, xferBuffer, genMipmaps);
 }
 
 SDL_GPUTexture* NeHe_CreateGPUTextureFromSurface(NeHeContext* restrict ctx, const SDL_Surface* restrict surface,
@@ -7,72 +7,271 @@
 
 #include <SDL3/SDL_stdinc.h>
 #include <SDL3/SDL_assert.h>
+#include <SDL3/SDL_error.h>
 
-// Matches max segments allowed by GLU
+// Matches max segments allowed by GLU, finer meshes spill their caches onto the heap
 #define CACHE_SIZE 240
 
 static const float tau = 2.0f * SDL_PI_F;
 static const float deg2rad = SDL_PI_F / 180.f;
 
 
-static void Quad_ComputeStorageRequirementsCylindricalQuads(Quadric* restrict q, int numSlices, int numStacks)
+typedef struct
 {
-	const unsigned numVertices = ((unsigned)numStacks + 1) * ((unsigned)numSlices + 1);
-	const unsigned numIndices = 6 * (unsigned)numStacks * (unsigned)numSlices;
+	float* sin, * cos;
+	float* heap;
+	float stack[2 * CACHE_SIZE];
+} QuadTrigCache;
 
-	SDL_assert(numVertices <= q->vertexCapacity);
-	SDL_assert(numIndices <= q->indexCapacity);
+static bool Quad_InitTrigCache(QuadTrigCache* cache, int size)
+{
+	float* storage = cache->stack;
+	cache->heap = NULL;
+	if (size > CACHE_SIZE && (storage = cache->heap = SDL_malloc(sizeof(float) * 2 * (size_t)size)) == NULL)
+	{
+		return false;
+	}
+	cache->sin = storage;
+	cache->cos = storage + size;
+	return true;
+}
+
+static void Quad_FreeTrigCache(QuadTrigCache* cache)
+{
+	SDL_free(cache->heap);
+}
+
+static inline void Quad_SetIndex(Quadric* restrict q, unsigned idx, unsigned vtx)
+{
+	if (q->indexType == QUAD_INDEX_32)
+	{
+		((QuadIndex32*)q->indexData)[idx] = (QuadIndex32)vtx;
+	}
+	else
+	{
+		((QuadIndex*)q->indexData)[idx] = (QuadIndex)vtx;
+	}
+}
+
+static inline unsigned Quad_EmitQuad(Quadric* restrict q, unsigned curIdx,
+	unsigned a, unsigned b, unsigned c, unsigned d)
+{
+	Quad_SetIndex(q, curIdx++, a);
+	Quad_SetIndex(q, curIdx++, b);
+	Quad_SetIndex(q, curIdx++, c);
+
+	Quad_SetIndex(q, curIdx++, c);
+	Quad_SetIndex(q, curIdx++, d);
+	Quad_SetIndex(q, curIdx++, a);
+	return curIdx;
+}
+
+
+static QuadricSize Quad_CylindricalQuadsSize(int numSlices, int numStacks)
+{
+	return (QuadricSize)
+	{
+		.numVertices = ((unsigned)numStacks + 1) * ((unsigned)numSlices + 1),
+		.numIndices = 6 * (unsigned)numStacks * (unsigned)numSlices
+	};
+}
+
+QuadricSize Quad_CylinderSize(int numSlices, int numStacks)
+{
+	return Quad_CylindricalQuadsSize(numSlices, numStacks);
+}
+
+static void Quad_ClampSweep(float* restrict startAngle, float* restrict sweepAngle)
+{
+	if (*sweepAngle < -360.f || *sweepAngle > 360.f) { *sweepAngle = 360.f; }
+	else if (*sweepAngle < 0.f)
+	{
+		*startAngle += *sweepAngle;
+		*sweepAngle = -*sweepAngle;
+	}
+}
+
+QuadricSize Quad_DiscPartialSize(float innerRadius, int numSlices, int numLoops, float sweepAngle)
+{
+	float startAngle = 0.0f;
+	Quad_ClampSweep(&startAngle, &sweepAngle);
+
+	const unsigned vertexSlices = (unsigned)numSlices + (sweepAngle == 360.0f ? 0 : 1);
+	if (innerRadius > 0.0f)
+	{
+		return (QuadricSize)
+		{
+			.numVertices = ((unsigned)numLoops + 1) * vertexSlices,
+			.numIndices = 6 * (unsigned)numLoops * (unsigned)numSlices
+		};
+	}
+	return (QuadricSize)
+	{
+		.numVertices = 1 + (unsigned)numLoops * vertexSlices,
+		.numIndices = 3 * (unsigned)numSlices + 6 * (unsigned)(numLoops - 1) * (unsigned)numSlices
+	};
+}
+
+extern inline QuadricSize Quad_DiscSize(float innerRadius, int numSlices, int numLoops);
+
+QuadricSize Quad_SphereSize(int numSlices, int numStacks)
+{
+	return Quad_CylindricalQuadsSize(numSlices, numStacks);
+}
+
+extern inline QuadIndexType Quad_IndexTypeForSize(QuadricSize size);
+extern inline unsigned Quad_IndexSize(QuadIndexType type);
+
+
+static uint16_t Quad_FloatToHalf(float f)
+{
+	union { float f; uint32_t u; } bits = { f };
+	const uint16_t sign = (uint16_t)((bits.u >> 16) & 0x8000);
+	const uint32_t abs = bits.u & 0x7FFFFFFF;
 
-	q->numVertices = numVertices;
-	q->numIndices  = numIndices;
+	// Too big for half, becomes infinity (or stays NaN)
+	if (abs >= 0x47800000)
+	{
+		return sign | (abs > 0x7F800000 ? 0x7E00 : 0x7C00);
+	}
+	// Subnormal or zero, let the FPU round by adding a magic number that shifts the mantissa into place
+	if (abs < 0x38800000)
+	{
+		union { uint32_t u; float f; } magic = { abs };
+		magic.f += 0.5f;
+		return sign | (uint16_t)(magic.u - 0x3F000000);
+	}
+	// Normal, rebias exponent & round to nearest even
+	const uint32_t rounded = abs + 0xC8000FFF + ((abs >> 13) & 1);
+	return sign | (uint16_t)(rounded >> 13);
+}
+
+static inline int16_t Quad_FloatToSnorm16(float f)
+{
+	return (int16_t)SDL_roundf(SDL_clamp(f, -1.0f, 1.0f) * 32767.0f);
+}
+
+static inline uint16_t Quad_FloatToUnorm16(float f)
+{
+	return (uint16_t)SDL_roundf(SDL_clamp(f, 0.0f, 1.0f) * 65535.0f);
+}
+
+void Quad_PackVertices(QuadVertexPacked* restrict out, const QuadVertexNormalTexture* restrict in, unsigned count)
+{
+	const uint16_t one = Quad_FloatToHalf(1.0f);
+	for (unsigned i = 0; i < count; ++i)
+	{
+		// Project normal onto the octahedron, then fold the lower half over the upper
+		const float l1 = SDL_fabsf(in[i].nx) + SDL_fabsf(in[i].ny) + SDL_fabsf(in[i].nz);
+		float octX = l1 > 0.0f ? in[i].nx / l1 : 0.0f;
+		float octY = l1 > 0.0f ? in[i].ny / l1 : 0.0f;
+		if (in[i].nz < 0.0f)
+		{
+			const float foldX = (1.0f - SDL_fabsf(octY)) * (octX >= 0.0f ? 1.0f : -1.0f);
+			const float foldY = (1.0f - SDL_fabsf(octX)) * (octY >= 0.0f ? 1.0f : -1.0f);
+			octX = foldX;
+			octY = foldY;
+		}
+
+		out[i] = (QuadVertexPacked)
+		{
+			.x = Quad_FloatToHalf(in[i].x),
+			.y = Quad_FloatToHalf(in[i].y),
+			.z = Quad_FloatToHalf(in[i].z),
+			.w = one,
+			.nx = Quad_FloatToSnorm16(octX),
+			.ny = Quad_FloatToSnorm16(octY),
+			.u = Quad_FloatToUnorm16(in[i].u),
+			.v = Quad_FloatToUnorm16(in[i].v)
+		};
+	}
+}
+
+
+bool Quad_Alloc(Quadric* q, QuadricSize size)
+{
+	const QuadIndexType indexType = Quad_IndexTypeForSize(size);
+	void* vertexData = SDL_malloc(sizeof(QuadVertexNormalTexture) * size.numVertices);
+	void* indexData = SDL_malloc((size_t)Quad_IndexSize(indexType) * size.numIndices);
+	if (!vertexData || !indexData)
+	{
+		SDL_free(indexData);
+		SDL_free(vertexData);
+		SDL_zerop(q);
+		return false;
+	}
+
+	*q = (Quadric)
+	{
+		.vertexData = vertexData,
+		.indexData = indexData,
+		.indexType = indexType,
+		.vertexCapacity = size.numVertices,
+		.indexCapacity = size.numIndices
+	};
+	return true;
 }
 
-static unsigned Quad_GenerateIndicesGenericQuadrilateral(QuadIndex vtxOffset,
-	QuadIndex* restrict indices, int numSlices, int numStacks, bool flip, bool contiguousSlice)
+void Quad_Free(Quadric* q)
+{
+	SDL_free(q->indexData);
+	SDL_free(q->vertexData);
+	SDL_zerop(q);
+}
+
+static bool Quad_Reserve(Quadric* restrict q, QuadricSize size)
+{
+	if (size.numVertices > q->vertexCapacity || size.numIndices > q->indexCapacity)
+	{
+		return SDL_SetError("Quadric needs storage for %u vertices & %u indices, has %u & %u",
+			size.numVertices, size.numIndices, q->vertexCapacity, q->indexCapacity);
+	}
+	if (q->indexType == QUAD_INDEX_16 && size.numVertices > UINT16_MAX + 1u)
+	{
+		return SDL_SetError("Quadric with %u vertices can't use 16-bit indices", size.numVertices);
+	}
+
+	q->numVertices = size.numVertices;
+	q->numIndices  = size.numIndices;
+	return true;
+}
+
+static unsigned Quad_GenerateIndicesGenericQuadrilateral(Quadric* restrict q, unsigned idxOffset, unsigned vtxOffset,
+	int numSlices, int numStacks, bool flip, bool contiguousSlice)
 {
 	if (contiguousSlice)
 		--numSlices;
-	const QuadIndex stackStride = (QuadIndex)numSlices + 1;
-	QuadIndex stack0 = vtxOffset, stack1 = vtxOffset;
+	const unsigned stackStride = (unsigned)numSlices + 1;
+	unsigned stack0 = vtxOffset, stack1 = vtxOffset;
 	if (flip)
 		stack1 += stackStride;
 	else
 		stack0 += stackStride;
 
-	unsigned curIdx = 0;
+	unsigned curIdx = idxOffset;
 	for (int stack = 0; stack < numStacks; ++stack)
 	{
-		for (int slice = 0; slice < numSlices; ++slice)
+		for (unsigned slice = 0; slice < (unsigned)numSlices; ++slice)
 		{
-			indices[curIdx++] = stack0 + (QuadIndex)slice;
-			indices[curIdx++] = stack1 + (QuadIndex)slice;
-			indices[curIdx++] = stack1 + (QuadIndex)slice + 1;
-
-			indices[curIdx++] = stack1 + (QuadIndex)slice + 1;
-			indices[curIdx++] = stack0 + (QuadIndex)slice + 1;
-			indices[curIdx++] = stack0 + (QuadIndex)slice;
+			curIdx = Quad_EmitQuad(q, curIdx,
+				stack0 + slice, stack1 + slice,
+				stack1 + slice + 1, stack0 + slice + 1);
 		}
 		if (contiguousSlice)
 		{
-			indices[curIdx++] = stack0 + (QuadIndex)numSlices;
-			indices[curIdx++] = stack1 + (QuadIndex)numSlices;
-			indices[curIdx++] = stack1;
-
-			indices[curIdx++] = stack1;
-			indices[curIdx++] = stack0;
-			indices[curIdx++] = stack0 + (QuadIndex)numSlices;
+			curIdx = Quad_EmitQuad(q, curIdx,
+				stack0 + (unsigned)numSlices, stack1 + (unsigned)numSlices,
+				stack1, stack0);
 		}
 		stack0 += stackStride;
 		stack1 += stackStride;
 	}
 
-	return curIdx;
+	return curIdx - idxOffset;
 }
 
-void Quad_Cylinder(Quadric* q, float baseRadius, float topRadius, float height, int numSlices, int numStacks)
+bool Quad_Cylinder(Quadric* q, float baseRadius, float topRadius, float height, int numSlices, int numStacks)
 {
-	float sinCache[CACHE_SIZE], cosCache[CACHE_SIZE];
-
 	// Sanity check inputs
 	SDL_assert(numSlices >= 2);
 	SDL_assert(numStacks >= 1);
@@ -80,11 +279,17 @@ void Quad_Cylinder(Quadric* q, float baseRadius, float topRadius, float height,
 	SDL_assert(topRadius >= 0.0f);
 	SDL_assert(height >= 0.0f);
 
-	// Clamp slices to cache size
-	numSlices = SDL_min(numSlices, CACHE_SIZE - 1);
-
 	// Calculate required storage for mesh
-	Quad_ComputeStorageRequirementsCylindricalQuads(q, numSlices, numStacks);
+	if (!Quad_Reserve(q, Quad_CylinderSize(numSlices, numStacks)))
+	{
+		return false;
+	}
+
+	QuadTrigCache cache;
+	if (!Quad_InitTrigCache(&cache, numSlices + 1))
+	{
+		return false;
+	}
 
 	const float deltaRadius = baseRadius - topRadius;
 	const float len = SDL_sqrtf(deltaRadius * deltaRadius + height * height);
@@ -93,13 +298,13 @@ void Quad_Cylinder(Quadric* q, float baseRadius, float topRadius, float height,
 	const float stackStep = 1.0f / (float)numStacks;
 
 	// Pre-compute cylinder vectors
-	sinCache[0] = sinCache[numSlices] = 0.0f;
-	cosCache[0] = cosCache[numSlices] = 1.0f;
+	cache.sin[0] = cache.sin[numSlices] = 0.0f;
+	cache.cos[0] = cache.cos[numSlices] = 1.0f;
 	for (int slice = 1; slice < numSlices; ++slice)
 	{
 		const float theta = tau * sliceStep * (float)slice;
-		sinCache[slice] = SDL_sinf(theta);
-		cosCache[slice] = SDL_cosf(theta);
+		cache.sin[slice] = SDL_sinf(theta);
+		cache.cos[slice] = SDL_cosf(theta);
 	}
 
 	// Compute normal direction for cones
@@ -108,7 +313,7 @@ void Quad_Cylinder(Quadric* q, float baseRadius, float topRadius, float height,
 	const float sliceNormalScale = height * invLen;
 
 	// Generate vertices
-	QuadIndex curVtx = 0;
+	unsigned curVtx = 0;
 	QuadVertexNormalTexture* vertices = (QuadVertexNormalTexture*)q->vertexData;
 	for (int stack = 0; stack <= numStacks; ++stack)
 	{
@@ -117,8 +322,8 @@ void Quad_Cylinder(Quadric* q, float baseRadius, float topRadius, float height,
 
 		for (int slice = 0; slice <= numSlices; ++slice)
 		{
-			const float sinSlice = sinCache[slice];
-			const float cosSlice = cosCache[slice];
+			const float sinSlice = cache.sin[slice];
+			const float cosSlice = cache.cos[slice];
 
 			vertices[curVtx++] = (QuadVertexNormalTexture)
 			{
@@ -133,57 +338,44 @@ void Quad_Cylinder(Quadric* q, float baseRadius, float topRadius, float height,
 			};
 		}
 	}
-	SDL_assert(q->numVertices == (unsigned)curVtx);
+	SDL_assert(q->numVertices == curVtx);
+	Quad_FreeTrigCache(&cache);
 
 	// Generate indices
-	const unsigned curIdx = Quad_GenerateIndicesGenericQuadrilateral(0, q->indices, numSlices, numStacks, true, false);
+	const unsigned curIdx = Quad_GenerateIndicesGenericQuadrilateral(q, 0, 0, numSlices, numStacks, true, false);
 	SDL_assert(q->numIndices == curIdx);
+	return true;
 }
 
-void Quad_DiscPartial(Quadric* q, float innerRadius, float outerRadius, int numSlices, int numLoops,
+bool Quad_DiscPartial(Quadric* q, float innerRadius, float outerRadius, int numSlices, int numLoops,
 	float startAngle, float sweepAngle)
 {
-	float sinCache[CACHE_SIZE], cosCache[CACHE_SIZE];
-
 	// Sanity check inputs
 	SDL_assert(numSlices >= 2);
 	SDL_assert(numLoops >= 1);
 	SDL_assert(outerRadius > 0.0f);
 	SDL_assert(innerRadius >= 0.0f);
 
-	// Clamp slices to cache size
-	numSlices = SDL_min(numSlices, CACHE_SIZE - 1);
-
-	// Clamp angles
-	if (sweepAngle < -360.f || sweepAngle > 360.f) { sweepAngle = 360.f; }
-	else if (sweepAngle < 0.f)
+	// Calculate required storage for mesh
+	if (!Quad_Reserve(q, Quad_DiscPartialSize(innerRadius, numSlices, numLoops, sweepAngle)))
 	{
-		startAngle += sweepAngle;
-		sweepAngle = -sweepAngle;
+		return false;
 	}
 
+	// Clamp angles
+	Quad_ClampSweep(&startAngle, &sweepAngle);
+
 	// Does our disc have a hole? Else we are drawing a filled disc
 	const bool hasHole      = innerRadius > 0.0f;
 	const bool isContiguous = sweepAngle == 360.0f;
 
 	const int vertexSlices = isContiguous ? numSlices : numSlices + 1;
 
-	// Calculate required storage for mesh
-	unsigned numVertices, numIndices;
-	if (hasHole)
+	QuadTrigCache cache;
+	if (!Quad_InitTrigCache(&cache, numSlices + 1))
 	{
-		numVertices = ((unsigned)numLoops + 1) * (unsigned)vertexSlices;
-		numIndices = 6 * (unsigned)numLoops * (unsigned)numSlices;
+		return false;
 	}
-	else
-	{
-		numVertices = 1 + (unsigned)numLoops * (unsigned)vertexSlices;
-		numIndices = 3 * (unsigned)numSlices + 6 * (unsigned)(numLoops - 1) * (unsigned)numSlices;
-	}
-	SDL_assert(numVertices <= q->vertexCapacity);
-	SDL_assert(numIndices <= q->indexCapacity);
-	q->numVertices = numVertices;
-	q->numIndices  = numIndices;
 
 	const float sliceStep = 1.0f / (float)numSlices;
 	const float loopStep = 1.0f / (float)numLoops;
@@ -195,17 +387,17 @@ void Quad_DiscPartial(Quadric* q, float innerRadius, float outerRadius, int numS
 	for (int slice = 0; slice < vertexSlices; ++slice)
 	{
 		const float theta = angleOffset + deg2rad * sweepAngle * sliceStep * (float)slice;
-		sinCache[slice] = SDL_sinf(theta);
-		cosCache[slice] = SDL_cosf(theta);
+		cache.sin[slice] = SDL_sinf(theta);
+		cache.cos[slice] = SDL_cosf(theta);
 	}
 	if (isContiguous)
 	{
-		sinCache[numSlices] = sinCache[0];
-		cosCache[numSlices] = cosCache[0];
+		cache.sin[numSlices] = cache.sin[0];
+		cache.cos[numSlices] = cache.cos[0];
 	}
 
 	// Generate vertices
-	QuadIndex curVtx = 0;
+	unsigned curVtx = 0;
 	QuadVertexNormalTexture* vertices = (QuadVertexNormalTexture*)q->vertexData;
 	if (!hasHole)
 	{
@@ -224,8 +416,8 @@ void Quad_DiscPartial(Quadric* q, float innerRadius, float outerRadius, int numS
 		const float texScale = radius / outerRadius * 0.5f;
 		for (int slice = 0; slice < vertexSlices; ++slice)
 		{
-			const float sinSlice = sinCache[slice];
-			const float cosSlice = cosCache[slice];
+			const float sinSlice = cache.sin[slice];
+			const float cosSlice = cache.cos[slice];
 			vertices[curVtx++] = (QuadVertexNormalTexture)
 			{
 				.x = radius * sinSlice,
@@ -237,87 +429,168 @@ void Quad_DiscPartial(Quadric* q, float innerRadius, float outerRadius, int numS
 			};
 		}
 	}
-	SDL_assert(numVertices == (unsigned)curVtx);
+	SDL_assert(q->numVertices == curVtx);
+	Quad_FreeTrigCache(&cache);
 
 	// Generate indices
 	unsigned curIdx = 0;
 	if (!hasHole)
 	{
 		// Draw innermost loop as triangles
-		const QuadIndex loopStart = curVtx - (QuadIndex)(numVertices - 1);
+		const unsigned loopStart = curVtx - (unsigned)vertexSlices;
 		for (int slice = vertexSlices - 2; slice >= 0; --slice)
 		{
-			q->indices[curIdx++] = 0;
-			q->indices[curIdx++] = loopStart + (QuadIndex)slice + 1;
-			q->indices[curIdx++] = loopStart + (QuadIndex)slice;
+			Quad_SetIndex(q, curIdx++, 0);
+			Quad_SetIndex(q, curIdx++, loopStart + (unsigned)slice + 1);
+			Quad_SetIndex(q, curIdx++, loopStart + (unsigned)slice);
 		}
 		if (isContiguous)
 		{
-			q->indices[curIdx++] = 0;
-			q->indices[curIdx++] = loopStart;
-			q->indices[curIdx++] = loopStart + (QuadIndex)numSlices - 1;
+			Quad_SetIndex(q, curIdx++, 0);
+			Quad_SetIndex(q, curIdx++, loopStart);
+			Quad_SetIndex(q, curIdx++, loopStart + (unsigned)numSlices - 1);
 		}
 	}
-	const QuadIndex vtxBeg = hasHole ? 0 : 1;  // Offset by centre vertex when drawing filled discs
-	curIdx += Quad_GenerateIndicesGenericQuadrilateral(vtxBeg, &q->indices[curIdx],
-		numSlices, numLoops, true, isContiguous);
-	SDL_assert(numIndices == curIdx);
+	const unsigned vtxBeg = hasHole ? 0 : 1;  // Offset by centre vertex when drawing filled discs
+	curIdx += Quad_GenerateIndicesGenericQuadrilateral(q, curIdx, vtxBeg, numSlices, numLoops, true, isContiguous);
+	SDL_assert(q->numIndices == curIdx);
+	return true;
 }
 
-extern inline void Quad_Disc(Quadric* q, float innerRadius, float outerRadius, int numSlices, int numLoops);
+extern inline bool Quad_Disc(Quadric* q, float innerRadius, float outerRadius, int numSlices, int numLoops);
+
+static unsigned Quad_DiscIndicesPerSlice(float innerRadius, int numLoops)
+{
+	return innerRadius > 0.0f ? 6 * (unsigned)numLoops : 3 + 6 * (unsigned)(numLoops - 1);
+}
+
+QuadricSize Quad_DiscSweepableSize(float innerRadius, int numSlices, int numLoops)
+{
+	return (QuadricSize)
+	{
+		.numVertices = Quad_DiscSize(innerRadius, numSlices, numLoops).numVertices,
+		.numIndices = 2 * (unsigned)numSlices * Quad_DiscIndicesPerSlice(innerRadius, numLoops)
+	};
+}
+
+bool Quad_DiscSweepable(Quadric* q, float innerRadius, float outerRadius, int numSlices, int numLoops)
+{
+	const QuadricSize size = Quad_DiscSweepableSize(innerRadius, numSlices, numLoops);
+	if (!Quad_Reserve(q, size))
+	{
+		return false;
+	}
+
+	// Every sweep shares the vertices of the full disc
+	if (!Quad_Disc(q, innerRadius, outerRadius, numSlices, numLoops))
+	{
+		return false;
+	}
+	q->numIndices = size.numIndices;
+
+	// Re-emit indices one whole slice at a time over two turns, so any sweep is a single contiguous range
+	const bool hasHole = innerRadius > 0.0f;
+	const unsigned slices = (unsigned)numSlices;
+	const unsigned quadLoops = hasHole ? (unsigned)numLoops : (unsigned)numLoops - 1;
+	const unsigned vtxBeg = hasHole ? 0 : 1;
+	unsigned curIdx = 0;
+	for (unsigned slice = 0; slice < 2 * slices; ++slice)
+	{
+		const unsigned s0 = slice % slices, s1 = (slice + 1) % slices;
+		for (unsigned loop = 0; loop < quadLoops; ++loop)
+		{
+			const unsigned outer = vtxBeg + loop * slices, inner = outer + slices;
+			curIdx = Quad_EmitQuad(q, curIdx, outer + s0, inner + s0, inner + s1, outer + s1);
+		}
+		if (!hasHole)
+		{
+			const unsigned innermost = vtxBeg + quadLoops * slices;
+			Quad_SetIndex(q, curIdx++, 0);
+			Quad_SetIndex(q, curIdx++, innermost + s1);
+			Quad_SetIndex(q, curIdx++, innermost + s0);
+		}
+	}
+	SDL_assert(q->numIndices == curIdx);
+	return true;
+}
 
-void Quad_Sphere(Quadric* q, float radius, int numSlices, int numStacks)
+QuadricRange Quad_DiscSweepRange(float innerRadius, int numSlices, int numLoops, float startAngle, float sweepAngle)
 {
-	float sinStackCache[CACHE_SIZE], cosStackCache[CACHE_SIZE];
-	float sinSliceCache[CACHE_SIZE], cosSliceCache[CACHE_SIZE];
+	Quad_ClampSweep(&startAngle, &sweepAngle);
+
+	// Snap to whole slices, starting within the first turn
+	const float slicesPerDegree = (float)numSlices / 360.0f;
+	startAngle = SDL_fmodf(startAngle, 360.0f);
+	if (startAngle < 0.0f)
+	{
+		startAngle += 360.0f;
+	}
+	const unsigned firstSlice = (unsigned)(startAngle * slicesPerDegree) % (unsigned)numSlices;
+	const unsigned numSweep = SDL_min((unsigned)SDL_roundf(sweepAngle * slicesPerDegree), (unsigned)numSlices);
 
+	const unsigned perSlice = Quad_DiscIndicesPerSlice(innerRadius, numLoops);
+	return (QuadricRange){ .firstIndex = firstSlice * perSlice, .numIndices = numSweep * perSlice };
+}
+
+bool Quad_Sphere(Quadric* q, float radius, int numSlices, int numStacks)
+{
 	// Sanity check inputs
 	SDL_assert(numSlices >= 2);
 	SDL_assert(numStacks >= 1);
 	SDL_assert(radius >= 0.0f);
 
-	// Clamp slices & stacks to cache size
-	numSlices = SDL_min(numSlices, CACHE_SIZE - 1);
-	numStacks = SDL_min(numSlices, CACHE_SIZE - 1);
-
 	// Calculate required storage for mesh
-	Quad_ComputeStorageRequirementsCylindricalQuads(q, numSlices, numStacks);
+	if (!Quad_Reserve(q, Quad_SphereSize(numSlices, numStacks)))
+	{
+		return false;
+	}
+
+	QuadTrigCache stackCache, sliceCache;
+	if (!Quad_InitTrigCache(&stackCache, numStacks + 1))
+	{
+		return false;
+	}
+	if (!Quad_InitTrigCache(&sliceCache, numSlices + 1))
+	{
+		Quad_FreeTrigCache(&stackCache);
+		return false;
+	}
 
 	const float stackStep = 1.0f / (float)numStacks;
 	const float sliceStep = 1.0f / (float)numSlices;
 
 	// Pre-compute stack vectors
-	sinStackCache[0] = sinStackCache[numSlices] = 0.0f;
-	cosStackCache[0] = 1.0f;
-	cosStackCache[numSlices] = -1.0f;
+	stackCache.sin[0] = stackCache.sin[numStacks] = 0.0f;
+	stackCache.cos[0] = 1.0f;
+	stackCache.cos[numStacks] = -1.0f;
 	for (int stack = 1; stack < numStacks; ++stack)
 	{
 		const float theta = SDL_PI_F * stackStep * (float)stack;
-		sinStackCache[stack] = SDL_sinf(theta);
-		cosStackCache[stack] = SDL_cosf(theta);
+		stackCache.sin[stack] = SDL_sinf(theta);
+		stackCache.cos[stack] = SDL_cosf(theta);
 	}
 
 	// Pre-compute slice vectors
-	sinSliceCache[0] = sinSliceCache[numSlices] = 0.0f;
-	cosSliceCache[0] = cosSliceCache[numSlices] = 1.0f;
+	sliceCache.sin[0] = sliceCache.sin[numSlices] = 0.0f;
+	sliceCache.cos[0] = sliceCache.cos[numSlices] = 1.0f;
 	for (int slice = 1; slice < numSlices; ++slice)
 	{
 		const float theta = tau * sliceStep * (float)slice;
-		sinSliceCache[slice] = SDL_sinf(theta);
-		cosSliceCache[slice] = SDL_cosf(theta);
+		sliceCache.sin[slice] = SDL_sinf(theta);
+		sliceCache.cos[slice] = SDL_cosf(theta);
 	}
 
 	// Generate vertices
-	QuadIndex curVtx = 0;
+	unsigned curVtx = 0;
 	QuadVertexNormalTexture* vertices = (QuadVertexNormalTexture*)q->vertexData;
 	for (int stack = 0; stack <= numStacks; ++stack)
 	{
-		const float sinStack = sinStackCache[stack];
-		const float cosStack = cosStackCache[stack];
+		const float sinStack = stackCache.sin[stack];
+		const float cosStack = stackCache.cos[stack];
 		for (int slice = 0; slice <= numSlices; ++slice)
 		{
-			const float sinSlice = sinSliceCache[slice];
-			const float cosSlice = cosSliceCache[slice];
+			const float sinSlice = sliceCache.sin[slice];
+			const float cosSlice = sliceCache.cos[slice];
 			vertices[curVtx++] = (QuadVertexNormalTexture)
 			{
 				.x = radius * sinStack * sinSlice,
@@ -331,9 +604,151 @@ void Quad_Sphere(Quadric* q, float radius, int numSlices, int numStacks)
 			};
 		}
 	}
-	SDL_assert(q->numVertices == (unsigned)curVtx);
+	SDL_assert(q->numVertices == curVtx);
+	Quad_FreeTrigCache(&sliceCache);
+	Quad_FreeTrigCache(&stackCache);
 
 	// Generate indices
-	const unsigned curIdx = Quad_GenerateIndicesGenericQuadrilateral(0, q->indices, numSlices, numStacks, false, false);
+	const unsigned curIdx = Quad_GenerateIndicesGenericQuadrilateral(q, 0, 0, numSlices, numStacks, false, false);
 	SDL_assert(q->numIndices == curIdx);
+	return true;
+}
+
+
+QuadricSize Quad_ShapeSize(const QuadricDesc* desc, int numSlices, int numStacks)
+{
+	switch (desc->shape)
+	{
+	case QUAD_SHAPE_CYLINDER: return Quad_CylinderSize(numSlices, numStacks);
+	case QUAD_SHAPE_DISC:     return Quad_DiscSize(desc->innerRadius, numSlices, numStacks);
+	case QUAD_SHAPE_SPHERE:   return Quad_SphereSize(numSlices, numStacks);
+	}
+	return (QuadricSize){ 0, 0 };
+}
+
+bool Quad_Shape(Quadric* restrict q, const QuadricDesc* restrict desc, int numSlices, int numStacks)
+{
+	switch (desc->shape)
+	{
+	case QUAD_SHAPE_CYLINDER:
+		return Quad_Cylinder(q, desc->radius, desc->topRadius, desc->height, numSlices, numStacks);
+	case QUAD_SHAPE_DISC:
+		return Quad_Disc(q, desc->innerRadius, desc->radius, numSlices, numStacks);
+	case QUAD_SHAPE_SPHERE:
+		return Quad_Sphere(q, desc->radius, numSlices, numStacks);
+	}
+	return SDL_SetError("Invalid quadric shape %d", (int)desc->shape);
+}
+
+QuadricSize Quad_LodChainSize(const QuadricDesc* restrict desc, const int* restrict slices, unsigned numLods)
+{
+	QuadricSize total = { 0, 0 };
+	for (unsigned i = 0; i < numLods; ++i)
+	{
+		const QuadricSize size = Quad_ShapeSize(desc, slices[i], slices[i]);
+		total.numVertices += size.numVertices;
+		total.numIndices  += size.numIndices;
+	}
+	return total;
+}
+
+Quadric Quad_LodView(const Quadric* restrict q, const QuadricLod* restrict lod)
+{
+	return (Quadric)
+	{
+		.vertexData = (QuadVertexNormalTexture*)q->vertexData + lod->vertexOffset,
+		.indexData  = (uint8_t*)q->indexData + (size_t)Quad_IndexSize(q->indexType) * lod->firstIndex,
+		.indexType  = q->indexType,
+		.vertexCapacity = q->vertexCapacity - lod->vertexOffset,
+		.indexCapacity  = q->indexCapacity - lod->firstIndex,
+		.numVertices = lod->numVertices,
+		.numIndices  = lod->numIndices
+	};
+}
+
+bool Quad_LodChain(Quadric* restrict q, QuadricLodChain* restrict chain, const QuadricDesc* restrict desc,
+	const int* restrict slices, unsigned numLods)
+{
+	SDL_assert(numLods > 0 && numLods <= QUAD_MAX_LODS);
+
+	// Each level is generated in place after the previous one, its indices stay local so 16-bit is enough
+	unsigned firstIndex = 0, vertexOffset = 0;
+	for (unsigned i = 0; i < numLods; ++i)
+	{
+		QuadricLod* lod = &chain->lods[i];
+		*lod = (QuadricLod){ .numSlices = slices[i], .firstIndex = firstIndex, .vertexOffset = vertexOffset };
+		Quadric view = Quad_LodView(q, lod);
+		if (!Quad_Shape(&view, desc, slices[i], slices[i]))
+		{
+			return false;
+		}
+		lod->numIndices  = view.numIndices;
+		lod->numVertices = view.numVertices;
+		firstIndex   += view.numIndices;
+		vertexOffset += view.numVertices;
+	}
+	chain->numLods = numLods;
+	q->numVertices = vertexOffset;
+	q->numIndices  = firstIndex;
+
+	// Cylinders extend along +Z from the origin, the others are centred on it
+	if (desc->shape == QUAD_SHAPE_CYLINDER)
+	{
+		const float maxRadius = SDL_max(desc->radius, desc->topRadius);
+		const float halfHeight = 0.5f * desc->height;
+		chain->centre = (Vec3f){ 0.0f, 0.0f, halfHeight };
+		chain->radius = SDL_sqrtf(maxRadius * maxRadius + halfHeight * halfHeight);
+	}
+	else
+	{
+		chain->centre = (Vec3f){ 0.0f, 0.0f, 0.0f };
+		chain->radius = desc->radius;
+	}
+	return true;
+}
+
+static Vec4f Quad_TransformPoint(const Mtx* restrict m, Vec4f p)
+{
+	return (Vec4f)
+	{
+		m->c[0].x * p.x + m->c[1].x * p.y + m->c[2].x * p.z + m->c[3].x * p.w,
+		m->c[0].y * p.x + m->c[1].y * p.y + m->c[2].y * p.z + m->c[3].y * p.w,
+		m->c[0].z * p.x + m->c[1].z * p.y + m->c[2].z * p.z + m->c[3].z * p.w,
+		m->c[0].w * p.x + m->c[1].w * p.y + m->c[2].w * p.z + m->c[3].w * p.w
+	};
+}
+
+unsigned Quad_SelectLod(const QuadricLodChain* restrict chain, const Mtx* restrict projection,
+	const Mtx* restrict modelView, float viewportHeight)
+{
+	SDL_assert(chain->numLods > 0);
+	const unsigned coarsest = chain->numLods - 1;
+
+	// Bounding sphere into clip space, scaled by the largest axis of the model transform
+	const Vec4f centre = Quad_TransformPoint(modelView,
+		(Vec4f){ chain->centre.x, chain->centre.y, chain->centre.z, 1.0f });
+	const Vec4f clip = Quad_TransformPoint(projection, centre);
+	if (clip.w <= 0.0f)
+	{
+		return coarsest;
+	}
+	float maxScale2 = 0.0f;
+	for (int i = 0; i < 3; ++i)
+	{
+		const Vec4f axis = modelView->c[i];
+		maxScale2 = SDL_max(maxScale2, axis.x * axis.x + axis.y * axis.y + axis.z * axis.z);
+	}
+	const float radius = chain->radius * SDL_sqrtf(maxScale2);
+	const float pixelRadius = radius * projection->c[1].y / clip.w * 0.5f * viewportHeight;
+
+	// Enough slices that each silhouette edge spans about QUAD_LOD_PIXELS_PER_SLICE pixels
+	const float wantSlices = tau * pixelRadius / QUAD_LOD_PIXELS_PER_SLICE;
+	for (unsigned i = coarsest; i > 0; --i)
+	{
+		if ((float)chain->lods[i].numSlices >= wantSlices)
+		{
+			return i;
+		}
+	}
+	return 0;
 }
@@ -1,7 +1,9 @@
 #ifndef QUADRIC_H
 #define QUADRIC_H
 
+#include "matrix.h"
 #include <stdint.h>
+#include <stdbool.h>
 
 typedef struct
 {
@@ -16,23 +18,128 @@ typedef struct
 	float u, v;
 } QuadVertexNormalTexture;
 
+// Compact 16 byte alternative: half float position, octahedral encoded snorm16 normal & unorm16 texture coordinates
+typedef struct
+{
+	uint16_t x, y, z, w;  // w is always 1
+	int16_t nx, ny;
+	uint16_t u, v;
+} QuadVertexPacked;
+
 typedef uint16_t QuadIndex;
+typedef uint32_t QuadIndex32;
+
+typedef enum
+{
+	QUAD_INDEX_16,
+	QUAD_INDEX_32
+} QuadIndexType;
+
+typedef struct
+{
+	unsigned numVertices, numIndices;
+} QuadricSize;
 
 typedef struct
 {
 	void* vertexData;
-	QuadIndex* indices;
+	void* indexData;
+	QuadIndexType indexType;
 	unsigned vertexCapacity, indexCapacity;
 	unsigned numVertices, numIndices;
 } Quadric;
 
-void Quad_Cylinder(Quadric* q, float baseRadius, float topRadius, float height, int numSlices, int numStacks);
-void Quad_DiscPartial(Quadric* q, float innerRadius, float outerRadius, int numSlices, int numLoops,
+// Exact storage required by each shape, so callers can size buffers before generating
+QuadricSize Quad_CylinderSize(int numSlices, int numStacks);
+QuadricSize Quad_DiscPartialSize(float innerRadius, int numSlices, int numLoops, float sweepAngle);
+inline QuadricSize Quad_DiscSize(float innerRadius, int numSlices, int numLoops)
+{
+	return Quad_DiscPartialSize(innerRadius, numSlices, numLoops, 360.0f);
+}
+QuadricSize Quad_SphereSize(int numSlices, int numStacks);
+
+inline QuadIndexType Quad_IndexTypeForSize(QuadricSize size)
+{
+	return size.numVertices > UINT16_MAX + 1u ? QUAD_INDEX_32 : QUAD_INDEX_16;
+}
+inline unsigned Quad_IndexSize(QuadIndexType type)
+{
+	return type == QUAD_INDEX_32 ? sizeof(QuadIndex32) : sizeof(QuadIndex);
+}
+
+// Convert to packed vertices, texture coordinates are clamped to [0, 1]
+void Quad_PackVertices(QuadVertexPacked* restrict out, const QuadVertexNormalTexture* restrict in, unsigned count);
+
+// Heap allocate vertex & index storage that fits a mesh of the given size
+bool Quad_Alloc(Quadric* q, QuadricSize size);
+void Quad_Free(Quadric* q);
+
+bool Quad_Cylinder(Quadric* q, float baseRadius, float topRadius, float height, int numSlices, int numStacks);
+bool Quad_DiscPartial(Quadric* q, float innerRadius, float outerRadius, int numSlices, int numLoops,
 	float startAngle, float sweepAngle);
-inline void Quad_Disc(Quadric* q, float innerRadius, float outerRadius, int numSlices, int numLoops)
+inline bool Quad_Disc(Quadric* q, float innerRadius, float outerRadius, int numSlices, int numLoops)
 {
-	Quad_DiscPartial(q, innerRadius, outerRadius, numSlices, numLoops, 0.0f, 360.0f);
+	return Quad_DiscPartial(q, innerRadius, outerRadius, numSlices, numLoops, 0.0f, 360.0f);
 }
-void Quad_Sphere(Quadric* q, float radius, int numSlices, int numStacks);
+bool Quad_Sphere(Quadric* q, float radius, int numSlices, int numStacks);
+
+typedef struct
+{
+	unsigned firstIndex, numIndices;
+} QuadricRange;
+
+// Full disc whose indices are laid out slice by slice, twice around, so partial sweeps can be drawn as an index
+// range of the same mesh instead of regenerating it. Sweeps snap to whole slices.
+QuadricSize Quad_DiscSweepableSize(float innerRadius, int numSlices, int numLoops);
+bool Quad_DiscSweepable(Quadric* q, float innerRadius, float outerRadius, int numSlices, int numLoops);
+QuadricRange Quad_DiscSweepRange(float innerRadius, int numSlices, int numLoops, float startAngle, float sweepAngle);
+
+#define QUAD_MAX_LODS 6
+// Target silhouette edge length in pixels when picking a level of detail
+#define QUAD_LOD_PIXELS_PER_SLICE 8.0f
+
+typedef enum
+{
+	QUAD_SHAPE_CYLINDER,
+	QUAD_SHAPE_DISC,
+	QUAD_SHAPE_SPHERE
+} QuadricShape;
+
+typedef struct
+{
+	QuadricShape shape;
+	float radius;       // Sphere radius, disc outer radius or cylinder base radius
+	float topRadius;    // Cylinder only
+	float innerRadius;  // Disc only
+	float height;       // Cylinder only
+} QuadricDesc;
+
+typedef struct
+{
+	int numSlices;
+	unsigned firstIndex, numIndices;
+	unsigned vertexOffset, numVertices;  // Indices are relative to vertexOffset
+} QuadricLod;
+
+typedef struct
+{
+	QuadricLod lods[QUAD_MAX_LODS];  // Finest first
+	unsigned numLods;
+	Vec3f centre;  // Bounding sphere in model space
+	float radius;
+} QuadricLodChain;
+
+QuadricSize Quad_ShapeSize(const QuadricDesc* desc, int numSlices, int numStacks);
+bool Quad_Shape(Quadric* restrict q, const QuadricDesc* restrict desc, int numSlices, int numStacks);
+
+// Generate each level back to back into one quadric, stacks/loops match the slice count
+QuadricSize Quad_LodChainSize(const QuadricDesc* restrict desc, const int* restrict slices, unsigned numLods);
+bool Quad_LodChain(Quadric* restrict q, QuadricLodChain* restrict chain, const QuadricDesc* restrict desc,
+	const int* restrict slices, unsigned numLods);
+// Quadric aliasing just the storage of one level
+Quadric Quad_LodView(const Quadric* restrict q, const QuadricLod* restrict lod);
+// Pick the coarsest level whose silhouette still looks round at the projected size
+unsigned Quad_SelectLod(const QuadricLodChain* restrict chain, const Mtx* restrict projection,
+	const Mtx* restrict modelView, float viewportHeight);
 
 #endif//QUADRIC_H
@@ -5,94 +5,425 @@
 
 #include "sound.h"
 #include "nehe.h"
+#include <SDL3/SDL_intrin.h>
 
 
+// Voices are mixed as interleaved stereo floats, this many frames at a time
+#define MIX_CHANNELS 2
+#define MIX_FRAME_SIZE ((int)sizeof(float) * MIX_CHANNELS)
+#define MIX_CHUNK_FRAMES 256
+
+// Streams keep this many mixed frames ahead, 256 KiB & about 0.7 seconds at 48 kHz
+#define STREAM_RING_FRAMES 32768
+#define STREAM_READ_BYTES 16384
+#define STREAM_POLL_MS 10
+
+#define SQRT2 1.4142135f  // sqrt(2)
+
+struct NeHeSoundStream
+{
+	SDL_IOStream* io;
+	SDL_AudioStream* converter;  // From the file's format to the mixer's, only used by the stream thread
+	Sint64 dataStart;
+	Uint32 dataBytes, dataLeft;
+	int frameSize;
+	bool loop, started;
+
+	SDL_Thread* thread;
+	SDL_AtomicInt quit, ended;  // Ended once the thread has written the last frames of the file
+	SDL_AtomicU32 readFrame, writeFrame;  // Free-running counts, the mixer only moves read & the thread only write
+
+	Uint8 input[STREAM_READ_BYTES];
+	float ring[STREAM_RING_FRAMES * MIX_CHANNELS];
+};
+
+// Mixer's side of a voice, only touched by the audio callback or with the mix stream locked
+typedef struct
+{
+	const NeHeSound* sound;  // Either a sound or a stream, neither when the voice is free
+	NeHeSoundStream* stream;
+	int position;            // Next frame to mix
+	float gainLeft, gainRight;
+	bool loop;
+	NeHeVoice handle;
+	SDL_MainThreadCallback finished;
+	void* userdata;
+	Uint64 triggered;  // When the voice was started, until its first frame is mixed
+} MixerVoice;
+
+// Game's side of a voice, only touched on the main thread
+typedef struct
+{
+	const NeHeSound* sound;
+	NeHeSoundStream* stream;
+	int priority;
+	uint32_t started;     // Order voices were started in, the oldest is stolen first among equal priorities
+	uint32_t generation;  // Bumped every time the voice is reused, invalidating old handles
+	SDL_MainThreadCallback finished;
+	void* userdata;
+} VoiceSlot;
+
+typedef enum
+{
+	MIX_START,
+	MIX_STOP,
+	MIX_GAIN
+} MixCommandType;
+
+typedef struct
+{
+	MixCommandType type;
+	NeHeVoice voice;
+	const NeHeSound* sound;
+	NeHeSoundStream* stream;
+	float gainLeft, gainRight;
+	bool loop;
+	SDL_MainThreadCallback finished;
+	void* userdata;
+	Uint64 triggered;
+} MixCommand;
+
+typedef struct
+{
+	SDL_MainThreadCallback callback;
+	void* userdata;
+} VoiceFinished;
+
+// Measurements of the audio path, written by the audio callback so only read with the mix stream locked
+typedef struct
+{
+	Uint64 lastCallback, lastDuration;  // When the last callback came & how long the frames it mixed last
+	Uint32 callbacks;
+	Uint64 intervalSum, maxInterval;
+	double intervalSquares;  // In ms^2
+	Uint32 underruns, streamUnderruns;
+	Uint32 triggers;
+	Uint64 latencySum, maxLatency;
+	Uint64 lastLog;
+} MixerStats;
+
 struct NeHeSound
 {
-	SDL_AudioSpec spec;
-	int bytes;
-	Uint8 frames[];
+	int numFrames;
+	float* frames;  // Already in the mixer's format
 };
 
-NeHeSound* NeHe_LoadSound(struct NeHeContext* restrict ctx, const char* const restrict resource)
+static SDL_AudioDeviceID audioDevice = 0U;
+static SDL_AudioStream* mixStream = NULL;
+static SDL_AudioSpec mixSpec = { 0 };  // Chosen when the device is first opened and kept, so loaded sounds stay valid
+static int deviceFrames = 0;
+
+static MixerStats mixerStats;
+static SDL_AtomicU32 statsLogInterval;  // In milliseconds, 0 when not logging
+
+static MixerVoice mixerVoices[NEHE_MAX_VOICES];
+static VoiceSlot voiceSlots[NEHE_MAX_VOICES];
+static uint32_t voicesStarted = 0;
+
+// Handle playing on each voice, or 0. Whichever thread clears a handle is the one that reports the voice finished
+static SDL_AtomicU32 voicesPlaying[NEHE_MAX_VOICES];
+
+// Voices are controlled from the main thread through a single-producer single-consumer ring of commands, which the
+// mixer applies at the start of every callback
+#define MIX_COMMAND_RING 256
+static MixCommand commands[MIX_COMMAND_RING];
+static SDL_AtomicU32 commandsRead, commandsWritten;
+
+// Voices the mixer finishes come back the other way through a second ring, as the callback mustn't allocate or lock.
+// A voice finishes at most once before it's restarted, which drains the ring first, so twice the voices always fits
+#define MIX_FINISHED_RING (NEHE_MAX_VOICES * 2)
+static VoiceFinished finishedVoices[MIX_FINISHED_RING];
+static SDL_AtomicU32 finishedRead, finishedWritten;
+static SDL_AtomicInt statsLogDue;  // Set by the mixer when it's time to log the stats
+
+// NEHE_SND_SYNC sounds waiting for the one playing to finish, only touched on the main thread
+#define SYNC_QUEUE_SIZE 8
+static NeHeSound* syncQueue[SYNC_QUEUE_SIZE];
+static int syncQueueHead = 0, syncQueueLength = 0;
+static NeHeVoice syncVoice = 0;
+
+static inline int VoiceIndex(NeHeVoice voice)
 {
-	SDL_assert(ctx && resource);
+	return (int)(voice & 0xFFu) - 1;
+}
 
-	SDL_AudioSpec wavSpec;
-	Uint8* wavAudio;
-	Uint32 wavSize;
+static inline NeHeVoice VoiceHandle(int index)
+{
+	return voiceSlots[index].generation << 8 | (uint32_t)(index + 1);
+}
 
-	// Open WAVE file from resources
-	char* path = NeHe_ResourcePath(ctx, resource);
-	if (!path)
-		return NULL;
-	const bool success = SDL_LoadWAV(path, &wavSpec, &wavAudio, &wavSize);
-	SDL_free(path);
-	if (!success)
+static void ApplyCommand(const MixCommand* command)
+{
+	MixerVoice* voice = &mixerVoices[VoiceIndex(command->voice)];
+	switch (command->type)
 	{
-		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "SDL_LoadWAV: %s", SDL_GetError());
-		return NULL;
+	case MIX_START:
+		*voice = (MixerVoice)
+		{
+			.sound = command->sound,
+			.stream = command->stream,
+			.position = 0,
+			.gainLeft = command->gainLeft,
+			.gainRight = command->gainRight,
+			.loop = command->loop,
+			.handle = command->voice,
+			.finished = command->finished,
+			.userdata = command->userdata,
+			.triggered = command->triggered
+		};
+		break;
+	case MIX_STOP:
+		if (voice->handle == command->voice)
+		{
+			voice->sound = NULL;
+			voice->stream = NULL;
+		}
+		break;
+	case MIX_GAIN:
+		if (voice->handle == command->voice)
+		{
+			voice->gainLeft = command->gainLeft;
+			voice->gainRight = command->gainRight;
+		}
+		break;
 	}
+}
 
-	// Allocate structure for sound
-	const size_t audioSize = (size_t)wavSize;
-	const size_t soundSize = sizeof(NeHeSound) + audioSize;
-	NeHeSound* sound = (NeHeSound*)SDL_malloc(soundSize);
-	if (!sound)
+static void DrainCommands(void)
+{
+	const Uint32 written = SDL_GetAtomicU32(&commandsWritten);
+	Uint32 read = SDL_GetAtomicU32(&commandsRead);
+	for (; read != written; ++read)
+		ApplyCommand(&commands[read % MIX_COMMAND_RING]);
+	SDL_SetAtomicU32(&commandsRead, read);
+}
+
+static void SyncMixer(void)
+{
+	// Blocks only while the callback is running, after which the mixer has seen every command
+	SDL_LockAudioStream(mixStream);
+	DrainCommands();
+	SDL_UnlockAudioStream(mixStream);
+}
+
+static void PushCommand(const MixCommand* command)
+{
+	SDL_assert(mixStream);
+
+	const Uint32 written = SDL_GetAtomicU32(&commandsWritten);
+	if (written - SDL_GetAtomicU32(&commandsRead) == MIX_COMMAND_RING)
+		SyncMixer();  // The mixer has fallen far behind, like while the device is paused
+	commands[written % MIX_COMMAND_RING] = *command;
+	SDL_SetAtomicU32(&commandsWritten, written + 1);
+}
+
+static inline bool VoiceActive(int index)
+{
+	return SDL_GetAtomicU32(&voicesPlaying[index]) != 0u;
+}
+
+static int LookupVoice(NeHeVoice voice)
+{
+	const int index = VoiceIndex(voice);
+	if (index < 0 || index >= NEHE_MAX_VOICES || SDL_GetAtomicU32(&voicesPlaying[index]) != voice)
+		return -1;
+	return index;
+}
+
+static VoiceFinished EndVoice(int index)
+{
+	// Nothing to do if the mixer got to the end of it first
+	const NeHeVoice handle = VoiceHandle(index);
+	if (!SDL_CompareAndSwapAtomicU32(&voicesPlaying[index], handle, 0u))
+		return (VoiceFinished){ NULL, NULL };
+	if (mixStream)
+		PushCommand(&(const MixCommand){ .type = MIX_STOP, .voice = handle });
+	return (VoiceFinished){ voiceSlots[index].finished, voiceSlots[index].userdata };
+}
+
+static int EndAllVoices(VoiceFinished finished[NEHE_MAX_VOICES])
+{
+	int numFinished = 0;
+	for (int i = 0; i < NEHE_MAX_VOICES; ++i)
 	{
-		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "NeHe_LoadSound: SDL_malloc returned NULL");
-		SDL_free(wavAudio);
-		return NULL;
+		if (VoiceActive(i))
+			finished[numFinished++] = EndVoice(i);
 	}
+	return numFinished;
+}
 
-	// Copy header and data to sound structure
-	SDL_memcpy(&sound->spec, &wavSpec, sizeof(SDL_AudioSpec));
-	sound->bytes = (int)wavSize;
-	SDL_memcpy(sound->frames, wavAudio, audioSize);
+// Finished callbacks are made after unlocking, so they're free to start new voices
+static void CallFinished(const VoiceFinished* finished, int count)
+{
+	for (int i = 0; i < count; ++i)
+	{
+		if (finished[i].callback)
+			finished[i].callback(finished[i].userdata);
+	}
+}
 
-	SDL_free(wavAudio);
-	return sound;
+static void DrainFinished(void)
+{
+	// Move past each voice before reporting it, its callback may start another voice that drains the rest
+	Uint32 read;
+	while ((read = SDL_GetAtomicU32(&finishedRead)) != SDL_GetAtomicU32(&finishedWritten))
+	{
+		const VoiceFinished finished = finishedVoices[read % MIX_FINISHED_RING];
+		SDL_SetAtomicU32(&finishedRead, read + 1);
+		CallFinished(&finished, 1);
+	}
 }
 
+static void MixFrames(float* restrict out, const float* restrict in, int numFrames, float gainLeft, float gainRight)
+{
+	const int count = numFrames * MIX_CHANNELS;
+	int i = 0;
+#if defined(SDL_SSE_INTRINSICS)
+	// Two stereo frames per register
+	const __m128 gain = _mm_setr_ps(gainLeft, gainRight, gainLeft, gainRight);
+	for (; i + 4 <= count; i += 4)
+		_mm_storeu_ps(&out[i], _mm_add_ps(_mm_loadu_ps(&out[i]), _mm_mul_ps(_mm_loadu_ps(&in[i]), gain)));
+#elif defined(SDL_NEON_INTRINSICS)
+	const float gains[4] = { gainLeft, gainRight, gainLeft, gainRight };
+	const float32x4_t gain = vld1q_f32(gains);
+	for (; i + 4 <= count; i += 4)
+		vst1q_f32(&out[i], vmlaq_f32(vld1q_f32(&out[i]), vld1q_f32(&in[i]), gain));
+#endif
+	for (; i < count; i += MIX_CHANNELS)
+	{
+		out[i] += in[i] * gainLeft;
+		out[i + 1] += in[i + 1] * gainRight;
+	}
+}
 
-typedef struct
+static void FinishVoice(MixerVoice* voice)
 {
-	const NeHeSound* restrict sound;
-	int bytesLeft;
-} AudioLooperState;
+	// Free the voice, letting the main thread know without waiting on it unless it's already stopped the voice
+	if (SDL_CompareAndSwapAtomicU32(&voicesPlaying[VoiceIndex(voice->handle)], voice->handle, 0u) && voice->finished)
+	{
+		const Uint32 written = SDL_GetAtomicU32(&finishedWritten);
+		finishedVoices[written % MIX_FINISHED_RING] = (VoiceFinished){ voice->finished, voice->userdata };
+		SDL_SetAtomicU32(&finishedWritten, written + 1);
+	}
+	voice->sound = NULL;
+	voice->stream = NULL;
+}
 
-static void SDLCALL AudioLoopCallback(void* user, SDL_AudioStream* stream, int additional, int total)
+static void MixStream(MixerVoice* restrict voice, float* restrict out, int numFrames)
 {
-	(void)total;
+	NeHeSoundStream* stream = voice->stream;
 
-	AudioLooperState* state = (AudioLooperState*)user;
-	SDL_assert(state);
-	const NeHeSound* sound = state->sound;
-	if (!sound)
+	// Check for the end first, the thread writes its last frames before ending
+	const bool ended = SDL_GetAtomicInt(&stream->ended) != 0;
+	const Uint32 read = SDL_GetAtomicU32(&stream->readFrame);
+	const Uint32 available = SDL_GetAtomicU32(&stream->writeFrame) - read;
+
+	// Mix what's in the ring, in two parts if it wraps
+	const Uint32 count = SDL_min((Uint32)numFrames, available);
+	const Uint32 offset = read % STREAM_RING_FRAMES;
+	const Uint32 first = SDL_min(count, STREAM_RING_FRAMES - offset);
+	MixFrames(out, &stream->ring[offset * MIX_CHANNELS], (int)first, voice->gainLeft, voice->gainRight);
+	MixFrames(out + first * MIX_CHANNELS, stream->ring, (int)(count - first), voice->gainLeft, voice->gainRight);
+	SDL_SetAtomicU32(&stream->readFrame, read + count);
+
+	// Running dry before the end is an underrun, the voice stays silent until the thread catches up
+	if (ended && count == available)
+		FinishVoice(voice);
+	else if (count < (Uint32)numFrames)
+		++mixerStats.streamUnderruns;
+}
+
+static void MixVoice(MixerVoice* restrict voice, float* restrict out, int numFrames)
+{
+	if (voice->stream)
+	{
+		MixStream(voice, out, numFrames);
 		return;
+	}
 
-	while (additional > 0)
+	while (numFrames > 0 && voice->sound)
 	{
-		// Get sound frames position & number of frames to push
-		const Uint8* frames = sound->frames + (sound->bytes - state->bytesLeft);
-		const int framesLen = SDL_min(additional, state->bytesLeft);
+		const NeHeSound* sound = voice->sound;
+		const int count = SDL_min(numFrames, sound->numFrames - voice->position);
+		MixFrames(out, sound->frames + voice->position * MIX_CHANNELS, count, voice->gainLeft, voice->gainRight);
+		out += count * MIX_CHANNELS;
+		numFrames -= count;
+		voice->position += count;
 
-		// Push frames
-		if (!SDL_PutAudioStreamData(stream, frames, framesLen))
-			break;
+		if (voice->position == sound->numFrames)  // Reached end of sound
+		{
+			voice->position = 0;  // Restart from the beginning
+			if (!voice->loop)
+				FinishVoice(voice);  // Or free the voice
+		}
+	}
+}
 
-		// Subtract number of consumed frames
-		additional -= framesLen;
-		state->bytesLeft -= framesLen;
+static void RecordCallback(Uint64 now, int numFrames)
+{
+	MixerStats* stats = &mixerStats;
+	if (stats->lastCallback)
+	{
+		const Uint64 interval = now - stats->lastCallback;
+		const double intervalMs = (double)interval / SDL_NS_PER_MS;
+		++stats->callbacks;
+		stats->intervalSum += interval;
+		stats->intervalSquares += intervalMs * intervalMs;
+		stats->maxInterval = SDL_max(stats->maxInterval, interval);
 
-		if (state->bytesLeft == 0)            // Reached end of sound
-			state->bytesLeft = sound->bytes;  // Restart from the beginning
+		// The device has most likely run dry if what we gave it last time was played out well before now
+		if (interval > stats->lastDuration + stats->lastDuration / 2)
+			++stats->underruns;
+	}
+	stats->lastCallback = now;
+	stats->lastDuration = (Uint64)numFrames * (Uint64)SDL_NS_PER_SECOND / (Uint64)mixSpec.freq;
+
+	// Voices that are about to have their first frame mixed
+	for (int i = 0; i < NEHE_MAX_VOICES; ++i)
+	{
+		MixerVoice* voice = &mixerVoices[i];
+		if (voice->triggered && (voice->sound || voice->stream))
+		{
+			const Uint64 latency = now - voice->triggered;
+			++stats->triggers;
+			stats->latencySum += latency;
+			stats->maxLatency = SDL_max(stats->maxLatency, latency);
+			voice->triggered = 0;
+		}
+	}
+
+	// Have the main thread log the stats now & then
+	const Uint32 logInterval = SDL_GetAtomicU32(&statsLogInterval);
+	if (logInterval && now - stats->lastLog >= SDL_MS_TO_NS(logInterval))
+	{
+		stats->lastLog = now;
+		SDL_SetAtomicInt(&statsLogDue, 1);
 	}
 }
 
-static SDL_AudioDeviceID audioDevice = 0U;
-static SDL_AudioStream* audioStream = NULL;
-static AudioLooperState looperState;
+static void SDLCALL MixCallback(void* user, SDL_AudioStream* stream, int additional, int total)
+{
+	(void)user; (void)total;
+
+	static float mixBuffer[MIX_CHUNK_FRAMES * MIX_CHANNELS];
+	DrainCommands();
+
+	int numFrames = (additional + MIX_FRAME_SIZE - 1) / MIX_FRAME_SIZE;
+	RecordCallback(SDL_GetTicksNS(), numFrames);
+	while (numFrames > 0)
+	{
+		// Sum every playing voice into the mix buffer
+		const int count = SDL_min(numFrames, MIX_CHUNK_FRAMES);
+		SDL_memset(mixBuffer, 0, sizeof(float) * MIX_CHANNELS * (size_t)count);
+		for (int i = 0; i < NEHE_MAX_VOICES; ++i)
+			MixVoice(&mixerVoices[i], mixBuffer, count);
+
+		// Push frames
+		if (!SDL_PutAudioStreamData(stream, mixBuffer, count * MIX_FRAME_SIZE))
+			break;
+		numFrames -= count;
+	}
+}
 
 bool NeHe_OpenSound(void)
 {
@@ -118,91 +449,605 @@ bool NeHe_OpenSound(void)
 		}
 	}
 
-	return true;
-}
+	// Get preferred device format
+	SDL_AudioSpec deviceSpec;
+	if (!SDL_GetAudioDeviceFormat(audioDevice, &deviceSpec, &deviceFrames))
+	{
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "SDL_GetAudioDeviceFormat: %s", SDL_GetError());
+		NeHe_CloseSound();
+		return false;
+	}
 
-static void StopSound(void)
-{
-	if (audioStream == NULL)
-		return;
+	// A single stream carries the mix of every voice, at the device's rate so only the sample format is converted
+	if (mixSpec.freq == 0)
+		mixSpec = (SDL_AudioSpec){ .format = SDL_AUDIO_F32, .channels = MIX_CHANNELS, .freq = deviceSpec.freq };
+	if ((mixStream = SDL_CreateAudioStream(&mixSpec, &deviceSpec)) == NULL)
+	{
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "SDL_CreateAudioStream: %s", SDL_GetError());
+		NeHe_CloseSound();
+		return false;
+	}
+	if (!SDL_SetAudioStreamGetCallback(mixStream, MixCallback, NULL))
+	{
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "SDL_SetAudioStreamGetCallback: %s", SDL_GetError());
+		NeHe_CloseSound();
+		return false;
+	}
+	if (!SDL_BindAudioStream(audioDevice, mixStream))
+	{
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "SDL_BindAudioStream: %s", SDL_GetError());
+		NeHe_CloseSound();
+		return false;
+	}
 
-	SDL_FlushAudioStream(audioStream);
-	SDL_DestroyAudioStream(audioStream);
-	audioStream = NULL;
+	return true;
 }
 
 void NeHe_CloseSound(void)
 {
-	StopSound();                        // Stop & dispose of currently playing stream if any
+	SDL_DestroyAudioStream(mixStream);  // Unbinds the stream, the callback won't be called again
+	mixStream = NULL;
 	SDL_CloseAudioDevice(audioDevice);  // Close the logical audio device
 	audioDevice = 0u;
+
+	// Cut off whatever was playing, without starting anything that was queued
+	syncQueueLength = 0;
+	VoiceFinished finished[NEHE_MAX_VOICES];
+	const int numFinished = EndAllVoices(finished);
+
+	// Nothing is mixing any more, so drop what the mixer didn't get to
+	SDL_SetAtomicU32(&commandsRead, SDL_GetAtomicU32(&commandsWritten));
+	SDL_memset(mixerVoices, 0, sizeof(mixerVoices));
+	SDL_memset(&mixerStats, 0, sizeof(mixerStats));
+	DrainFinished();
+	CallFinished(finished, numFinished);
 }
 
-bool NeHe_PlaySound(const NeHeSound* restrict sound, NeHeSoundFlags flags)
+NeHeSound* NeHe_LoadSound(struct NeHeContext* restrict ctx, const char* const restrict resource)
 {
-	// Open device if needed
+	SDL_assert(ctx && resource);
+
+	// Sounds are converted to the mixer's format, which is only known once the device is open
 	if (audioDevice == 0u && !NeHe_OpenSound())
-		return false;
+		return NULL;
 
-	StopSound();        // Cut off previous stream
-	if (sound == NULL)  // If no sound was provided then we're done
-		return true;
+	SDL_AudioSpec wavSpec;
+	Uint8* wavAudio;
+	Uint32 wavSize;
 
-	// Get preferred device format
-	SDL_AudioSpec deviceSpec;
-	if (!SDL_GetAudioDeviceFormat(audioDevice, &deviceSpec, NULL))
+	// Open WAVE file from resources
+	char* path = NeHe_ResourcePath(ctx, resource);
+	if (!path)
+		return NULL;
+	const bool success = SDL_LoadWAV(path, &wavSpec, &wavAudio, &wavSize);
+	SDL_free(path);
+	if (!success)
 	{
-		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "SDL_GetAudioDeviceFormat: %s", SDL_GetError());
-		return false;
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "SDL_LoadWAV: %s", SDL_GetError());
+		return NULL;
 	}
 
-	// Open audio stream
-	if ((audioStream = SDL_CreateAudioStream(&sound->spec, &deviceSpec)) == NULL)
+	NeHeSound* sound = (NeHeSound*)SDL_malloc(sizeof(NeHeSound));
+	if (!sound)
 	{
-		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "SDL_OpenAudioDeviceStream: %s", SDL_GetError());
-		return false;
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "NeHe_LoadSound: SDL_malloc returned NULL");
+		SDL_free(wavAudio);
+		return NULL;
 	}
 
-	// Bind our new stream to the logical device
-	if (!SDL_BindAudioStream(audioDevice, audioStream))
+	// Convert & resample once into the buffer voices play from, so playing is only a multiply-add
+	Uint8* data;
+	int length;
+	if (!SDL_ConvertAudioSamples(&wavSpec, wavAudio, (int)wavSize, &mixSpec, &data, &length))
 	{
-		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "SDL_BindAudioStream: %s", SDL_GetError());
-		SDL_DestroyAudioStream(audioStream);
-		audioStream = NULL;
-		return false;
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "SDL_ConvertAudioSamples: %s", SDL_GetError());
+		SDL_free(wavAudio);
+		SDL_free(sound);
+		return NULL;
 	}
+	SDL_free(wavAudio);
+	sound->frames = (float*)(void*)data;
+	sound->numFrames = length / MIX_FRAME_SIZE;
+	return sound;
+}
 
-	if (!(flags & NEHE_SND_LOOP))
+void NeHe_FreeSound(NeHeSound* sound)
+{
+	if (!sound)
+		return;
+
+	// Drop it from the queue of sounds waiting to play
+	int queued = 0;
+	for (int i = 0; i < syncQueueLength; ++i)
+	{
+		NeHeSound* next = syncQueue[(syncQueueHead + i) % SYNC_QUEUE_SIZE];
+		if (next != sound)
+			syncQueue[(syncQueueHead + queued++) % SYNC_QUEUE_SIZE] = next;
+	}
+	syncQueueLength = queued;
+
+	// Stop its voices and make sure the mixer has let go of it
+	VoiceFinished finished[NEHE_MAX_VOICES];
+	int numFinished = 0;
+	for (int i = 0; i < NEHE_MAX_VOICES; ++i)
 	{
-		// For one-shots then just shove the entire sound into the stream
-		SDL_PutAudioStreamData(audioStream, sound->frames, sound->bytes);
-		SDL_FlushAudioStream(audioStream);
+		if (voiceSlots[i].sound == sound)
+			finished[numFinished++] = EndVoice(i);
 	}
-	else
+	if (mixStream)
+		SyncMixer();
+	CallFinished(finished, numFinished);
+
+	SDL_free(sound->frames);
+	SDL_free(sound);
+}
+
+static bool ReadWaveHeader(NeHeSoundStream* restrict stream, SDL_AudioSpec* restrict spec)
+{
+	SDL_IOStream* io = stream->io;
+	Uint32 riff, riffSize, wave;
+	if (!SDL_ReadU32LE(io, &riff) || !SDL_ReadU32LE(io, &riffSize) || !SDL_ReadU32LE(io, &wave)
+		|| riff != SDL_FOURCC('R', 'I', 'F', 'F') || wave != SDL_FOURCC('W', 'A', 'V', 'E'))
+		return SDL_SetError("Not a WAVE file");
+
+	// Find the format, then the start of the samples
+	bool haveFormat = false;
+	for (;;)
 	{
-		// For looped sounds setup get callback to constantly replenish the stream
-		looperState.sound = sound;
-		looperState.bytesLeft = sound->bytes;
-		if (!SDL_SetAudioStreamGetCallback(audioStream, AudioLoopCallback, &looperState))
+		Uint32 id, size;
+		if (!SDL_ReadU32LE(io, &id) || !SDL_ReadU32LE(io, &size))
+			return SDL_SetError("WAVE file has no data chunk");
+		const Sint64 next = SDL_TellIO(io) + (Sint64)size + (size & 1);  // Chunks are padded to even sizes
+
+		if (id == SDL_FOURCC('f', 'm', 't', ' '))
+		{
+			Uint16 tag, channels, blockAlign, bits;
+			Uint32 rate, byteRate;
+			if (size < 16 || !SDL_ReadU16LE(io, &tag) || !SDL_ReadU16LE(io, &channels)
+				|| !SDL_ReadU32LE(io, &rate) || !SDL_ReadU32LE(io, &byteRate)
+				|| !SDL_ReadU16LE(io, &blockAlign) || !SDL_ReadU16LE(io, &bits))
+				return SDL_SetError("Invalid WAVE format chunk");
+
+			// WAVE_FORMAT_EXTENSIBLE keeps the real tag at the start of the sub-format GUID
+			Uint16 extraSize, validBits;
+			Uint32 channelMask;
+			if (tag == 0xFFFE && (size < 26 || !SDL_ReadU16LE(io, &extraSize) || !SDL_ReadU16LE(io, &validBits)
+				|| !SDL_ReadU32LE(io, &channelMask) || !SDL_ReadU16LE(io, &tag)))
+				return SDL_SetError("Invalid WAVE format chunk");
+
+			if (tag == 1 && bits == 8)
+				spec->format = SDL_AUDIO_U8;
+			else if (tag == 1 && bits == 16)
+				spec->format = SDL_AUDIO_S16LE;
+			else if (tag == 1 && bits == 32)
+				spec->format = SDL_AUDIO_S32LE;
+			else if (tag == 3 && bits == 32)
+				spec->format = SDL_AUDIO_F32LE;
+			else
+				return SDL_SetError("Unsupported WAVE format %u with %u bits", tag, bits);
+			if (channels == 0 || rate == 0 || rate > INT32_MAX || blockAlign != channels * bits / 8)
+				return SDL_SetError("Invalid WAVE format chunk");
+			spec->channels = channels;
+			spec->freq = (int)rate;
+			stream->frameSize = blockAlign;
+			haveFormat = true;
+		}
+		else if (id == SDL_FOURCC('d', 'a', 't', 'a'))
 		{
-			SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "SDL_SetAudioStreamGetCallback: %s", SDL_GetError());
-			SDL_DestroyAudioStream(audioStream);
-			audioStream = NULL;
+			if (!haveFormat)
+				return SDL_SetError("WAVE data chunk comes before its format");
+			stream->dataStart = SDL_TellIO(io);
+			stream->dataBytes = size - size % (Uint32)stream->frameSize;
+			if (stream->dataBytes == 0)
+				return SDL_SetError("WAVE file has no samples");
+			return true;
+		}
+
+		if (SDL_SeekIO(io, next, SDL_IO_SEEK_SET) < 0)
 			return false;
+	}
+}
+
+static int SDLCALL StreamThread(void* userdata)
+{
+	NeHeSoundStream* stream = (NeHeSoundStream*)userdata;
+
+	bool flushed = false;
+	while (!SDL_GetAtomicInt(&stream->quit))
+	{
+		// Wait for the mixer to have drained a good part of the ring
+		const Uint32 write = SDL_GetAtomicU32(&stream->writeFrame);
+		const Uint32 space = STREAM_RING_FRAMES - (write - SDL_GetAtomicU32(&stream->readFrame));
+		if (space < STREAM_RING_FRAMES / 4)
+		{
+			SDL_Delay(STREAM_POLL_MS);
+			continue;
+		}
+
+		// Converted frames go straight into the ring, up to where it wraps
+		const Uint32 offset = write % STREAM_RING_FRAMES;
+		const int numFrames = (int)SDL_min(space, STREAM_RING_FRAMES - offset);
+		const int got = SDL_GetAudioStreamData(stream->converter, &stream->ring[offset * MIX_CHANNELS],
+			numFrames * MIX_FRAME_SIZE);
+		if (got < 0)
+		{
+			SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "SDL_GetAudioStreamData: %s", SDL_GetError());
+			break;
+		}
+		if (got > 0)
+		{
+			SDL_SetAtomicU32(&stream->writeFrame, write + (Uint32)(got / MIX_FRAME_SIZE));
+			continue;
+		}
+
+		// Converter has run dry, feed it the next chunk of the file
+		if (stream->dataLeft == 0 && stream->loop)
+		{
+			if (SDL_SeekIO(stream->io, stream->dataStart, SDL_IO_SEEK_SET) < 0)
+			{
+				SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "SDL_SeekIO: %s", SDL_GetError());
+				break;
+			}
+			stream->dataLeft = stream->dataBytes;
+		}
+		if (stream->dataLeft > 0)
+		{
+			const size_t chunk = STREAM_READ_BYTES - STREAM_READ_BYTES % (size_t)stream->frameSize;
+			const size_t length = SDL_min((size_t)stream->dataLeft, chunk);
+			if (SDL_ReadIO(stream->io, stream->input, length) != length)
+			{
+				SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "SDL_ReadIO: %s", SDL_GetError());
+				break;
+			}
+			stream->dataLeft -= (Uint32)length;
+			if (!SDL_PutAudioStreamData(stream->converter, stream->input, (int)length))
+			{
+				SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "SDL_PutAudioStreamData: %s", SDL_GetError());
+				break;
+			}
+		}
+		else if (!flushed)
+		{
+			// Get the resampler's last few frames out
+			SDL_FlushAudioStream(stream->converter);
+			flushed = true;
+		}
+		else
+		{
+			break;  // Everything has been converted
 		}
 	}
 
-	// Block until sound is done playing if we're synchronous
-	if (!(flags & NEHE_SND_ASYNC))
+	SDL_SetAtomicInt(&stream->ended, 1);
+	return 0;
+}
+
+NeHeSoundStream* NeHe_OpenSoundStream(struct NeHeContext* restrict ctx, const char* const restrict resource, bool loop)
+{
+	SDL_assert(ctx && resource);
+
+	// Frames are converted to the mixer's format as they're read
+	if (audioDevice == 0u && !NeHe_OpenSound())
+		return NULL;
+
+	NeHeSoundStream* stream = (NeHeSoundStream*)SDL_calloc(1, sizeof(NeHeSoundStream));
+	if (!stream)
 	{
-		while (SDL_GetAudioStreamAvailable(audioStream) > 0)
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "NeHe_OpenSoundStream: SDL_calloc returned NULL");
+		return NULL;
+	}
+	stream->loop = loop;
+
+	SDL_AudioSpec fileSpec;
+	if ((stream->io = NeHe_OpenResource(ctx, resource, "rb")) == NULL)
+	{
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "SDL_IOFromFile: %s", SDL_GetError());
+		NeHe_CloseSoundStream(stream);
+		return NULL;
+	}
+	if (!ReadWaveHeader(stream, &fileSpec))
+	{
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Failed to read \"%s\": %s", resource, SDL_GetError());
+		NeHe_CloseSoundStream(stream);
+		return NULL;
+	}
+	stream->dataLeft = stream->dataBytes;
+
+	if ((stream->converter = SDL_CreateAudioStream(&fileSpec, &mixSpec)) == NULL)
+	{
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "SDL_CreateAudioStream: %s", SDL_GetError());
+		NeHe_CloseSoundStream(stream);
+		return NULL;
+	}
+
+	// Start filling the ring straight away, so there's something to play when the stream is started
+	if ((stream->thread = SDL_CreateThread(StreamThread, "NeHe sound stream", stream)) == NULL)
+	{
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "SDL_CreateThread: %s", SDL_GetError());
+		NeHe_CloseSoundStream(stream);
+		return NULL;
+	}
+
+	return stream;
+}
+
+void NeHe_CloseSoundStream(NeHeSoundStream* stream)
+{
+	if (!stream)
+		return;
+
+	// Take it off the voice that's playing it and make sure the mixer has let go of it
+	VoiceFinished finished = { NULL, NULL };
+	for (int i = 0; i < NEHE_MAX_VOICES; ++i)
+	{
+		if (voiceSlots[i].stream == stream)
+			finished = EndVoice(i);
+	}
+	if (mixStream)
+		SyncMixer();
+	CallFinished(&finished, 1);
+
+	if (stream->thread)
+	{
+		SDL_SetAtomicInt(&stream->quit, 1);
+		SDL_WaitThread(stream->thread, NULL);
+	}
+	SDL_DestroyAudioStream(stream->converter);
+	if (stream->io)
+		SDL_CloseIO(stream->io);
+	SDL_free(stream);
+}
+
+static void VoiceGains(float gain, float pan, float* restrict outLeft, float* restrict outRight)
+{
+	// Constant power panning so sounds don't get quieter in the middle
+	const float angle = (SDL_clamp(pan, -1.0f, 1.0f) + 1.0f) * SDL_PI_F * 0.25f;
+	*outLeft  = gain * SQRT2 * SDL_cosf(angle);
+	*outRight = gain * SQRT2 * SDL_sinf(angle);
+}
+
+static NeHeVoice StartVoice(const NeHeSound* restrict sound, NeHeSoundStream* restrict stream,
+	const NeHeVoiceParams* restrict params)
+{
+	// Hear about voices the mixer finished first, so they're free & the ring has room for them to finish again
+	DrainFinished();
+
+	// Take a free voice, or steal the oldest of the lowest priority
+	int best = -1;
+	for (int i = 0; i < NEHE_MAX_VOICES; ++i)
+	{
+		const VoiceSlot* slot = &voiceSlots[i];
+		if (!VoiceActive(i))
 		{
-			SDL_PumpEvents();  // Pump events to avoid the appearance of "crashing" to the user
-			SDL_Delay(10);     // Short sleep to limit CPU usage
+			best = i;
+			break;
 		}
-		SDL_DestroyAudioStream(audioStream);
-		audioStream = NULL;
+		if (best < 0 || slot->priority < voiceSlots[best].priority
+			|| (slot->priority == voiceSlots[best].priority && (int32_t)(slot->started - voiceSlots[best].started) < 0))
+			best = i;
+	}
+	if (VoiceActive(best) && voiceSlots[best].priority > params->priority)
+	{
+		SDL_SetError("Every voice is playing a higher priority sound");
+		return 0;
 	}
+	const VoiceFinished stolen = EndVoice(best);
+
+	VoiceSlot* slot = &voiceSlots[best];
+	slot->sound = sound;
+	slot->stream = stream;
+	slot->priority = params->priority;
+	slot->started = voicesStarted++;
+	slot->generation = (slot->generation + 1) & 0xFFFFFFu;
+	slot->finished = params->finished;
+	slot->userdata = params->userdata;
+	const NeHeVoice handle = VoiceHandle(best);
+	SDL_SetAtomicU32(&voicesPlaying[best], handle);
+
+	MixCommand command =
+	{
+		.type = MIX_START,
+		.voice = handle,
+		.sound = sound,
+		.stream = stream,
+		.loop = params->loop,
+		.finished = params->finished,
+		.userdata = params->userdata,
+		.triggered = SDL_GetTicksNS()
+	};
+	VoiceGains(params->gain, params->pan, &command.gainLeft, &command.gainRight);
+	PushCommand(&command);
 
+	CallFinished(&stolen, 1);
+	return handle;
+}
+
+NeHeVoice NeHe_StartVoice(NeHeSound* restrict sound, const NeHeVoiceParams* restrict params)
+{
+	SDL_assert(sound && params);
+
+	// Open device if needed, sounds loaded before it was closed are still in the mixer's format
+	if (audioDevice == 0u && !NeHe_OpenSound())
+		return 0;
+	if (sound->numFrames == 0)
+		return 0;
+
+	return StartVoice(sound, NULL, params);
+}
+
+NeHeVoice NeHe_StartStreamVoice(NeHeSoundStream* restrict stream, const NeHeVoiceParams* restrict params)
+{
+	SDL_assert(stream && params);
+
+	// The ring is only read from once
+	if (stream->started)
+	{
+		SDL_SetError("Sound stream has already been played");
+		return 0;
+	}
+	if (audioDevice == 0u && !NeHe_OpenSound())
+		return 0;
+
+	const NeHeVoice voice = StartVoice(NULL, stream, params);
+	stream->started = voice != 0;
+	return voice;
+}
+
+void NeHe_StopVoice(NeHeVoice voice)
+{
+	const int index = LookupVoice(voice);
+	if (index < 0)
+		return;
+
+	const VoiceFinished finished = EndVoice(index);
+	CallFinished(&finished, 1);
+}
+
+void NeHe_SetVoiceGain(NeHeVoice voice, float gain, float pan)
+{
+	if (!mixStream || LookupVoice(voice) < 0)
+		return;
+
+	MixCommand command = { .type = MIX_GAIN, .voice = voice };
+	VoiceGains(gain, pan, &command.gainLeft, &command.gainRight);
+	PushCommand(&command);
+}
+
+bool NeHe_VoicePlaying(NeHeVoice voice)
+{
+	return LookupVoice(voice) >= 0;
+}
+
+static void SDLCALL SyncFinished(void* userdata);
+
+static bool StartSync(NeHeSound* restrict sound)
+{
+	syncVoice = NeHe_StartVoice(sound, &(const NeHeVoiceParams)
+	{
+		.gain = 1.0f,
+		.pan = 0.0f,
+		.finished = SyncFinished
+	});
+	return syncVoice != 0;
+}
+
+static void SDLCALL SyncFinished(void* userdata)
+{
+	(void)userdata;
+
+	// Start the next sound in line, skipping any that fail
+	syncVoice = 0;
+	while (syncQueueLength > 0 && !syncVoice)
+	{
+		NeHeSound* next = syncQueue[syncQueueHead];
+		syncQueueHead = (syncQueueHead + 1) % SYNC_QUEUE_SIZE;
+		--syncQueueLength;
+		if (!StartSync(next))
+			SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "NeHe_StartVoice: %s", SDL_GetError());
+	}
+}
+
+bool NeHe_PlaySound(NeHeSound* restrict sound, NeHeSoundFlags flags)
+{
+	// Open device if needed
+	if (audioDevice == 0u && !NeHe_OpenSound())
+		return false;
+	DrainFinished();  // A synchronous sound that just finished lets the next start straight away
+
+	// No sound stops everything that's playing
+	if (sound == NULL)
+	{
+		syncQueueLength = 0;
+		VoiceFinished finished[NEHE_MAX_VOICES];
+		const int numFinished = EndAllVoices(finished);
+		CallFinished(finished, numFinished);
+		return true;
+	}
+
+	if (flags & NEHE_SND_ASYNC)
+	{
+		return NeHe_StartVoice(sound, &(const NeHeVoiceParams)
+		{
+			.gain = 1.0f,
+			.pan = 0.0f,
+			.loop = (flags & NEHE_SND_LOOP) != 0
+		}) != 0;
+	}
+
+	// Synchronous sounds wait their turn behind the one playing rather than blocking until it's done,
+	// they never loop as that would hold up the queue forever
+	if (!syncVoice)
+		return StartSync(sound);
+	if (syncQueueLength == SYNC_QUEUE_SIZE)
+		return SDL_SetError("Too many sounds queued");
+	syncQueue[(syncQueueHead + syncQueueLength++) % SYNC_QUEUE_SIZE] = sound;
+	return true;
+}
+
+bool NeHe_GetSoundStats(NeHeSoundStats* restrict stats, bool reset)
+{
+	SDL_assert(stats);
+
+	if (!mixStream)
+		return SDL_SetError("Audio device isn't open");
+
+	*stats = (NeHeSoundStats)
+	{
+		.queuedBytes = SDL_GetAudioStreamAvailable(mixStream),
+		.deviceFrames = deviceFrames,
+		.bufferMs = (float)deviceFrames * 1000.0f / (float)mixSpec.freq
+	};
+
+	SDL_LockAudioStream(mixStream);
+	MixerStats* mixer = &mixerStats;
+	stats->callbacks = mixer->callbacks;
+	stats->underruns = mixer->underruns;
+	stats->streamUnderruns = mixer->streamUnderruns;
+	stats->triggers = mixer->triggers;
+	if (mixer->callbacks)
+	{
+		const double meanMs = (double)mixer->intervalSum / SDL_NS_PER_MS / mixer->callbacks;
+		const double variance = mixer->intervalSquares / mixer->callbacks - meanMs * meanMs;
+		stats->intervalMs = (float)meanMs;
+		stats->jitterMs = (float)SDL_sqrt(SDL_max(variance, 0.0));
+		stats->maxIntervalMs = (float)((double)mixer->maxInterval / SDL_NS_PER_MS);
+	}
+	if (mixer->triggers)
+	{
+		stats->latencyMs = (float)((double)mixer->latencySum / SDL_NS_PER_MS / mixer->triggers);
+		stats->maxLatencyMs = (float)((double)mixer->maxLatency / SDL_NS_PER_MS);
+	}
+	if (reset)
+	{
+		// Keep the timing of the last callback so the next interval is still measured
+		const MixerStats kept = { .lastCallback = mixer->lastCallback, .lastDuration = mixer->lastDuration,
+			.lastLog = mixer->lastLog };
+		*mixer = kept;
+	}
+	SDL_UnlockAudioStream(mixStream);
 	return true;
 }
+
+static void LogStats(void)
+{
+	NeHeSoundStats stats;
+	if (!NeHe_GetSoundStats(&stats, true))
+		return;
+	SDL_Log("Audio: %u callbacks every %.2f ms (jitter %.2f, max %.2f), %u underruns, %u stream underruns, "
+		"latency %.2f ms (max %.2f) + %.2f ms buffer of %d frames, %d bytes queued",
+		stats.callbacks, (double)stats.intervalMs, (double)stats.jitterMs, (double)stats.maxIntervalMs,
+		stats.underruns, stats.streamUnderruns, (double)stats.latencyMs, (double)stats.maxLatencyMs,
+		(double)stats.bufferMs, stats.deviceFrames, stats.queuedBytes);
+}
+
+void NeHe_LogSoundStats(unsigned intervalMs)
+{
+	SDL_SetAtomicU32(&statsLogInterval, intervalMs);
+}
+
+void NeHe_UpdateSound(void)
+{
+	DrainFinished();
+	if (SDL_CompareAndSwapAtomicInt(&statsLogDue, 1, 0))
+		LogStats();
+}
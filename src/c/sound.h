@@ -1,19 +1,83 @@
 #ifndef SOUND_H
 #define SOUND_H
 
+#include <SDL3/SDL_init.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 struct NeHeContext;
 typedef struct NeHeSound NeHeSound;
+typedef struct NeHeSoundStream NeHeSoundStream;
 
 typedef unsigned NeHeSoundFlags;
 #define NEHE_SND_SYNC  (NeHeSoundFlags)0x0
 #define NEHE_SND_ASYNC (NeHeSoundFlags)0x1
 #define NEHE_SND_LOOP  (NeHeSoundFlags)(1 << 3)
 
+// Sounds are mixed in software on a fixed pool of voices
+#define NEHE_MAX_VOICES 32
+
+typedef uint32_t NeHeVoice;  // Handle to a playing sound, 0 is never a valid voice
+
+typedef struct
+{
+	float gain;    // Linear volume, 1 plays the sound as-is
+	float pan;     // -1 is hard left, 0 centred, 1 hard right
+	int priority;  // When every voice is busy the lowest priority one is stolen, if it's no higher than this
+	bool loop;
+
+	// Called on the main thread once the voice has finished, been stopped, or stolen. Voices that drain in the
+	// mixer are reported by the next NeHe_UpdateSound or voice started, so the callback may arrive after it was stopped
+	SDL_MainThreadCallback finished;
+	void* userdata;
+} NeHeVoiceParams;
+
+// Load a WAVE file converted to the mixer's format, opening the audio device if needed
 NeHeSound* NeHe_LoadSound(struct NeHeContext* restrict ctx, const char* restrict resource);
+void NeHe_FreeSound(NeHeSound* sound);
 bool NeHe_OpenSound(void);
 void NeHe_CloseSound(void);
-bool NeHe_PlaySound(const NeHeSound* restrict sound, NeHeSoundFlags flags);
+
+// Stream a long WAVE file like a music track from disk, read ahead on a thread into a fixed buffer of a few hundred
+// KiB. Opens the audio device if needed, a looping stream carries on from the start of the file when it ends
+NeHeSoundStream* NeHe_OpenSoundStream(struct NeHeContext* restrict ctx, const char* restrict resource, bool loop);
+void NeHe_CloseSoundStream(NeHeSoundStream* stream);
+
+// Play a sound on a free voice, a NULL sound stops every voice. Neither flag blocks, NEHE_SND_SYNC sounds are
+// queued to play one after another instead of over the top of each other and ignore NEHE_SND_LOOP
+bool NeHe_PlaySound(NeHeSound* restrict sound, NeHeSoundFlags flags);
+
+NeHeVoice NeHe_StartVoice(NeHeSound* restrict sound, const NeHeVoiceParams* restrict params);
+// Play a stream on a voice, ignoring the loop parameter. A stream can only be played once
+NeHeVoice NeHe_StartStreamVoice(NeHeSoundStream* restrict stream, const NeHeVoiceParams* restrict params);
+void NeHe_StopVoice(NeHeVoice voice);
+void NeHe_SetVoiceGain(NeHeVoice voice, float gain, float pan);
+bool NeHe_VoicePlaying(NeHeVoice voice);
+
+// Call once a frame to report voices the mixer has finished and log the stats when they're due
+void NeHe_UpdateSound(void);
+
+// Measurements of the audio path since the device was opened or the stats were last reset
+typedef struct
+{
+	int queuedBytes;    // Mixed audio waiting in the stream to the device (SDL_GetAudioStreamAvailable)
+	int deviceFrames;   // Size of the device's buffer
+	float bufferMs;     // How long the device's buffer lasts, roughly what it adds to the latency
+
+	uint32_t callbacks;
+	float intervalMs;     // Mean time between mixer callbacks
+	float jitterMs;       // Standard deviation of the time between callbacks
+	float maxIntervalMs;
+	uint32_t underruns;        // Callbacks that came too late to keep the device fed
+	uint32_t streamUnderruns;  // Callbacks where a stream ran dry before the end of its file
+
+	uint32_t triggers;   // Voices that have had their first frame mixed
+	float latencyMs;     // Mean time from starting a voice to its first frame being mixed
+	float maxLatencyMs;
+} NeHeSoundStats;
+
+bool NeHe_GetSoundStats(NeHeSoundStats* restrict stats, bool reset);
+// Log the stats from NeHe_UpdateSound every so often, resetting them each time. 0 stops logging
+void NeHe_LogSoundStats(unsigned intervalMs);
 
 #endif//SOUND_H
@@ -0,0 +1,206 @@
+/*
+ * SPDX-FileCopyrightText: (C) 2025 a dinosaur
+ * SPDX-License-Identifier: Zlib
+ */
+
+#include "spritebatch.h"
+
+
+bool NeHe_CreateSpriteBatch(NeHeContext* restrict ctx, NeHeSpriteBatch* restrict batch,
+	uint32_t instanceStride, uint32_t vertsPerSprite, uint32_t initialCapacity)
+{
+	SDL_zerop(batch);
+	initialCapacity = SDL_max(initialCapacity, 1);
+
+	if (!NeHe_CreateInstanceBuffer(ctx, &batch->instances, instanceStride, initialCapacity,
+		SDL_GPU_BUFFERUSAGE_VERTEX))
+	{
+		return false;
+	}
+	if ((batch->staging = SDL_malloc((size_t)instanceStride * initialCapacity)) == NULL)
+	{
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "SDL_malloc: %s", SDL_GetError());
+		NeHe_DestroyInstanceBuffer(ctx, &batch->instances);
+		return false;
+	}
+
+	batch->stride = instanceStride;
+	batch->vertsPerSprite = vertsPerSprite;
+	batch->stagingCapacity = initialCapacity;
+	return true;
+}
+
+void NeHe_DestroySpriteBatch(NeHeContext* restrict ctx, NeHeSpriteBatch* restrict batch)
+{
+	SDL_free(batch->runs);
+	SDL_free(batch->staging);
+	NeHe_DestroyInstanceBuffer(ctx, &batch->instances);
+	SDL_zerop(batch);
+}
+
+void NeHe_BeginSprites(NeHeSpriteBatch* batch)
+{
+	batch->numStaged = 0;
+	batch->numRuns = 0;
+}
+
+static bool NeHe_SameSpriteMaterial(const NeHeSpriteMaterial* restrict a, const NeHeSpriteMaterial* restrict b)
+{
+	return a->pipeline == b->pipeline && a->texture == b->texture && a->sampler == b->sampler && a->layer == b->layer;
+}
+
+void* NeHe_PushSprites(NeHeSpriteBatch* restrict batch, const NeHeSpriteMaterial* restrict material, uint32_t count)
+{
+	// Nothing to stage, don't open an empty run
+	if (count == 0)
+	{
+		return batch->staging + (size_t)batch->numStaged * batch->stride;
+	}
+
+	// Grow staging storage geometrically
+	if (batch->numStaged + count > batch->stagingCapacity)
+	{
+		uint32_t capacity = batch->stagingCapacity;
+		while (capacity < batch->numStaged + count)
+		{
+			capacity *= 2;
+		}
+		uint8_t* staging = SDL_realloc(batch->staging, (size_t)batch->stride * capacity);
+		if (!staging)
+		{
+			SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "SDL_realloc: %s", SDL_GetError());
+			return NULL;
+		}
+		batch->staging = staging;
+		batch->stagingCapacity = capacity;
+	}
+
+	void* sprites = batch->staging + (size_t)batch->numStaged * batch->stride;
+
+	// Extend the previous run if it has the same material, otherwise start a new one
+	if (batch->numRuns > 0 && NeHe_SameSpriteMaterial(&batch->runs[batch->numRuns - 1].material, material))
+	{
+		batch->runs[batch->numRuns - 1].count += count;
+	}
+	else
+	{
+		if (batch->numRuns == batch->runCapacity)
+		{
+			const unsigned capacity = batch->runCapacity ? batch->runCapacity * 2 : 16;
+			NeHeSpriteRun* runs = SDL_realloc(batch->runs, sizeof(NeHeSpriteRun) * capacity);
+			if (!runs)
+			{
+				SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "SDL_realloc: %s", SDL_GetError());
+				return NULL;
+			}
+			batch->runs = runs;
+			batch->runCapacity = capacity;
+		}
+		batch->runs[batch->numRuns] = (NeHeSpriteRun)
+		{
+			.material = *material,
+			.first = batch->numStaged,
+			.count = count,
+			.order = batch->numRuns
+		};
+		++batch->numRuns;
+	}
+
+	batch->numStaged += count;
+	return sprites;
+}
+
+static int SDLCALL NeHe_CompareSpriteRuns(const void* lhs, const void* rhs)
+{
+	const NeHeSpriteRun* a = lhs, * b = rhs;
+	if (a->material.layer != b->material.layer)
+	{
+		return a->material.layer < b->material.layer ? -1 : 1;
+	}
+	if (a->material.pipeline != b->material.pipeline)
+	{
+		return (uintptr_t)a->material.pipeline < (uintptr_t)b->material.pipeline ? -1 : 1;
+	}
+	if (a->material.texture != b->material.texture)
+	{
+		return (uintptr_t)a->material.texture < (uintptr_t)b->material.texture ? -1 : 1;
+	}
+	if (a->material.sampler != b->material.sampler)
+	{
+		return (uintptr_t)a->material.sampler < (uintptr_t)b->material.sampler ? -1 : 1;
+	}
+	return a->order < b->order ? -1 : (a->order > b->order);
+}
+
+bool NeHe_UploadSprites(NeHeContext* restrict ctx, NeHeSpriteBatch* restrict batch,
+	SDL_GPUCommandBuffer* restrict cmd)
+{
+	if (batch->numStaged == 0)
+	{
+		return true;
+	}
+
+	// Grow the GPU buffer to fit everything staged this frame
+	if (batch->numStaged > batch->instances.capacity &&
+		!NeHe_ResizeInstanceBuffer(ctx, &batch->instances, batch->stagingCapacity))
+	{
+		return false;
+	}
+
+	// Group runs by material, then lay their instances out contiguously in sorted order
+	SDL_qsort(batch->runs, batch->numRuns, sizeof(NeHeSpriteRun), NeHe_CompareSpriteRuns);
+	uint32_t offset = 0;
+	for (unsigned i = 0; i < batch->numRuns; ++i)
+	{
+		NeHeSpriteRun* run = &batch->runs[i];
+		// Instances that are identical to last frame's are skipped by the dirty tracking
+		NeHe_WriteInstances(&batch->instances, offset, run->count, batch->staging + (size_t)run->first * batch->stride);
+		run->first = offset;
+		offset += run->count;
+	}
+
+	return NeHe_UploadInstances(ctx, &batch->instances, cmd);
+}
+
+unsigned NeHe_DrawSprites(const NeHeSpriteBatch* restrict batch, SDL_GPURenderPass* restrict pass,
+	uint32_t vertexSlot)
+{
+	const NeHeSpriteMaterial* bound = NULL;
+	unsigned numDraws = 0;
+	for (unsigned i = 0; i < batch->numRuns;)
+	{
+		const NeHeSpriteRun* run = &batch->runs[i];
+
+		// Sorted runs that share a material are contiguous, so they merge into one draw
+		uint32_t count = run->count;
+		while (++i < batch->numRuns && NeHe_SameSpriteMaterial(&batch->runs[i].material, &run->material))
+		{
+			count += batch->runs[i].count;
+		}
+
+		// Only rebind what changed since the previous draw
+		if (!bound || bound->pipeline != run->material.pipeline)
+		{
+			SDL_BindGPUGraphicsPipeline(pass, run->material.pipeline);
+		}
+		if (!bound || bound->texture != run->material.texture || bound->sampler != run->material.sampler)
+		{
+			SDL_BindGPUFragmentSamplers(pass, 0, &(const SDL_GPUTextureSamplerBinding)
+			{
+				.texture = run->material.texture,
+				.sampler = run->material.sampler
+			}, 1);
+		}
+		bound = &run->material;
+
+		// Offset the binding rather than using first_instance, which isn't consistent across backends
+		SDL_BindGPUVertexBuffers(pass, vertexSlot, &(const SDL_GPUBufferBinding)
+		{
+			.buffer = batch->instances.buffer,
+			.offset = run->first * batch->stride
+		}, 1);
+		SDL_DrawGPUPrimitives(pass, batch->vertsPerSprite, count, 0, 0);
+		++numDraws;
+	}
+	return numDraws;
+}
@@ -0,0 +1,42 @@
+#ifndef SPRITEBATCH_H
+#define SPRITEBATCH_H
+
+#include "instancebuffer.h"
+
+typedef struct
+{
+	SDL_GPUGraphicsPipeline* pipeline;
+	SDL_GPUTexture* texture;
+	SDL_GPUSampler* sampler;
+	int layer;  // Lower layers are drawn first, within a layer sprites are grouped by pipeline & texture
+} NeHeSpriteMaterial;
+
+typedef struct
+{
+	NeHeSpriteMaterial material;
+	uint32_t first, count;  // Span of staged instances
+	uint32_t order;         // Submission order, keeps sorting stable
+} NeHeSpriteRun;
+
+typedef struct
+{
+	NeHeInstanceBuffer instances;
+	uint8_t* staging;
+	NeHeSpriteRun* runs;
+	uint32_t stride, vertsPerSprite;
+	uint32_t numStaged, stagingCapacity;
+	unsigned numRuns, runCapacity;
+} NeHeSpriteBatch;
+
+bool NeHe_CreateSpriteBatch(NeHeContext* restrict ctx, NeHeSpriteBatch* restrict batch,
+	uint32_t instanceStride, uint32_t vertsPerSprite, uint32_t initialCapacity);
+void NeHe_DestroySpriteBatch(NeHeContext* restrict ctx, NeHeSpriteBatch* restrict batch);
+
+void NeHe_BeginSprites(NeHeSpriteBatch* batch);
+void* NeHe_PushSprites(NeHeSpriteBatch* restrict batch, const NeHeSpriteMaterial* restrict material, uint32_t count);
+bool NeHe_UploadSprites(NeHeContext* restrict ctx, NeHeSpriteBatch* restrict batch,
+	SDL_GPUCommandBuffer* restrict cmd);
+unsigned NeHe_DrawSprites(const NeHeSpriteBatch* restrict batch, SDL_GPURenderPass* restrict pass,
+	uint32_t vertexSlot);
+
+#endif//SPRITEBATCH_H
@@ -0,0 +1,400 @@
+/*
+ * SPDX-FileCopyrightText: (C) 2025 a dinosaur
+ * SPDX-License-Identifier: Zlib
+ */
+
+#include "text.h"
+
+
+static bool NeHe_GrowTextArray(void** array, uint32_t* restrict capacity, uint32_t needed, size_t elemSize)
+{
+	if (needed <= *capacity)
+	{
+		return true;
+	}
+	uint32_t newCapacity = SDL_max(*capacity, 16);
+	while (newCapacity < needed)
+	{
+		newCapacity *= 2;
+	}
+	void* newArray = SDL_realloc(*array, elemSize * newCapacity);
+	if (!newArray)
+	{
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "SDL_realloc: %s", SDL_GetError());
+		return false;
+	}
+	*array = newArray;
+	*capacity = newCapacity;
+	return true;
+}
+
+static bool NeHe_ReserveGlyphs(NeHeText* text, uint32_t needed)
+{
+	if (needed <= text->glyphCapacity)
+	{
+		return true;
+	}
+	uint32_t capacity = text->glyphCapacity;
+	if (!NeHe_GrowTextArray((void**)&text->glyphs, &capacity, needed, sizeof(NeHeTextGlyph)))
+	{
+		return false;
+	}
+	capacity = text->glyphCapacity;
+	if (!NeHe_GrowTextArray((void**)&text->shelves, &capacity, needed, sizeof(uint16_t)))
+	{
+		return false;
+	}
+	text->glyphCapacity = capacity;
+	return true;
+}
+
+static uint32_t NeHe_DecodeUTF8(const char* string, uint32_t length, uint32_t* restrict offset)
+{
+	const unsigned char* p = (const unsigned char*)string + *offset;
+	const unsigned char* end = (const unsigned char*)string + length;
+	uint32_t c = *p++;
+	unsigned extra = 0;
+	if (c >= 0xF0 && c < 0xF8) { c &= 0x07; extra = 3; }
+	else if (c >= 0xE0) { c &= 0x0F; extra = 2; }
+	else if (c >= 0xC0) { c &= 0x1F; extra = 1; }
+	else if (c >= 0x80) { c = 0xFFFD; }
+	for (; extra > 0; --extra, ++p)
+	{
+		// Truncated sequences become a replacement character
+		if (p == end || (*p & 0xC0) != 0x80)
+		{
+			c = 0xFFFD;
+			break;
+		}
+		c = c << 6 | (*p & 0x3F);
+	}
+	*offset = (uint32_t)(p - (const unsigned char*)string);
+	return c;
+}
+
+
+void NeHe_CreateTrueTypeFont(NeHeFont* restrict font, NeHeGlyphCache* restrict cache, unsigned pixelHeight)
+{
+	*font = (NeHeFont)
+	{
+		.type = NEHE_FONT_TRUETYPE,
+		.cache = cache,
+		.pixelHeight = pixelHeight
+	};
+}
+
+bool NeHe_LoadGridFont(NeHeContext* restrict ctx, NeHeFont* restrict font, const char* restrict bmpResourcePath,
+	uint16_t cellWidth, uint16_t cellHeight, uint32_t firstChar, uint32_t numChars, float advance)
+{
+	char* path = NeHe_ResourcePath(ctx, bmpResourcePath);
+	if (!path)
+	{
+		return false;
+	}
+	SDL_Surface* image = SDL_LoadBMP(path);
+	SDL_free(path);
+	if (!image)
+	{
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "SDL_LoadBMP: %s", SDL_GetError());
+		return false;
+	}
+	SDL_Surface* rgb = SDL_ConvertSurface(image, SDL_PIXELFORMAT_RGB24);
+	SDL_DestroySurface(image);
+	if (!rgb)
+	{
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "SDL_ConvertSurface: %s", SDL_GetError());
+		return false;
+	}
+
+	// Glyphs are white on black, so any channel works as coverage
+	const size_t size = (size_t)rgb->w * (size_t)rgb->h;
+	uint8_t* coverage = SDL_malloc(size);
+	if (!coverage)
+	{
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "SDL_malloc: %s", SDL_GetError());
+		SDL_DestroySurface(rgb);
+		return false;
+	}
+	for (int y = 0; y < rgb->h; ++y)
+	{
+		const uint8_t* src = (const uint8_t*)rgb->pixels + (size_t)rgb->pitch * (size_t)y;
+		for (int x = 0; x < rgb->w; ++x)
+		{
+			coverage[(size_t)rgb->w * (size_t)y + (size_t)x] = src[3 * x];
+		}
+	}
+
+	*font = (NeHeFont)
+	{
+		.type = NEHE_FONT_GRID,
+		.width = (uint32_t)rgb->w, .height = (uint32_t)rgb->h,
+		.cellWidth = cellWidth, .cellHeight = cellHeight,
+		.columns = (uint16_t)((uint32_t)rgb->w / cellWidth),
+		.firstChar = firstChar, .numChars = numChars,
+		.advance = advance
+	};
+	SDL_DestroySurface(rgb);
+	font->texture = NeHe_CreateGPUTextureFromPixels(ctx, coverage, size, &(const SDL_GPUTextureCreateInfo)
+	{
+		.type = SDL_GPU_TEXTURETYPE_2D,
+		.format = SDL_GPU_TEXTUREFORMAT_A8_UNORM,
+		.usage = SDL_GPU_TEXTUREUSAGE_SAMPLER,
+		.width = font->width, .height = font->height, .layer_count_or_depth = 1,
+		.num_levels = 1,
+		.sample_count = SDL_GPU_SAMPLECOUNT_1
+	}, false);
+	SDL_free(coverage);
+	return font->texture != NULL;
+}
+
+void NeHe_DestroyFont(NeHeContext* restrict ctx, NeHeFont* restrict font)
+{
+	SDL_ReleaseGPUTexture(ctx->device, font->texture);
+	SDL_zerop(font);
+}
+
+SDL_GPUTexture* NeHe_GetFontTexture(const NeHeFont* font)
+{
+	return font->type == NEHE_FONT_TRUETYPE ? font->cache->texture : font->texture;
+}
+
+static inline uint32_t NeHe_FontGeneration(const NeHeFont* font)
+{
+	return font->type == NEHE_FONT_TRUETYPE ? font->cache->generation : 0;
+}
+
+// Look up a codepoint, returns false for characters the font doesn't have
+static bool NeHe_LayoutGlyph(const NeHeFont* restrict font, uint32_t c, float x,
+	NeHeTextGlyph* restrict outGlyph, uint16_t* restrict outShelf, float* restrict outAdvance)
+{
+	switch (font->type)
+	{
+	case NEHE_FONT_TRUETYPE:
+	{
+		NeHeGlyph glyph;
+		if (!NeHe_GetGlyph(font->cache, c, font->pixelHeight, &glyph))
+		{
+			return false;
+		}
+		const float scale = NeHe_GlyphScale(font->cache, font->pixelHeight);
+		*outGlyph = (NeHeTextGlyph)
+		{
+			.srcX = glyph.x, .srcY = glyph.y,
+			.srcW = glyph.w, .srcH = glyph.h,
+			.dstX = x + scale * (float)glyph.xOffset, .dstY = -scale * (float)glyph.yOffset,
+			.dstW = scale * (float)glyph.w, .dstH = -scale * (float)glyph.h
+		};
+		*outShelf = glyph.shelf;
+		*outAdvance = scale * glyph.advance;
+		return true;
+	}
+	case NEHE_FONT_GRID:
+	{
+		if (c < font->firstChar || c - font->firstChar >= font->numChars)
+		{
+			return false;
+		}
+		// Cells sit on the baseline
+		const uint32_t cell = font->firstCell + c - font->firstChar;
+		*outGlyph = (NeHeTextGlyph)
+		{
+			.srcX = (float)(cell % font->columns * font->cellWidth),
+			.srcY = (float)(cell / font->columns * font->cellHeight),
+			.srcW = font->cellWidth, .srcH = font->cellHeight,
+			.dstX = x, .dstY = font->cellHeight,
+			.dstW = font->cellWidth, .dstH = -(float)font->cellHeight
+		};
+		*outShelf = UINT16_MAX;
+		*outAdvance = font->advance;
+		return true;
+	}
+	}
+	return false;
+}
+
+
+bool NeHe_CreateText(NeHeText* restrict text, const NeHeFont* restrict font)
+{
+	SDL_zerop(text);
+	text->font = font;
+	text->generation = NeHe_FontGeneration(font);
+	if (!NeHe_GrowTextArray((void**)&text->string, &text->stringCapacity, 1, 1))
+	{
+		return false;
+	}
+	text->string[0] = '\0';
+	return true;
+}
+
+void NeHe_DestroyText(NeHeText* text)
+{
+	SDL_free(text->cursors);
+	SDL_free(text->shelves);
+	SDL_free(text->glyphs);
+	SDL_free(text->string);
+	SDL_zerop(text);
+}
+
+bool NeHe_SetText(NeHeText* restrict text, const char* restrict string)
+{
+	const uint32_t length = (uint32_t)SDL_strlen(string);
+
+	// Find where the new string starts to differ, evicted glyphs mean everything has to be looked up again
+	uint32_t same = 0;
+	if (text->generation == NeHe_FontGeneration(text->font))
+	{
+		const uint32_t common = SDL_min(length, text->length);
+		while (same < common && string[same] == text->string[same])
+		{
+			++same;
+		}
+	}
+	text->generation = NeHe_FontGeneration(text->font);
+
+	// Rewind to the codepoint containing the first difference, the glyphs before it are kept as they are
+	const bool unchanged = same == length && length == text->length;
+	uint32_t numCursors = text->numCursors;
+	if (!unchanged)
+	{
+		while (numCursors > 0 && text->cursors[numCursors - 1].offset > same)
+		{
+			--numCursors;
+		}
+		numCursors = numCursors > 0 ? numCursors - 1 : 0;
+	}
+	const NeHeTextCursor start = numCursors < text->numCursors ? text->cursors[numCursors]
+		: (NeHeTextCursor){ .offset = text->length, .glyph = text->numGlyphs, .x = text->width };
+	for (uint32_t i = 0; text->font->type == NEHE_FONT_TRUETYPE && i < start.glyph; ++i)
+	{
+		NeHe_TouchGlyph(text->font->cache, text->shelves[i]);
+	}
+	if (unchanged)
+	{
+		return true;
+	}
+
+	if (!NeHe_GrowTextArray((void**)&text->string, &text->stringCapacity, length + 1, 1))
+	{
+		return false;
+	}
+	SDL_memcpy(text->string + start.offset, string + start.offset, length + 1 - start.offset);
+	text->length = length;
+	text->numCursors = numCursors;
+	text->numGlyphs = start.glyph;
+
+	// Lay out the rest of the string
+	float x = start.x;
+	for (uint32_t offset = start.offset; offset < length;)
+	{
+		if (!NeHe_GrowTextArray((void**)&text->cursors, &text->cursorCapacity, text->numCursors + 1,
+				sizeof(NeHeTextCursor))
+			|| !NeHe_ReserveGlyphs(text, text->numGlyphs + 1))
+		{
+			text->length = 0;  // Lay everything out again next time
+			return false;
+		}
+		text->cursors[text->numCursors++] = (NeHeTextCursor){ .offset = offset, .glyph = text->numGlyphs, .x = x };
+
+		NeHeTextGlyph* glyph = &text->glyphs[text->numGlyphs];
+		float advance;
+		const uint32_t c = NeHe_DecodeUTF8(text->string, length, &offset);
+		if (c < 0x20 || !NeHe_LayoutGlyph(text->font, c, x, glyph, &text->shelves[text->numGlyphs], &advance))
+		{
+			continue;
+		}
+		// Blank glyphs like space only move the pen
+		if (glyph->srcW > 0.0f && glyph->srcH > 0.0f)
+		{
+			++text->numGlyphs;
+		}
+		x += advance;
+	}
+	text->width = x;
+	return true;
+}
+
+bool NeHe_TextPrintf(NeHeText* restrict text, SDL_PRINTF_FORMAT_STRING const char* restrict fmt, ...)
+{
+	char buffer[256];
+	va_list args;
+
+	va_start(args, fmt);
+		const int length = SDL_vsnprintf(buffer, sizeof(buffer), fmt, args);
+	va_end(args);
+	if (length < 0)
+	{
+		return false;
+	}
+	if ((size_t)length < sizeof(buffer))
+	{
+		return NeHe_SetText(text, buffer);
+	}
+
+	// Too long for the stack
+	char* string;
+	va_start(args, fmt);
+		const int allocLength = SDL_vasprintf(&string, fmt, args);
+	va_end(args);
+	if (allocLength < 0)
+	{
+		return false;
+	}
+	const bool result = NeHe_SetText(text, string);
+	SDL_free(string);
+	return result;
+}
+
+static inline uint16_t NeHe_PackUnorm16(float v)
+{
+	return (uint16_t)(SDL_clamp(v, 0.0f, 1.0f) * (float)UINT16_MAX + 0.5f);
+}
+
+static inline uint8_t NeHe_PackUnorm8(float v)
+{
+	return (uint8_t)(SDL_clamp(v, 0.0f, 1.0f) * (float)UINT8_MAX + 0.5f);
+}
+
+static inline int16_t NeHe_PackPixel(float v)
+{
+	return (int16_t)SDL_clamp(SDL_lroundf(v), INT16_MIN, INT16_MAX);
+}
+
+bool NeHe_PushText(NeHeSpriteBatch* restrict batch, const NeHeSpriteMaterial* restrict material,
+	const NeHeText* restrict text, float x, float y, const float color[4])
+{
+	if (text->numGlyphs == 0)
+	{
+		return true;
+	}
+
+	NeHeSpriteMaterial fontMaterial = *material;
+	fontMaterial.texture = NeHe_GetFontTexture(text->font);
+	NeHeTextInstance* instances = NeHe_PushSprites(batch, &fontMaterial, text->numGlyphs);
+	if (!instances)
+	{
+		return false;
+	}
+
+	// Atlas coordinates are normalised here as a TrueType atlas can grow between frames
+	const NeHeFont* font = text->font;
+	const uint32_t width = font->type == NEHE_FONT_TRUETYPE ? font->cache->width : font->width;
+	const uint32_t height = font->type == NEHE_FONT_TRUETYPE ? font->cache->height : font->height;
+	const float invW = 1.0f / (float)width, invH = 1.0f / (float)height;
+	const uint8_t packedColor[4] =
+	{
+		NeHe_PackUnorm8(color[0]), NeHe_PackUnorm8(color[1]), NeHe_PackUnorm8(color[2]), NeHe_PackUnorm8(color[3])
+	};
+	for (uint32_t i = 0; i < text->numGlyphs; ++i)
+	{
+		const NeHeTextGlyph* glyph = &text->glyphs[i];
+		instances[i] = (NeHeTextInstance)
+		{
+			.srcX = NeHe_PackUnorm16(invW * glyph->srcX), .srcY = NeHe_PackUnorm16(invH * glyph->srcY),
+			.srcW = NeHe_PackUnorm16(invW * glyph->srcW), .srcH = NeHe_PackUnorm16(invH * glyph->srcH),
+			.dstX = NeHe_PackPixel(x + glyph->dstX), .dstY = NeHe_PackPixel(y + glyph->dstY),
+			.dstW = NeHe_PackPixel(glyph->dstW), .dstH = NeHe_PackPixel(glyph->dstH),
+			.color = { packedColor[0], packedColor[1], packedColor[2], packedColor[3] }
+		};
+	}
+	return true;
+}
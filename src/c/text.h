@@ -0,0 +1,95 @@
+#ifndef TEXT_H
+#define TEXT_H
+
+#include "glyphcache.h"
+#include "spritebatch.h"
+
+typedef enum
+{
+	NEHE_FONT_TRUETYPE,  // Glyphs rasterised on demand into a glyph cache
+	NEHE_FONT_GRID       // Fixed size cells in a bitmap, like the original NeHe fonts
+} NeHeFontType;
+
+typedef struct
+{
+	NeHeFontType type;
+
+	// TrueType fonts
+	NeHeGlyphCache* cache;
+	unsigned pixelHeight;
+
+	// Grid fonts, copies of a grid font share its texture and may pick a different set of cells
+	SDL_GPUTexture* texture;
+	uint32_t width, height;
+	uint16_t cellWidth, cellHeight, columns;
+	uint16_t firstCell;
+	uint32_t firstChar, numChars;
+	float advance;
+} NeHeFont;
+
+// Laid out glyph, kept from frame to frame
+typedef struct
+{
+	float srcX, srcY, srcW, srcH;  // In atlas texels, which stay valid when the atlas grows
+	float dstX, dstY, dstW, dstH;  // Relative to the start of the baseline, Y up
+} NeHeTextGlyph;
+
+// Instance as drawn by the text shader, packed to 20 bytes a glyph
+typedef struct
+{
+	uint16_t srcX, srcY, srcW, srcH;  // Normalised atlas coordinates (USHORT4_NORM)
+	int16_t dstX, dstY, dstW, dstH;   // Whole pixels (SHORT4)
+	uint8_t color[4];                 // RGBA (UBYTE4_NORM)
+} NeHeTextInstance;
+
+// Layout state before each codepoint, lets a changed string be laid out again from where it differs
+typedef struct
+{
+	uint32_t offset;  // Byte offset into the string
+	uint32_t glyph;   // Glyphs laid out before this codepoint
+	float x;          // Pen position
+} NeHeTextCursor;
+
+typedef struct
+{
+	const NeHeFont* font;
+	uint32_t generation;  // Cache generation the glyphs were laid out against
+
+	char* string;
+	uint32_t length, stringCapacity;
+
+	NeHeTextGlyph* glyphs;
+	uint16_t* shelves;  // Atlas shelf of each glyph, touched every frame the text is kept
+	uint32_t numGlyphs, glyphCapacity;
+
+	NeHeTextCursor* cursors;
+	uint32_t numCursors, cursorCapacity;
+
+	float width;  // Pen advance of the whole string
+} NeHeText;
+
+void NeHe_CreateTrueTypeFont(NeHeFont* restrict font, NeHeGlyphCache* restrict cache, unsigned pixelHeight);
+// Load a bitmap of white glyphs on black in a grid of cells, the red channel becomes coverage
+bool NeHe_LoadGridFont(NeHeContext* restrict ctx, NeHeFont* restrict font, const char* restrict bmpResourcePath,
+	uint16_t cellWidth, uint16_t cellHeight, uint32_t firstChar, uint32_t numChars, float advance);
+void NeHe_DestroyFont(NeHeContext* restrict ctx, NeHeFont* restrict font);
+SDL_GPUTexture* NeHe_GetFontTexture(const NeHeFont* font);
+
+bool NeHe_CreateText(NeHeText* restrict text, const NeHeFont* restrict font);
+void NeHe_DestroyText(NeHeText* text);
+
+// Replace a text's UTF-8 string, glyphs are only laid out again from the first byte that differs from the previous
+// string. Call every frame the text is drawn, before updating the glyph cache
+bool NeHe_SetText(NeHeText* restrict text, const char* restrict string);
+#ifdef __GNUC__
+__attribute__((format(printf, 2, 3)))
+#endif
+bool NeHe_TextPrintf(NeHeText* restrict text, SDL_PRINTF_FORMAT_STRING const char* restrict fmt, ...);
+
+// Add a text's glyphs to a sprite batch at a position & colour, using the given material with the font's texture.
+// Text in the same font is merged into a single draw, call after updating the glyph cache. Glyphs are snapped to
+// whole pixels and the colour is clamped to [0, 1]
+bool NeHe_PushText(NeHeSpriteBatch* restrict batch, const NeHeSpriteMaterial* restrict material,
+	const NeHeText* restrict text, float x, float y, const float color[4]);
+
+#endif//TEXT_H
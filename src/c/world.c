@@ -0,0 +1,1389 @@
+/*
+ * SPDX-FileCopyrightText: (C) 2025 a dinosaur
+ * SPDX-License-Identifier: Zlib
+ */
+
+#include "world.h"
+#include "meshopt.h"
+
+#define WORLD_CACHE_MAGIC   0x57444C57u  // "WLDW" when read back with the same byte order
+#define WORLD_CACHE_VERSION 4u
+
+// Vertices closer than this in position & texture coordinates are merged
+#define WORLD_WELD_EPSILON (1.0f / 4096.0f)
+
+// Most triangles in a BVH leaf, each leaf is a cluster that's culled & drawn as a whole
+#define WORLD_CLUSTER_TRIANGLES 128
+// The tree is split at the median so its depth stays well below this
+#define WORLD_BVH_STACK 64
+
+// Limits on portal traversal, past these every sector is frustum culled instead
+#define WORLD_MAX_PORTAL_DEPTH  16
+#define WORLD_MAX_PORTAL_VISITS 64
+// Enough for a portal clipped by every plane of the frustum it was seen through
+#define WORLD_MAX_FRUSTUM_PLANES 16
+
+typedef struct
+{
+	uint32_t magic, version;
+	uint32_t vertexSize, indexSize;
+	uint32_t numVertices, numIndices;
+	uint32_t nodeSize, numNodes;
+	uint32_t sectorSize, numSectors;
+	uint32_t portalSize, numPortals;
+	int64_t sourceSize;  // Cache is stale once the source file changes
+	int64_t sourceTime;
+} WorldCacheHeader;
+
+typedef struct
+{
+	const char* p, * end;
+	unsigned line;
+} WorldScanner;
+
+typedef struct
+{
+	WorldTriangle* tris;
+	WorldSector* sectors;
+	WorldPortal* portals;
+	unsigned numTris, triCapacity;
+	unsigned numSectors, numPortals;
+} WorldSource;
+
+
+static void World_SkipSpace(WorldScanner* s)
+{
+	while (s->p < s->end)
+	{
+		const char c = *s->p;
+		if (c == '\n')
+		{
+			++s->line;
+			++s->p;
+		}
+		else if (c == ' ' || c == '\t' || c == '\r')
+		{
+			++s->p;
+		}
+		else if (c == '/')
+		{
+			// Comment runs to the end of the line
+			while (s->p < s->end && *s->p != '\n')
+			{
+				++s->p;
+			}
+		}
+		else
+		{
+			break;
+		}
+	}
+}
+
+static inline bool World_IsDigit(char c)
+{
+	return c >= '0' && c <= '9';
+}
+
+static bool World_ScanKeyword(WorldScanner* restrict s, const char* restrict keyword)
+{
+	World_SkipSpace(s);
+	const size_t len = SDL_strlen(keyword);
+	if ((size_t)(s->end - s->p) < len || SDL_memcmp(s->p, keyword, len) != 0)
+	{
+		return false;
+	}
+	s->p += len;
+	return true;
+}
+
+static bool World_ScanUnsigned(WorldScanner* restrict s, unsigned* restrict out)
+{
+	World_SkipSpace(s);
+	if (s->p == s->end || !World_IsDigit(*s->p))
+	{
+		return false;
+	}
+	uint64_t value = 0;
+	while (s->p < s->end && World_IsDigit(*s->p))
+	{
+		value = value * 10 + (uint64_t)(*s->p++ - '0');
+		if (value > UINT32_MAX)
+		{
+			return false;
+		}
+	}
+	*out = (unsigned)value;
+	return true;
+}
+
+static bool World_ScanFloat(WorldScanner* restrict s, float* restrict out)
+{
+	// Powers of ten that are exactly representable as doubles
+	static const double pow10[] =
+	{
+		1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+
+	World_SkipSpace(s);
+	const char* p = s->p, * end = s->end;
+
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+'))
+	{
+		negative = *p++ == '-';
+	}
+
+	// Accumulate significant digits into an integer, the decimal point just moves the exponent
+	uint64_t mantissa = 0;
+	int exponent = 0, numDigits = 0;
+	for (; p < end && World_IsDigit(*p); ++p, ++numDigits)
+	{
+		if (mantissa < UINT64_C(100000000000000000))
+			mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+		else
+			++exponent;
+	}
+	if (p < end && *p == '.')
+	{
+		for (++p; p < end && World_IsDigit(*p); ++p, ++numDigits)
+		{
+			if (mantissa < UINT64_C(100000000000000000))
+			{
+				mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+				--exponent;
+			}
+		}
+	}
+	if (numDigits == 0)
+	{
+		return false;
+	}
+	if (p < end && (*p == 'e' || *p == 'E'))
+	{
+		++p;
+		bool negativeExp = false;
+		if (p < end && (*p == '-' || *p == '+'))
+		{
+			negativeExp = *p++ == '-';
+		}
+		if (p == end || !World_IsDigit(*p))
+		{
+			return false;
+		}
+		int e = 0;
+		for (; p < end && World_IsDigit(*p); ++p)
+		{
+			e = SDL_min(e * 10 + (*p - '0'), 9999);
+		}
+		exponent += negativeExp ? -e : e;
+	}
+
+	double value = (double)mantissa;
+	if (exponent < 0)
+	{
+		value = -exponent < (int)SDL_arraysize(pow10) ? value / pow10[-exponent] : value * SDL_pow(10.0, exponent);
+	}
+	else if (exponent > 0)
+	{
+		value = exponent < (int)SDL_arraysize(pow10) ? value * pow10[exponent] : value * SDL_pow(10.0, exponent);
+	}
+	*out = (float)(negative ? -value : value);
+	s->p = p;
+	return true;
+}
+
+static bool World_ScanTriangles(WorldScanner* restrict s, WorldSource* restrict src, size_t length)
+{
+	unsigned numTris;
+	if (!World_ScanKeyword(s, "NUMPOLLIES") || !World_ScanUnsigned(s, &numTris))
+	{
+		return SDL_SetError("Expected NUMPOLLIES on line %u", s->line);
+	}
+	// Each vertex takes at least 10 characters, so a count that can't fit is garbage rather than a huge allocation
+	if ((uint64_t)numTris * 3 * 10 > length)
+	{
+		return SDL_SetError("NUMPOLLIES %u is larger than the file could hold", numTris);
+	}
+
+	// Sectors append to one shared triangle array
+	if (src->numTris + numTris > src->triCapacity)
+	{
+		unsigned capacity = SDL_max(src->triCapacity, 64);
+		while (capacity < src->numTris + numTris)
+		{
+			capacity *= 2;
+		}
+		WorldTriangle* tris = SDL_realloc(src->tris, sizeof(WorldTriangle) * capacity);
+		if (!tris)
+		{
+			return false;
+		}
+		src->tris = tris;
+		src->triCapacity = capacity;
+	}
+	for (unsigned tri = 0; tri < numTris; ++tri)
+	{
+		for (unsigned vtx = 0; vtx < 3; ++vtx)
+		{
+			WorldVertex* v = &src->tris[src->numTris + tri].vertices[vtx];
+			if (!World_ScanFloat(s, &v->x) || !World_ScanFloat(s, &v->y) || !World_ScanFloat(s, &v->z)
+				|| !World_ScanFloat(s, &v->u) || !World_ScanFloat(s, &v->v))
+			{
+				return SDL_SetError("Malformed vertex on line %u", s->line);
+			}
+		}
+	}
+	src->numTris += numTris;
+	return true;
+}
+
+static bool World_ScanPortals(WorldScanner* restrict s, WorldSource* restrict src, size_t length)
+{
+	unsigned numPortals;
+	if (!World_ScanUnsigned(s, &numPortals))
+	{
+		return SDL_SetError("Expected portal count on line %u", s->line);
+	}
+	if ((uint64_t)numPortals * 24 > length)
+	{
+		return SDL_SetError("NUMPORTALS %u is larger than the file could hold", numPortals);
+	}
+
+	WorldPortal* portals = SDL_realloc(src->portals, sizeof(WorldPortal) * SDL_max(src->numPortals + numPortals, 1));
+	if (!portals)
+	{
+		return false;
+	}
+	src->portals = portals;
+	for (unsigned i = 0; i < numPortals; ++i)
+	{
+		WorldPortal* portal = &src->portals[src->numPortals + i];
+		SDL_zerop(portal);
+		if (!World_ScanKeyword(s, "PORTAL") || !World_ScanUnsigned(s, &portal->sector)
+			|| !World_ScanUnsigned(s, &portal->numVertices))
+		{
+			return SDL_SetError("Expected PORTAL on line %u", s->line);
+		}
+		if (portal->numVertices < 3 || portal->numVertices > WORLD_MAX_PORTAL_VERTICES)
+		{
+			return SDL_SetError("Portal on line %u must have 3 to %d vertices", s->line, WORLD_MAX_PORTAL_VERTICES);
+		}
+		for (unsigned vtx = 0; vtx < portal->numVertices; ++vtx)
+		{
+			Vec3f* v = &portal->vertices[vtx];
+			if (!World_ScanFloat(s, &v->x) || !World_ScanFloat(s, &v->y) || !World_ScanFloat(s, &v->z))
+			{
+				return SDL_SetError("Malformed portal vertex on line %u", s->line);
+			}
+		}
+	}
+	src->numPortals += numPortals;
+	return true;
+}
+
+static bool World_Parse(WorldSource* restrict src, const char* restrict text, size_t length)
+{
+	WorldScanner s = { .p = text, .end = text + length, .line = 1 };
+
+	// Plain NeHe worlds are a single sector without any portals
+	unsigned numSectors = 1;
+	const bool multiSector = World_ScanKeyword(&s, "NUMSECTORS");
+	if (multiSector && !World_ScanUnsigned(&s, &numSectors))
+	{
+		return SDL_SetError("Expected sector count on line %u", s.line);
+	}
+	if (numSectors == 0 || (uint64_t)numSectors * 16 > length)
+	{
+		return SDL_SetError("NUMSECTORS %u is out of range", numSectors);
+	}
+	src->sectors = SDL_calloc(numSectors, sizeof(WorldSector));
+	if (!src->sectors)
+	{
+		return false;
+	}
+	src->numSectors = numSectors;
+
+	for (unsigned i = 0; i < numSectors; ++i)
+	{
+		WorldSector* sector = &src->sectors[i];
+		if (multiSector && !World_ScanKeyword(&s, "SECTOR"))
+		{
+			return SDL_SetError("Expected SECTOR on line %u", s.line);
+		}
+		sector->firstIndex = 3 * src->numTris;
+		if (!World_ScanTriangles(&s, src, length))
+		{
+			return false;
+		}
+		sector->numIndices = 3 * src->numTris - sector->firstIndex;
+		sector->firstPortal = src->numPortals;
+		if (multiSector && World_ScanKeyword(&s, "NUMPORTALS") && !World_ScanPortals(&s, src, length))
+		{
+			return false;
+		}
+		sector->numPortals = src->numPortals - sector->firstPortal;
+	}
+
+	for (unsigned i = 0; i < src->numPortals; ++i)
+	{
+		if (src->portals[i].sector >= numSectors)
+		{
+			return SDL_SetError("Portal leads to missing sector %u", src->portals[i].sector);
+		}
+	}
+	return true;
+}
+
+static void World_FreeSource(WorldSource* src)
+{
+	SDL_free(src->portals);
+	SDL_free(src->sectors);
+	SDL_free(src->tris);
+	SDL_zerop(src);
+}
+
+typedef struct
+{
+	int32_t q[5];
+} WorldWeldKey;
+
+static WorldWeldKey World_WeldKey(const WorldVertex* v)
+{
+	// Snap to an epsilon sized grid so nearly equal vertices hash & compare equal
+	const float scale = 1.0f / WORLD_WELD_EPSILON;
+	const float f[5] = { v->x, v->y, v->z, v->u, v->v };
+	WorldWeldKey key;
+	for (int i = 0; i < 5; ++i)
+	{
+		key.q[i] = (int32_t)SDL_clamp(SDL_floorf(f[i] * scale + 0.5f), -2e9f, 2e9f);
+	}
+	return key;
+}
+
+static uint32_t World_HashWeldKey(const WorldWeldKey* key)
+{
+	uint32_t hash = 2166136261u;
+	for (int i = 0; i < 5; ++i)
+	{
+		hash = (hash ^ (uint32_t)key->q[i]) * 16777619u;
+		hash ^= hash >> 15;
+	}
+	return hash;
+}
+
+static bool World_Weld(World* restrict world, const WorldTriangle* restrict tris, unsigned numTris)
+{
+	const unsigned numIndices = 3 * numTris;
+
+	// Open addressed table of unique vertex numbers, kept at most half full
+	uint32_t tableSize = 16;
+	while (tableSize < 2 * numIndices)
+	{
+		tableSize *= 2;
+	}
+	uint32_t* table = SDL_malloc(sizeof(uint32_t) * tableSize);
+	WorldWeldKey* keys = SDL_malloc(sizeof(WorldWeldKey) * numIndices);
+	WorldVertex* vertices = SDL_malloc(sizeof(WorldVertex) * numIndices);
+	uint32_t* indices = SDL_malloc(sizeof(uint32_t) * numIndices);
+	if (!table || !keys || !vertices || !indices)
+	{
+		SDL_free(indices);
+		SDL_free(vertices);
+		SDL_free(keys);
+		SDL_free(table);
+		return false;
+	}
+	SDL_memset(table, 0xFF, sizeof(uint32_t) * tableSize);
+
+	uint32_t numVertices = 0;
+	for (unsigned i = 0; i < numIndices; ++i)
+	{
+		const WorldVertex* v = &tris[i / 3].vertices[i % 3];
+		const WorldWeldKey key = World_WeldKey(v);
+		uint32_t slot = World_HashWeldKey(&key) & (tableSize - 1);
+		while (table[slot] != UINT32_MAX && SDL_memcmp(&keys[table[slot]], &key, sizeof(key)) != 0)
+		{
+			slot = (slot + 1) & (tableSize - 1);
+		}
+		if (table[slot] == UINT32_MAX)
+		{
+			table[slot] = numVertices;
+			keys[numVertices] = key;
+			vertices[numVertices++] = *v;
+		}
+		indices[i] = table[slot];
+	}
+	SDL_free(keys);
+	SDL_free(table);
+
+	// Shrink to fit, narrowing indices to 16-bit when they fit
+	const unsigned indexSize = numVertices <= UINT16_MAX + 1u ? sizeof(uint16_t) : sizeof(uint32_t);
+	if (indexSize == sizeof(uint16_t))
+	{
+		uint16_t* narrow = (uint16_t*)indices;
+		for (unsigned i = 0; i < numIndices; ++i)
+		{
+			narrow[i] = (uint16_t)indices[i];
+		}
+	}
+	WorldVertex* shrunkVertices = SDL_realloc(vertices, sizeof(WorldVertex) * SDL_max(numVertices, 1));
+	void* shrunkIndices = SDL_realloc(indices, (size_t)indexSize * numIndices);
+
+	*world = (World)
+	{
+		.vertices = shrunkVertices ? shrunkVertices : vertices,
+		.indices = shrunkIndices ? shrunkIndices : indices,
+		.numVertices = numVertices,
+		.numIndices = numIndices,
+		.indexSize = indexSize
+	};
+	return true;
+}
+
+
+typedef struct
+{
+	float min[3], max[3];
+	float centre[3];
+} WorldTriBounds;
+
+typedef struct
+{
+	const WorldTriBounds* tris;
+	uint32_t* order, * scratch;
+	float* keys;
+	WorldNode* nodes;
+	uint32_t numNodes, numClusters;
+} WorldBvhBuilder;
+
+static inline uint32_t World_Index(const World* world, uint32_t i)
+{
+	return world->indexSize == sizeof(uint16_t)
+		? ((const uint16_t*)world->indices)[i]
+		: ((const uint32_t*)world->indices)[i];
+}
+
+static inline void World_SetIndex(World* world, uint32_t i, uint32_t index)
+{
+	if (world->indexSize == sizeof(uint16_t))
+		((uint16_t*)world->indices)[i] = (uint16_t)index;
+	else
+		((uint32_t*)world->indices)[i] = index;
+}
+
+static float World_SelectKey(float* keys, uint32_t count, uint32_t k)
+{
+	// Hoare style quickselect, leaves the k-th smallest key at keys[k]
+	ptrdiff_t lo = 0, hi = (ptrdiff_t)count - 1;
+	while (lo < hi)
+	{
+		const float pivot = keys[lo + (hi - lo) / 2];
+		ptrdiff_t i = lo, j = hi;
+		while (i <= j)
+		{
+			while (keys[i] < pivot) { ++i; }
+			while (keys[j] > pivot) { --j; }
+			if (i <= j)
+			{
+				const float t = keys[i];
+				keys[i++] = keys[j];
+				keys[j--] = t;
+			}
+		}
+		if ((ptrdiff_t)k <= j)
+			hi = j;
+		else if ((ptrdiff_t)k >= i)
+			lo = i;
+		else
+			break;
+	}
+	return keys[k];
+}
+
+static void World_BuildNode(WorldBvhBuilder* b, uint32_t first, uint32_t count)
+{
+	const uint32_t nodeIdx = b->numNodes++;
+	WorldNode* node = &b->nodes[nodeIdx];
+	float centreMin[3] = { FLT_MAX, FLT_MAX, FLT_MAX }, centreMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	*node = (WorldNode)
+	{
+		.min = { FLT_MAX, FLT_MAX, FLT_MAX },
+		.max = { -FLT_MAX, -FLT_MAX, -FLT_MAX },
+		.firstIndex = 3 * first,
+		.numIndices = 3 * count
+	};
+	for (uint32_t i = first; i < first + count; ++i)
+	{
+		const WorldTriBounds* t = &b->tris[b->order[i]];
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			node->min[axis] = SDL_min(node->min[axis], t->min[axis]);
+			node->max[axis] = SDL_max(node->max[axis], t->max[axis]);
+			centreMin[axis] = SDL_min(centreMin[axis], t->centre[axis]);
+			centreMax[axis] = SDL_max(centreMax[axis], t->centre[axis]);
+		}
+	}
+	if (count <= WORLD_CLUSTER_TRIANGLES)
+	{
+		++b->numClusters;
+		return;
+	}
+
+	// Split the longest axis of the triangle centres at the median so both halves get the same triangle count
+	int axis = 0;
+	for (int i = 1; i < 3; ++i)
+	{
+		if (centreMax[i] - centreMin[i] > centreMax[axis] - centreMin[axis])
+		{
+			axis = i;
+		}
+	}
+	const uint32_t half = count / 2;
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		b->keys[i] = b->tris[b->order[first + i]].centre[axis];
+	}
+	const float median = World_SelectKey(b->keys, count, half);
+
+	// Stable partition keeps the vertex cache order within each half, ties fill whatever the left half still needs
+	uint32_t numLess = 0;
+	for (uint32_t i = first; i < first + count; ++i)
+	{
+		numLess += b->tris[b->order[i]].centre[axis] < median;
+	}
+	uint32_t tiesLeft = half - numLess, numLeft = first, numRight = 0;
+	for (uint32_t i = first; i < first + count; ++i)
+	{
+		const float c = b->tris[b->order[i]].centre[axis];
+		if (c < median || (c == median && tiesLeft > 0 && tiesLeft--))
+			b->order[numLeft++] = b->order[i];
+		else
+			b->scratch[numRight++] = b->order[i];
+	}
+	SDL_memcpy(&b->order[numLeft], b->scratch, sizeof(uint32_t) * numRight);
+
+	World_BuildNode(b, first, half);
+	b->nodes[nodeIdx].rightChild = b->numNodes;
+	World_BuildNode(b, first + half, count - half);
+}
+
+static bool World_BuildBvh(World* world)
+{
+	const uint32_t numTris = world->numIndices / 3;
+	if (numTris == 0)
+	{
+		return true;
+	}
+
+	// Every leaf but a lone root holds more than half a cluster, which bounds the node count of each sector's tree
+	const uint32_t maxNodes = 2 * (numTris / (WORLD_CLUSTER_TRIANGLES / 2) + world->numSectors);
+	WorldTriBounds* tris = SDL_malloc(sizeof(WorldTriBounds) * numTris);
+	uint32_t* order = SDL_malloc(sizeof(uint32_t) * numTris);
+	uint32_t* scratch = SDL_malloc(sizeof(uint32_t) * numTris);
+	float* keys = SDL_malloc(sizeof(float) * numTris);
+	WorldNode* nodes = SDL_malloc(sizeof(WorldNode) * maxNodes);
+	void* indices = SDL_malloc((size_t)world->indexSize * world->numIndices);
+	if (!tris || !order || !scratch || !keys || !nodes || !indices)
+	{
+		SDL_free(indices);
+		SDL_free(nodes);
+		SDL_free(keys);
+		SDL_free(scratch);
+		SDL_free(order);
+		SDL_free(tris);
+		return false;
+	}
+
+	for (uint32_t tri = 0; tri < numTris; ++tri)
+	{
+		WorldTriBounds* t = &tris[tri];
+		for (int vtx = 0; vtx < 3; ++vtx)
+		{
+			const WorldVertex* v = &world->vertices[World_Index(world, 3 * tri + (uint32_t)vtx)];
+			const float p[3] = { v->x, v->y, v->z };
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				t->min[axis] = vtx ? SDL_min(t->min[axis], p[axis]) : p[axis];
+				t->max[axis] = vtx ? SDL_max(t->max[axis], p[axis]) : p[axis];
+			}
+		}
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			// NaN would stop the median select from terminating
+			const float c = 0.5f * (t->min[axis] + t->max[axis]);
+			t->centre[axis] = c == c ? c : 0.0f;
+		}
+		order[tri] = tri;
+	}
+
+	// Triangles never move between sectors, so each gets a tree over its own range
+	WorldBvhBuilder b = { .tris = tris, .order = order, .scratch = scratch, .keys = keys, .nodes = nodes };
+	for (unsigned i = 0; i < world->numSectors; ++i)
+	{
+		WorldSector* sector = &world->sectors[i];
+		sector->rootNode = b.numNodes;
+		if (sector->numIndices > 0)
+		{
+			World_BuildNode(&b, sector->firstIndex / 3, sector->numIndices / 3);
+		}
+	}
+
+	// Lay the triangles out in tree order
+	const size_t triBytes = 3 * (size_t)world->indexSize;
+	for (uint32_t tri = 0; tri < numTris; ++tri)
+	{
+		SDL_memcpy((char*)indices + triBytes * tri, (const char*)world->indices + triBytes * order[tri], triBytes);
+	}
+	SDL_free(keys);
+	SDL_free(scratch);
+	SDL_free(order);
+	SDL_free(tris);
+
+	SDL_free(world->indices);
+	world->indices = indices;
+	WorldNode* shrunkNodes = SDL_realloc(nodes, sizeof(WorldNode) * b.numNodes);
+	world->nodes = shrunkNodes ? shrunkNodes : nodes;
+	world->numNodes = b.numNodes;
+	world->numClusters = b.numClusters;
+	return true;
+}
+
+static bool World_OptimizeSectors(World* world)
+{
+	// The optimiser's working set is sized by vertex count, so each sector is renumbered to just the vertices it
+	// uses first. Optimising against the whole world's vertices would cost sectors * vertices
+	uint32_t* localIndices = SDL_malloc(sizeof(uint32_t) * SDL_max(world->numVertices, 1));
+	uint32_t* worldIndices = SDL_malloc(sizeof(uint32_t) * SDL_max(world->numVertices, 1));
+	uint32_t* indices = SDL_malloc(sizeof(uint32_t) * SDL_max(world->numIndices, 1));
+	bool ok = localIndices && worldIndices && indices;
+	if (ok)
+	{
+		SDL_memset(localIndices, 0xFF, sizeof(uint32_t) * world->numVertices);
+	}
+	for (unsigned i = 0; ok && i < world->numSectors; ++i)
+	{
+		const WorldSector* sector = &world->sectors[i];
+		uint32_t numLocal = 0;
+		for (uint32_t j = 0; j < sector->numIndices; ++j)
+		{
+			const uint32_t index = World_Index(world, sector->firstIndex + j);
+			if (localIndices[index] == UINT32_MAX)
+			{
+				localIndices[index] = numLocal;
+				worldIndices[numLocal++] = index;
+			}
+			indices[j] = localIndices[index];
+		}
+		ok = Mesh_OptimizeVertexCache(indices, sizeof(uint32_t), sector->numIndices, numLocal);
+		for (uint32_t j = 0; ok && j < sector->numIndices; ++j)
+		{
+			World_SetIndex(world, sector->firstIndex + j, worldIndices[indices[j]]);
+		}
+		for (uint32_t j = 0; j < numLocal; ++j)
+		{
+			localIndices[worldIndices[j]] = UINT32_MAX;
+		}
+	}
+	SDL_free(indices);
+	SDL_free(worldIndices);
+	SDL_free(localIndices);
+	return ok;
+}
+
+static bool World_Validate(World* world)
+{
+	// Make sure cached trees, sectors & portals can't send culling, raycasts or drawing out of bounds
+	if (world->numIndices % 3)
+	{
+		return false;
+	}
+	for (uint32_t i = 0; i < world->numIndices; ++i)
+	{
+		if (World_Index(world, i) >= world->numVertices)
+		{
+			return false;
+		}
+	}
+
+	// Traversals keep at most one pending node per level on a fixed stack, and write one range per leaf at most
+	// so every node must belong to exactly one tree
+	uint8_t* depths = SDL_calloc(world->numNodes + 1, 2);
+	if (!depths)
+	{
+		return false;
+	}
+	uint8_t* refs = depths + world->numNodes;
+	bool ok = true;
+	for (uint32_t i = 0; i < world->numSectors && ok; ++i)
+	{
+		const WorldSector* sector = &world->sectors[i];
+		ok = sector->numIndices <= world->numIndices && sector->firstIndex <= world->numIndices - sector->numIndices
+			&& sector->firstIndex % 3 == 0 && sector->numIndices % 3 == 0
+			&& sector->numPortals <= world->numPortals
+			&& sector->firstPortal <= world->numPortals - sector->numPortals;
+		if (ok && sector->numIndices > 0)
+		{
+			ok = sector->rootNode < world->numNodes && refs[sector->rootNode]++ == 0
+				&& world->nodes[sector->rootNode].firstIndex == sector->firstIndex
+				&& world->nodes[sector->rootNode].numIndices == sector->numIndices;
+		}
+	}
+	world->numClusters = 0;
+	for (uint32_t i = 0; i < world->numNodes && ok; ++i)
+	{
+		const WorldNode* node = &world->nodes[i];
+		ok = node->numIndices <= world->numIndices && node->firstIndex <= world->numIndices - node->numIndices
+			&& node->firstIndex % 3 == 0 && node->numIndices % 3 == 0
+			&& depths[i] < WORLD_BVH_STACK / 2;
+		if (ok && node->rightChild)
+		{
+			// Children always come after their parent, so depths are final by the time a node is reached
+			ok = node->rightChild > i + 1 && node->rightChild < world->numNodes
+				&& refs[i + 1]++ == 0 && refs[node->rightChild]++ == 0;
+			if (ok)
+			{
+				depths[i + 1] = depths[node->rightChild] = (uint8_t)(depths[i] + 1);
+			}
+		}
+		world->numClusters += !node->rightChild;
+	}
+	SDL_free(depths);
+	if (!ok)
+	{
+		return false;
+	}
+
+	for (uint32_t i = 0; i < world->numPortals; ++i)
+	{
+		const WorldPortal* portal = &world->portals[i];
+		if (portal->sector >= world->numSectors || portal->numVertices < 3
+			|| portal->numVertices > WORLD_MAX_PORTAL_VERTICES)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+static char* World_CachePath(const char* resourcePath)
+{
+	char* prefPath = SDL_GetPrefPath("a dinosaur", "NeHe SDL_GPU");
+	if (!prefPath)
+	{
+		return NULL;
+	}
+	const char* base = SDL_strrchr(resourcePath, '/');
+	base = base ? base + 1 : resourcePath;
+
+	char* path = NULL;
+	if (SDL_asprintf(&path, "%s%s.cache", prefPath, base) < 0)
+	{
+		path = NULL;
+	}
+	SDL_free(prefPath);
+	return path;
+}
+
+static bool World_ReadCache(World* restrict world, const char* restrict cachePath,
+	const WorldCacheHeader* restrict expected)
+{
+	SDL_IOStream* file = SDL_IOFromFile(cachePath, "rb");
+	if (!file)
+	{
+		return false;
+	}
+
+	WorldCacheHeader header;
+	bool ok = SDL_ReadIO(file, &header, sizeof(header)) == sizeof(header)
+		&& header.magic == expected->magic && header.version == expected->version
+		&& header.vertexSize == expected->vertexSize && header.nodeSize == expected->nodeSize
+		&& header.sectorSize == expected->sectorSize && header.portalSize == expected->portalSize
+		&& header.sourceSize == expected->sourceSize && header.sourceTime == expected->sourceTime
+		&& (header.indexSize == sizeof(uint16_t) || header.indexSize == sizeof(uint32_t))
+		&& header.numVertices > 0 && header.numIndices > 0 && header.numSectors > 0;
+	if (ok)
+	{
+		// Geometry is stored exactly as it sits in memory, so it's read straight into place
+		const size_t vertexBytes = sizeof(WorldVertex) * header.numVertices;
+		const size_t indexBytes = (size_t)header.indexSize * header.numIndices;
+		const size_t nodeBytes = sizeof(WorldNode) * header.numNodes;
+		const size_t sectorBytes = sizeof(WorldSector) * header.numSectors;
+		const size_t portalBytes = sizeof(WorldPortal) * header.numPortals;
+		const size_t fileBytes = sizeof(header) + vertexBytes + indexBytes + nodeBytes + sectorBytes + portalBytes;
+		ok = SDL_GetIOSize(file) == (Sint64)fileBytes
+			&& (world->vertices = SDL_malloc(vertexBytes)) != NULL
+			&& (world->indices = SDL_malloc(indexBytes)) != NULL
+			&& (world->nodes = SDL_malloc(SDL_max(nodeBytes, 1))) != NULL
+			&& (world->sectors = SDL_malloc(sectorBytes)) != NULL
+			&& (world->portals = SDL_malloc(SDL_max(portalBytes, 1))) != NULL
+			&& SDL_ReadIO(file, world->vertices, vertexBytes) == vertexBytes
+			&& SDL_ReadIO(file, world->indices, indexBytes) == indexBytes
+			&& SDL_ReadIO(file, world->nodes, nodeBytes) == nodeBytes
+			&& SDL_ReadIO(file, world->sectors, sectorBytes) == sectorBytes
+			&& SDL_ReadIO(file, world->portals, portalBytes) == portalBytes;
+	}
+	SDL_CloseIO(file);
+
+	if (ok)
+	{
+		world->numVertices = header.numVertices;
+		world->numIndices = header.numIndices;
+		world->indexSize = header.indexSize;
+		world->numNodes = header.numNodes;
+		world->numSectors = header.numSectors;
+		world->numPortals = header.numPortals;
+		ok = World_Validate(world);
+	}
+	if (!ok)
+	{
+		World_Free(world);
+		return false;
+	}
+	return true;
+}
+
+static void World_WriteCache(const World* restrict world, const char* restrict cachePath,
+	const WorldCacheHeader* restrict header)
+{
+	SDL_IOStream* file = SDL_IOFromFile(cachePath, "wb");
+	if (!file)
+	{
+		SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "SDL_IOFromFile: %s", SDL_GetError());
+		return;
+	}
+	const size_t vertexBytes = sizeof(WorldVertex) * world->numVertices;
+	const size_t indexBytes = (size_t)world->indexSize * world->numIndices;
+	const size_t nodeBytes = sizeof(WorldNode) * world->numNodes;
+	const size_t sectorBytes = sizeof(WorldSector) * world->numSectors;
+	const size_t portalBytes = sizeof(WorldPortal) * world->numPortals;
+	const bool written = SDL_WriteIO(file, header, sizeof(WorldCacheHeader)) == sizeof(WorldCacheHeader)
+		&& SDL_WriteIO(file, world->vertices, vertexBytes) == vertexBytes
+		&& SDL_WriteIO(file, world->indices, indexBytes) == indexBytes
+		&& SDL_WriteIO(file, world->nodes, nodeBytes) == nodeBytes
+		&& SDL_WriteIO(file, world->sectors, sectorBytes) == sectorBytes
+		&& SDL_WriteIO(file, world->portals, portalBytes) == portalBytes;
+	if (!SDL_CloseIO(file) || !written)
+	{
+		// Don't leave a truncated cache around for the next run to trip over
+		SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "Failed to write world cache: %s", SDL_GetError());
+		SDL_RemovePath(cachePath);
+	}
+}
+
+
+bool World_Load(const NeHeContext* restrict ctx, World* restrict world, const char* restrict resourcePath)
+{
+	SDL_zerop(world);
+
+	// The cache is only valid for the exact source file it was made from
+	char* sourcePath = NeHe_ResourcePath(ctx, resourcePath);
+	SDL_PathInfo info;
+	const bool haveInfo = sourcePath && SDL_GetPathInfo(sourcePath, &info);
+	SDL_free(sourcePath);
+	char* cachePath = haveInfo ? World_CachePath(resourcePath) : NULL;
+	WorldCacheHeader header =
+	{
+		.magic = WORLD_CACHE_MAGIC,
+		.version = WORLD_CACHE_VERSION,
+		.vertexSize = sizeof(WorldVertex),
+		.nodeSize = sizeof(WorldNode),
+		.sectorSize = sizeof(WorldSector),
+		.portalSize = sizeof(WorldPortal),
+		.sourceSize = haveInfo ? info.size : 0,
+		.sourceTime = haveInfo ? info.modify_time : 0
+	};
+	if (cachePath && World_ReadCache(world, cachePath, &header))
+	{
+		SDL_free(cachePath);
+		return true;
+	}
+
+	// Read the whole text file in one go and parse it in place
+	size_t length;
+	char* text = NeHe_ReadResourceBlob(ctx, resourcePath, &length);
+	if (!text)
+	{
+		SDL_free(cachePath);
+		return false;
+	}
+	WorldSource src;
+	SDL_zero(src);
+	const bool parsed = World_Parse(&src, text, length);
+	SDL_free(text);
+	if (!parsed)
+	{
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Failed to parse \"%s\": %s", resourcePath, SDL_GetError());
+		World_FreeSource(&src);
+		SDL_free(cachePath);
+		return false;
+	}
+
+	// Merge shared vertices, then hand the sectors & portals over to the world
+	const bool welded = World_Weld(world, src.tris, src.numTris);
+	world->sectors = src.sectors;
+	world->portals = src.portals;
+	world->numSectors = src.numSectors;
+	world->numPortals = src.numPortals;
+	src.sectors = NULL;
+	src.portals = NULL;
+	World_FreeSource(&src);
+
+	// Order each sector's triangles for the post-transform cache, group them into spatial clusters without
+	// disturbing that order within each cluster, and finally order vertices for fetch
+	MeshCacheStats before, after;
+	if (!welded
+		|| !Mesh_AnalyzeVertexCache(&before, world->indices, world->indexSize, world->numIndices,
+			world->numVertices, MESH_VERTEX_CACHE_SIZE)
+		|| !World_OptimizeSectors(world)
+		|| !World_BuildBvh(world)
+		|| !Mesh_OptimizeVertexFetch(world->vertices, sizeof(WorldVertex),
+			world->indices, world->indexSize, world->numIndices, world->numVertices)
+		|| !Mesh_AnalyzeVertexCache(&after, world->indices, world->indexSize, world->numIndices,
+			world->numVertices, MESH_VERTEX_CACHE_SIZE))
+	{
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Failed to process \"%s\": %s", resourcePath, SDL_GetError());
+		World_Free(world);
+		SDL_free(cachePath);
+		return false;
+	}
+	SDL_Log("World \"%s\": ACMR %.3f -> %.3f, ATVR %.3f -> %.3f", resourcePath,
+		(double)before.acmr, (double)after.acmr, (double)before.atvr, (double)after.atvr);
+
+	if (cachePath && world->numIndices > 0)
+	{
+		header.numVertices = world->numVertices;
+		header.numIndices = world->numIndices;
+		header.indexSize = world->indexSize;
+		header.numNodes = world->numNodes;
+		header.numSectors = world->numSectors;
+		header.numPortals = world->numPortals;
+		World_WriteCache(world, cachePath, &header);
+	}
+	SDL_free(cachePath);
+	return true;
+}
+
+void World_Free(World* world)
+{
+	SDL_free(world->portals);
+	SDL_free(world->sectors);
+	SDL_free(world->nodes);
+	SDL_free(world->indices);
+	SDL_free(world->vertices);
+	SDL_zerop(world);
+}
+
+
+typedef struct
+{
+	Vec4f planes[WORLD_MAX_FRUSTUM_PLANES];
+	unsigned numPlanes;
+	uint32_t sector;
+} WorldFrustum;
+
+typedef struct
+{
+	const World* world;
+	Vec3f eye;
+	Vec4f farPlane;
+	WorldFrustum* visits;
+	unsigned numVisits;
+	bool overflow;
+} WorldPortalWalk;
+
+static inline float World_PlaneDistance(const Vec4f* plane, Vec3f p)
+{
+	return plane->x * p.x + plane->y * p.y + plane->z * p.z + plane->w;
+}
+
+static int World_ClassifyBox(const WorldNode* restrict node, const WorldFrustum* restrict frustum)
+{
+	// The box corner furthest along each plane normal decides if it's outside, the nearest if it's fully inside
+	int result = 1;
+	for (unsigned i = 0; i < frustum->numPlanes; ++i)
+	{
+		const Vec4f* p = &frustum->planes[i];
+		const Vec3f far =
+		{
+			p->x >= 0.0f ? node->max[0] : node->min[0],
+			p->y >= 0.0f ? node->max[1] : node->min[1],
+			p->z >= 0.0f ? node->max[2] : node->min[2]
+		};
+		const Vec3f near =
+		{
+			p->x >= 0.0f ? node->min[0] : node->max[0],
+			p->y >= 0.0f ? node->min[1] : node->max[1],
+			p->z >= 0.0f ? node->min[2] : node->max[2]
+		};
+		if (World_PlaneDistance(p, far) < 0.0f)
+		{
+			return -1;
+		}
+		if (World_PlaneDistance(p, near) < 0.0f)
+		{
+			result = 0;
+		}
+	}
+	return result;
+}
+
+static unsigned World_CullSector(const World* restrict world, const WorldSector* restrict sector,
+	const WorldFrustum* restrict frustums, unsigned numFrustums, WorldRange* restrict ranges, unsigned numRanges)
+{
+	if (sector->numIndices == 0)
+	{
+		return numRanges;
+	}
+
+	uint32_t stack[WORLD_BVH_STACK];
+	unsigned top = 0;
+	stack[top++] = sector->rootNode;
+	while (top > 0)
+	{
+		const uint32_t nodeIdx = stack[--top];
+		const WorldNode* node = &world->nodes[nodeIdx];
+
+		// A sector seen through several portals is visible wherever any of their frustums are
+		bool outside = true, inside = false;
+		for (unsigned i = 0; i < numFrustums && !inside; ++i)
+		{
+			const int classified = World_ClassifyBox(node, &frustums[i]);
+			outside = outside && classified < 0;
+			inside = classified > 0;
+		}
+		if (outside)
+		{
+			continue;
+		}
+
+		if (inside || !node->rightChild)
+		{
+			// Subtrees are visited in index order, so a range either continues the last one or starts a new one
+			WorldRange* last = numRanges ? &ranges[numRanges - 1] : NULL;
+			if (last && last->firstIndex + last->numIndices == node->firstIndex)
+				last->numIndices += node->numIndices;
+			else
+				ranges[numRanges++] = (WorldRange){ node->firstIndex, node->numIndices };
+		}
+		else
+		{
+			stack[top++] = node->rightChild;
+			stack[top++] = nodeIdx + 1;
+		}
+	}
+	return numRanges;
+}
+
+unsigned World_Cull(const World* restrict world, const Vec4f planes[6], WorldRange* restrict ranges)
+{
+	WorldFrustum frustum = { .numPlanes = 6 };
+	SDL_memcpy(frustum.planes, planes, sizeof(Vec4f) * 6);
+	unsigned numRanges = 0;
+	for (unsigned i = 0; i < world->numSectors; ++i)
+	{
+		numRanges = World_CullSector(world, &world->sectors[i], &frustum, 1, ranges, numRanges);
+	}
+	return numRanges;
+}
+
+static unsigned World_ClipPolygon(Vec3f* restrict out, const Vec3f* restrict in, unsigned count, const Vec4f* plane)
+{
+	// Sutherland-Hodgman against a single plane, adds at most one vertex
+	unsigned numOut = 0;
+	for (unsigned i = 0; i < count; ++i)
+	{
+		const Vec3f a = in[i], b = in[(i + 1) % count];
+		const float da = World_PlaneDistance(plane, a), db = World_PlaneDistance(plane, b);
+		if (da >= 0.0f)
+		{
+			out[numOut++] = a;
+		}
+		if ((da >= 0.0f) != (db >= 0.0f))
+		{
+			const float t = da / (da - db);
+			out[numOut++] = (Vec3f){ a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t, a.z + (b.z - a.z) * t };
+		}
+	}
+	return numOut;
+}
+
+static bool World_PortalFrustum(WorldFrustum* restrict frustum, Vec3f eye, const Vec3f* restrict polygon,
+	unsigned count, const Vec4f* restrict farPlane)
+{
+	if (count + 1 > WORLD_MAX_FRUSTUM_PLANES)
+	{
+		return false;
+	}
+
+	Vec3f centre = { 0.0f, 0.0f, 0.0f };
+	for (unsigned i = 0; i < count; ++i)
+	{
+		centre = (Vec3f){ centre.x + polygon[i].x, centre.y + polygon[i].y, centre.z + polygon[i].z };
+	}
+	centre = (Vec3f){ centre.x / (float)count, centre.y / (float)count, centre.z / (float)count };
+
+	// One plane through the eye & each edge of the clipped portal, facing the portal's centre
+	frustum->numPlanes = 0;
+	for (unsigned i = 0; i < count; ++i)
+	{
+		const Vec3f a = { polygon[i].x - eye.x, polygon[i].y - eye.y, polygon[i].z - eye.z };
+		const Vec3f b = { polygon[(i + 1) % count].x - eye.x, polygon[(i + 1) % count].y - eye.y,
+			polygon[(i + 1) % count].z - eye.z };
+		Vec3f n = { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+		const float len = SDL_sqrtf(n.x * n.x + n.y * n.y + n.z * n.z);
+		if (len < 1e-6f)
+		{
+			continue;  // Clipping can leave near duplicate vertices, skipping their edge only widens the frustum
+		}
+		n = (Vec3f){ n.x / len, n.y / len, n.z / len };
+		if (n.x * (centre.x - eye.x) + n.y * (centre.y - eye.y) + n.z * (centre.z - eye.z) < 0.0f)
+		{
+			n = (Vec3f){ -n.x, -n.y, -n.z };
+		}
+		frustum->planes[frustum->numPlanes++] = (Vec4f){ n.x, n.y, n.z, -(n.x * eye.x + n.y * eye.y + n.z * eye.z) };
+	}
+
+	// Standing in the portal's plane sees everything through it
+	if (frustum->numPlanes < 3)
+	{
+		return false;
+	}
+	frustum->planes[frustum->numPlanes++] = *farPlane;
+	return true;
+}
+
+static void World_WalkPortals(WorldPortalWalk* restrict walk, const WorldFrustum* restrict frustum,
+	uint32_t fromSector, unsigned depth)
+{
+	if (walk->numVisits == WORLD_MAX_PORTAL_VISITS || depth == WORLD_MAX_PORTAL_DEPTH)
+	{
+		walk->overflow = true;
+		return;
+	}
+	walk->visits[walk->numVisits++] = *frustum;
+
+	const WorldSector* sector = &walk->world->sectors[frustum->sector];
+	for (uint32_t i = sector->firstPortal; i < sector->firstPortal + sector->numPortals && !walk->overflow; ++i)
+	{
+		const WorldPortal* portal = &walk->world->portals[i];
+		if (portal->sector == fromSector)
+		{
+			continue;
+		}
+
+		// Clip the portal to what's visible so far, nothing beyond it can be seen if nothing is left
+		Vec3f polygon[2][WORLD_MAX_PORTAL_VERTICES + WORLD_MAX_FRUSTUM_PLANES];
+		unsigned count = portal->numVertices, cur = 0;
+		SDL_memcpy(polygon[0], portal->vertices, sizeof(Vec3f) * count);
+		for (unsigned p = 0; p < frustum->numPlanes && count >= 3; ++p, cur ^= 1)
+		{
+			count = World_ClipPolygon(polygon[cur ^ 1], polygon[cur], count, &frustum->planes[p]);
+		}
+		if (count < 3)
+		{
+			continue;
+		}
+
+		// Narrow the view to the clipped portal, or keep the current one when that isn't possible
+		WorldFrustum next;
+		if (!World_PortalFrustum(&next, walk->eye, polygon[cur], count, &walk->farPlane))
+		{
+			next = *frustum;
+		}
+		next.sector = portal->sector;
+		World_WalkPortals(walk, &next, frustum->sector, depth + 1);
+	}
+}
+
+static uint32_t World_FindSector(const World* world, Vec3f p)
+{
+	// Rooms' bounds can overlap at their walls, the tightest one that contains the point wins
+	uint32_t best = UINT32_MAX;
+	float bestVolume = FLT_MAX;
+	for (uint32_t i = 0; i < world->numSectors; ++i)
+	{
+		const WorldSector* sector = &world->sectors[i];
+		if (sector->numIndices == 0)
+		{
+			continue;
+		}
+		const WorldNode* root = &world->nodes[sector->rootNode];
+		if (p.x < root->min[0] || p.y < root->min[1] || p.z < root->min[2]
+			|| p.x > root->max[0] || p.y > root->max[1] || p.z > root->max[2])
+		{
+			continue;
+		}
+		const float volume = (root->max[0] - root->min[0]) * (root->max[1] - root->min[1])
+			* (root->max[2] - root->min[2]);
+		if (volume < bestVolume)
+		{
+			best = i;
+			bestVolume = volume;
+		}
+	}
+	return best;
+}
+
+unsigned World_CullPortals(const World* restrict world, Vec3f eye, const Vec4f planes[6],
+	WorldRange* restrict ranges)
+{
+	const uint32_t start = world->numPortals > 0 ? World_FindSector(world, eye) : UINT32_MAX;
+	if (start == UINT32_MAX)
+	{
+		return World_Cull(world, planes, ranges);
+	}
+
+	// Gather every sector visit along with the frustum it was seen through
+	WorldFrustum visits[WORLD_MAX_PORTAL_VISITS];
+	WorldPortalWalk walk = { .world = world, .eye = eye, .farPlane = planes[5], .visits = visits };
+	WorldFrustum frustum = { .numPlanes = 6, .sector = start };
+	SDL_memcpy(frustum.planes, planes, sizeof(Vec4f) * 6);
+	World_WalkPortals(&walk, &frustum, UINT32_MAX, 0);
+	if (walk.overflow)
+	{
+		// Too many portals in view to track, drawing more than needed beats missing rooms
+		return World_Cull(world, planes, ranges);
+	}
+
+	// Group visits by sector so ranges come out in index order without duplicates
+	for (unsigned i = 1; i < walk.numVisits; ++i)
+	{
+		const WorldFrustum visit = visits[i];
+		unsigned j = i;
+		for (; j > 0 && visits[j - 1].sector > visit.sector; --j)
+		{
+			visits[j] = visits[j - 1];
+		}
+		visits[j] = visit;
+	}
+	unsigned numRanges = 0;
+	for (unsigned i = 0, next; i < walk.numVisits; i = next)
+	{
+		for (next = i + 1; next < walk.numVisits && visits[next].sector == visits[i].sector; ++next) {}
+		numRanges = World_CullSector(world, &world->sectors[visits[i].sector], &visits[i], next - i,
+			ranges, numRanges);
+	}
+	return numRanges;
+}
+
+static bool World_RayHitsBox(const WorldNode* restrict node, const float origin[3], const float invDir[3],
+	float maxDist)
+{
+	float near = 0.0f, far = maxDist;
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		float t0 = (node->min[axis] - origin[axis]) * invDir[axis];
+		float t1 = (node->max[axis] - origin[axis]) * invDir[axis];
+		if (t0 > t1)
+		{
+			const float t = t0;
+			t0 = t1;
+			t1 = t;
+		}
+		near = SDL_max(near, t0);
+		far = SDL_min(far, t1);
+		if (near > far)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool World_RayHitsTriangle(const World* restrict world, uint32_t firstIndex, const float origin[3],
+	const float dir[3], float* restrict dist)
+{
+	// Moller-Trumbore, triangles are hit from either side
+	const WorldVertex* v0 = &world->vertices[World_Index(world, firstIndex)];
+	const WorldVertex* v1 = &world->vertices[World_Index(world, firstIndex + 1)];
+	const WorldVertex* v2 = &world->vertices[World_Index(world, firstIndex + 2)];
+	const float e1[3] = { v1->x - v0->x, v1->y - v0->y, v1->z - v0->z };
+	const float e2[3] = { v2->x - v0->x, v2->y - v0->y, v2->z - v0->z };
+	const float p[3] =
+	{
+		dir[1] * e2[2] - dir[2] * e2[1],
+		dir[2] * e2[0] - dir[0] * e2[2],
+		dir[0] * e2[1] - dir[1] * e2[0]
+	};
+	const float det = e1[0] * p[0] + e1[1] * p[1] + e1[2] * p[2];
+	if (SDL_fabsf(det) < 1e-12f)
+	{
+		return false;
+	}
+	const float invDet = 1.0f / det;
+	const float s[3] = { origin[0] - v0->x, origin[1] - v0->y, origin[2] - v0->z };
+	const float u = (s[0] * p[0] + s[1] * p[1] + s[2] * p[2]) * invDet;
+	if (u < 0.0f || u > 1.0f)
+	{
+		return false;
+	}
+	const float q[3] =
+	{
+		s[1] * e1[2] - s[2] * e1[1],
+		s[2] * e1[0] - s[0] * e1[2],
+		s[0] * e1[1] - s[1] * e1[0]
+	};
+	const float v = (dir[0] * q[0] + dir[1] * q[1] + dir[2] * q[2]) * invDet;
+	if (v < 0.0f || u + v > 1.0f)
+	{
+		return false;
+	}
+	const float t = (e2[0] * q[0] + e2[1] * q[1] + e2[2] * q[2]) * invDet;
+	if (t < 0.0f || t >= *dist)
+	{
+		return false;
+	}
+	*dist = t;
+	return true;
+}
+
+bool World_Raycast(const World* restrict world, Vec3f origin, Vec3f dir, float maxDist, float* restrict outDist)
+{
+	const float o[3] = { origin.x, origin.y, origin.z };
+	const float d[3] = { dir.x, dir.y, dir.z };
+	const float invDir[3] = { 1.0f / dir.x, 1.0f / dir.y, 1.0f / dir.z };
+	float dist = maxDist;
+	bool hit = false;
+
+	for (unsigned sector = 0; sector < world->numSectors; ++sector)
+	{
+		if (world->sectors[sector].numIndices == 0)
+		{
+			continue;
+		}
+
+		uint32_t stack[WORLD_BVH_STACK];
+		unsigned top = 0;
+		stack[top++] = world->sectors[sector].rootNode;
+		while (top > 0)
+		{
+			// Boxes further than the nearest hit so far are skipped
+			const uint32_t nodeIdx = stack[--top];
+			const WorldNode* node = &world->nodes[nodeIdx];
+			if (!World_RayHitsBox(node, o, invDir, dist))
+			{
+				continue;
+			}
+			if (node->rightChild)
+			{
+				stack[top++] = node->rightChild;
+				stack[top++] = nodeIdx + 1;
+				continue;
+			}
+			for (uint32_t i = node->firstIndex; i < node->firstIndex + node->numIndices; i += 3)
+			{
+				if (World_RayHitsTriangle(world, i, o, d, &dist))
+				{
+					hit = true;
+				}
+			}
+		}
+	}
+	if (hit && outDist)
+	{
+		*outDist = dist;
+	}
+	return hit;
+}
@@ -0,0 +1,84 @@
+#ifndef WORLD_H
+#define WORLD_H
+
+#include "nehe.h"
+
+typedef struct
+{
+	float x, y, z;
+	float u, v;
+} WorldVertex;
+
+typedef struct
+{
+	WorldVertex vertices[3];
+} WorldTriangle;
+
+// Bounding volume hierarchy node, stored depth first so the left child directly follows its parent and every
+// subtree covers one contiguous run of the index buffer
+typedef struct
+{
+	float min[3], max[3];
+	uint32_t firstIndex, numIndices;
+	uint32_t rightChild;  // 0 for leaves
+} WorldNode;
+
+typedef struct
+{
+	uint32_t firstIndex, numIndices;
+} WorldRange;
+
+#define WORLD_MAX_PORTAL_VERTICES 8
+
+// Convex opening from one sector into another, portals are one way so a doorway is listed in both sectors
+typedef struct
+{
+	uint32_t sector;
+	uint32_t numVertices;
+	Vec3f vertices[WORLD_MAX_PORTAL_VERTICES];
+} WorldPortal;
+
+// A room's triangles are one contiguous index range with its own BVH
+typedef struct
+{
+	uint32_t firstIndex, numIndices;
+	uint32_t rootNode;  // Only valid when numIndices > 0
+	uint32_t firstPortal, numPortals;
+} WorldSector;
+
+typedef struct
+{
+	WorldVertex* vertices;
+	void* indices;  // Triangle list, 16 or 32-bit as given by indexSize
+	unsigned numVertices, numIndices;
+	unsigned indexSize;
+	WorldNode* nodes;
+	unsigned numNodes, numClusters;
+	WorldSector* sectors;
+	WorldPortal* portals;
+	unsigned numSectors, numPortals;
+} World;
+
+// Load a NeHe style world text file into welded, indexed geometry. A binary copy of the result is cached in the
+// pref path to skip parsing & processing on later runs.
+//
+// Besides the original single NUMPOLLIES block, a world may be split into sectors joined by portals:
+//   NUMSECTORS <n>
+//   SECTOR
+//   NUMPOLLIES <n> followed by 3 vertices of "x y z u v" per triangle
+//   NUMPORTALS <n> (optional) followed by "PORTAL <sector> <vertices>" then "x y z" per vertex
+//   SECTOR ...
+bool World_Load(const NeHeContext* restrict ctx, World* restrict world, const char* restrict resourcePath);
+void World_Free(World* world);
+
+// Collect the index ranges of clusters that intersect the frustum given by Mtx_FrustumPlanes, neighbouring ranges
+// are merged. The output must have room for world->numClusters ranges, returns the number of ranges written
+unsigned World_Cull(const World* restrict world, const Vec4f planes[6], WorldRange* restrict ranges);
+// Like World_Cull, but only sectors seen through portals from the sector containing the eye are drawn. Falls back to
+// culling everything when the eye is outside all sectors
+unsigned World_CullPortals(const World* restrict world, Vec3f eye, const Vec4f planes[6],
+	WorldRange* restrict ranges);
+// Find the nearest triangle hit by a ray within maxDist, dir needn't be normalised and distances are in units of it
+bool World_Raycast(const World* restrict world, Vec3f origin, Vec3f dir, float maxDist, float* restrict outDist);
+
+#endif//WORLD_H
@@ -5,14 +5,16 @@
 
 struct CharacterInput
 {
-	float4 src : TEXCOORD0, dst : TEXCOORD1;
+	float4 src : TEXCOORD0;  // Normalised atlas rectangle
+	int4 dst : TEXCOORD1;    // Pixel rectangle
+	float4 color : TEXCOORD2;
 	uint vertexID : SV_VertexID;
 };
 
 struct VertexUniform
 {
 	float4x4 modelViewProj;
-	float4 color;
+	float4 color;  // Tint for all text
 };
 
 struct Vertex2Pixel
@@ -29,12 +31,12 @@ Vertex2Pixel VertexMain(CharacterInput input)
 	const float2 offset = float2(
 		input.vertexID >>  1,
 		input.vertexID & 0x1);
-	const float2 position = input.dst.xy + input.dst.zw * offset;
+	const float2 position = float2(input.dst.xy) + float2(input.dst.zw) * offset;
 
 	Vertex2Pixel output;
 	output.position = mul(ubo.modelViewProj, float4(position, 0.0, 1.0));
 	output.texCoord = input.src.xy + input.src.zw * offset;
-	output.color = half4(ubo.color);
+	output.color = half4(input.color * ubo.color);
 	return output;
 }
 
@@ -47,5 +49,12 @@ half4 FragmentMain(Vertex2Pixel input) : SV_Target0
 half4 PixelMain(Vertex2Pixel input) : SV_Target0
 #endif
 {
+#ifdef SDF
+	// Distance is 0.5 on the glyph outline, antialias across roughly one screen pixel at any scale
+	const float dist = Texture.Sample(Sampler, input.texCoord).a;
+	const float width = 0.5 * fwidth(dist) + 1e-4;
+	return input.color * half(smoothstep(0.5 - width, 0.5 + width, dist));
+#else
 	return input.color * Texture.Sample(Sampler, input.texCoord).a;
+#endif
 }
@@ -8,13 +8,15 @@
 
 struct CharacterInput
 {
-	float4 src [[attribute(0)]], dst [[attribute(1)]];
+	float4 src [[attribute(0)]];  // Normalised atlas rectangle
+	short4 dst [[attribute(1)]];   // Pixel rectangle
+	float4 color [[attribute(2)]];
 };
 
 struct VertexUniform
 {
 	metal::float4x4 modelViewProj;
-	float4 color;
+	float4 color;  // Tint for all text
 };
 
 struct Vertex2Fragment
@@ -32,9 +34,9 @@ vertex Vertex2Fragment VertexMain(
 	const auto offset = float2(vertexID >> 1, vertexID & 0x1);
 
 	Vertex2Fragment out;
-	out.position = u.modelViewProj * float4(in.dst.xy + in.dst.zw * offset, 0.0, 1.0);
+	out.position = u.modelViewProj * float4(float2(in.dst.xy) + float2(in.dst.zw) * offset, 0.0, 1.0);
 	out.texCoord = in.src.xy + in.src.zw * offset;
-	out.color = half4(u.color);
+	out.color = half4(in.color * u.color);
 	return out;
 }
 
@@ -43,5 +45,12 @@ fragment half4 FragmentMain(
 	metal::texture2d<half, metal::access::sample> texture [[texture(0)]],
 	metal::sampler sampler [[sampler(0)]])
 {
+#ifdef SDF
+	// Distance is 0.5 on the glyph outline, antialias across roughly one screen pixel at any scale
+	const float dist = texture.sample(sampler, in.texCoord).a;
+	const float width = 0.5 * metal::fwidth(dist) + 1e-4;
+	return in.color * half(metal::smoothstep(0.5 - width, 0.5 + width, dist));
+#else
 	return in.color * texture.sample(sampler, in.texCoord).a;
+#endif
 }
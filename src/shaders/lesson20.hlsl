@@ -3,10 +3,18 @@
  * SPDX-License-Identifier: Zlib
  */
 
+struct VertexInput
+{
+	// Instance
+	float4x4 model : TEXCOORD0;
+	float4 texTransform : TEXCOORD4;  // Offset in xy, scale in zw
+
+	uint vertexID : SV_VertexID;
+};
+
 struct VertexUniform
 {
-	float4x4 modelViewProj;
-	float2 texOffset, texScale;
+	float4x4 projection;
 };
 
 struct Vertex2Pixel
@@ -33,11 +41,16 @@ static const float2 quadTexCoords[4] =
     { 1.0f, 1.0f }   // Top right
 };
 
-Vertex2Pixel VertexMain(uint vertexID : SV_VertexID)
+Vertex2Pixel VertexMain(VertexInput input)
 {
+	float4x4 model = input.model;
+#ifdef VULKAN
+	model = transpose(model);
+#endif
+
 	Vertex2Pixel output;
-	output.position = mul(ubo.modelViewProj, float4(quadVertices[vertexID], 0.0, 1.0));
-	output.texCoord = ubo.texOffset + quadTexCoords[vertexID] * ubo.texScale;
+	output.position = mul(ubo.projection, mul(model, float4(quadVertices[input.vertexID], 0.0, 1.0)));
+	output.texCoord = input.texTransform.xy + quadTexCoords[input.vertexID] * input.texTransform.zw;
 	return output;
 }
 
@@ -6,10 +6,19 @@
 #include <metal_stdlib>
 #include <simd/simd.h>
 
+struct VertexInput
+{
+	// Instance
+	float4 model0       [[attribute(0)]];
+	float4 model1       [[attribute(1)]];
+	float4 model2       [[attribute(2)]];
+	float4 model3       [[attribute(3)]];
+	float4 texTransform [[attribute(4)]];  // Offset in xy, scale in zw
+};
+
 struct VertexUniform
 {
-	metal::float4x4 modelViewProj;
-    float2 texOffset, texScale;
+	metal::float4x4 projection;
 };
 
 struct Vertex2Fragment
@@ -35,12 +44,15 @@ static constexpr constant float2 quadTexCoords[4] =
 };
 
 vertex Vertex2Fragment VertexMain(
+	VertexInput in [[stage_in]],
 	uint vertexID [[vertex_id]],
 	constant VertexUniform& u [[buffer(0)]])
 {
+	const auto model = metal::float4x4(in.model0, in.model1, in.model2, in.model3);
+
 	Vertex2Fragment out;
-	out.position = u.modelViewProj * float4(quadVertices[vertexID], 0.0, 1.0);
-	out.texCoord = u.texOffset + quadTexCoords[vertexID] * u.texScale;
+	out.position = u.projection * model * float4(quadVertices[vertexID], 0.0, 1.0);
+	out.texCoord = in.texTransform.xy + quadTexCoords[vertexID] * in.texTransform.zw;
 	return out;
 }
 
@@ -7,7 +7,11 @@ struct VertexInput
 {
 	float3 position : TEXCOORD0;
 	float2 texcoord : TEXCOORD1;
+#ifdef OCT_NORMAL
+	float2 normal : TEXCOORD2;
+#else
 	float3 normal : TEXCOORD2;
+#endif
 };
 
 struct VertexUniform
@@ -33,10 +37,25 @@ struct Vertex2Pixel
 ConstantBuffer<VertexUniform> ubo : register(b0, space1);
 ConstantBuffer<LightUniform> light : register(b1, space1);
 
+#ifdef OCT_NORMAL
+// Unfold octahedral encoded normal, doesn't need to be unit length as it's normalised after transformation
+float3 OctahedronDecode(float2 e)
+{
+	float3 n = float3(e, 1.0 - abs(e.x) - abs(e.y));
+	const float t = saturate(-n.z);
+	n.xy -= (step(0.0, n.xy) * 2.0 - 1.0) * t;
+	return n;
+}
+#endif
+
 Vertex2Pixel VertexMain(VertexInput input)
 {
 	const float4 position = mul(ubo.modelView, float4(input.position, 1.0));
+#ifdef OCT_NORMAL
+	const float3 normal = normalize(mul(ubo.modelView, float4(OctahedronDecode(input.normal), 0.0))).xyz;
+#else
 	const float3 normal = normalize(mul(ubo.modelView, float4(input.normal, 0.0))).xyz;
+#endif
 
 	const float3 lightVec = light.position.xyz - position.xyz;
 	const float lightDist2 = dot(lightVec, lightVec);
@@ -10,7 +10,11 @@ struct VertexInput
 {
 	float3 position [[attribute(0)]];
 	float2 texcoord [[attribute(1)]];
+#ifdef OCT_NORMAL
+	float2 normal   [[attribute(2)]];
+#else
 	float3 normal   [[attribute(2)]];
+#endif
 };
 
 struct VertexUniform
@@ -33,13 +37,28 @@ struct Vertex2Fragment
 	half4 color;
 };
 
+#ifdef OCT_NORMAL
+// Unfold octahedral encoded normal, doesn't need to be unit length as it's normalised after transformation
+static float3 OctahedronDecode(float2 e)
+{
+	auto n = float3(e, 1.0 - metal::abs(e.x) - metal::abs(e.y));
+	const auto t = metal::saturate(-n.z);
+	n.xy -= (metal::step(float2(0.0), n.xy) * 2.0 - 1.0) * t;
+	return n;
+}
+#endif
+
 vertex Vertex2Fragment VertexMain(
 	VertexInput in [[stage_in]],
 	constant VertexUniform& u [[buffer(0)]],
 	constant Light& light [[buffer(1)]])
 {
 	const auto position = u.modelView * float4(in.position, 1.0);
+#ifdef OCT_NORMAL
+	const auto normal = metal::normalize(u.modelView * float4(OctahedronDecode(in.normal), 0.0)).xyz;
+#else
 	const auto normal = metal::normalize(u.modelView * float4(in.normal, 0.0)).xyz;
+#endif
 
 	const auto lightVec = light.position.xyz - position.xyz;
 	const auto lightDist2 = metal::length_squared(lightVec);